@@ -0,0 +1,86 @@
+// GPSReader: benchmark (--bench=...), tracce sintetiche e confronto delle metriche con i valori attesi
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "gpsreader.h"
+
+// valori attesi delle metriche dei file di samples/ (output CSV di --parser=dom) e tolleranza relativa del confronto
+#define GOLDEN_FILE "samples/golden.csv"
+#define GOLDEN_TOLERANCE 1e-9
+
+// namespace delle estensioni Garmin dei punti delle tracce sintetiche
+#define GARMIN_TPX_NAMESPACE_STR "http://www.garmin.com/xmlschemas/TrackPointExtension/v1"
+
+// traccia sintetica dei benchmark: a parità di impostazioni il file generato è sempre lo stesso
+typedef struct {
+  int numSegments;
+  int pointsPerSegment;
+  int extensions;       // 1 = frequenza cardiaca, cadenza, temperatura e potenza in ogni punto
+  double noise;         // ampiezza (m) del rumore aggiunto a posizione e quota
+  uint64_t seed;        // seme del generatore pseudo-casuale del rumore e dei sensori
+} syntheticTrack;
+
+// tempi di una fase del benchmark
+typedef struct {
+  const char *name;
+  double seconds;       // il migliore delle ripetizioni
+} benchStage;
+
+// client di --bench=serve: invia "requests" volte la stessa richiesta e registra le latenze (s)
+typedef struct {
+  const char *path;
+  const char *header;
+  size_t headerSize;
+  const char *payload;
+  size_t payloadSize;
+  const char *expected;       // corpo atteso della risposta
+  size_t expectedSize;
+  int requests;
+  double *latency;
+  int errors;
+} benchServeTask;
+
+// global variable con il nome del benchmark da eseguire (NULL = elaborazione normale del file)
+extern const char *_BENCH_;
+
+// global variable con le impostazioni della traccia sintetica di --bench=stages (NULL = default)
+extern const char *_SYNTHETIC_;
+
+// global variable con il file in cui scrivere i risultati dei benchmark in JSON (NULL = nessuno)
+extern const char *_BENCH_JSON_;
+
+int runBenchmark(const jobConfig *config, const char *name);
+int benchSegments(const jobConfig *config);
+int benchBatch(const jobConfig *config, const char *source, int maxThreads);
+int benchDistance(void);
+int benchGeodesic(void);
+int benchParallel(const jobConfig *config);
+int benchParser(const jobConfig *config, const char *source);
+int benchCache(const jobConfig *config);
+int benchArena(const jobConfig *config, const char *filename);
+int benchChart(void);
+int benchExport(const jobConfig *config, const char *source, int numThreads);
+double randomUniform(uint64_t *state);
+void writeSyntheticGpx(FILE *fp, int numSegments, int pointsPerSegment);
+void writeSyntheticTrack(FILE *fp, const syntheticTrack *track);
+int parseSyntheticSpec(const char *spec, syntheticTrack *track);
+int benchStages(const jobConfig *config);
+void appendBenchStages(textBuffer *b, const char *name, const benchStage *stages, int numStages, int numPoints, size_t size);
+int writeBenchJson(const char *path, const syntheticTrack *track, int numPoints, size_t size, const benchStage *stages, int numStages, const benchStage *modes, int numModes);
+int benchGolden(const jobConfig *config);
+int benchSpatial(void);
+int benchFollow(const jobConfig *config);
+int benchIndex(const jobConfig *config);
+int benchEfforts(void);
+int benchServe(const jobConfig *config);
+void *benchServeClient(void *arg);
+void *benchServeListener(void *arg);
+double getSortedPercentile(double *values, int count, double p);
+int compareSeconds(const void *a, const void *b);
+int checkArenaBatch(const jobConfig *config, parserMode mode, char *message, size_t messageSize);
+int compareGoldenCsv(const char *expected, const char *actual, char *message, size_t messageSize);
+int nextCsvField(const char **cursor, char *field, size_t fieldSize);
+
+#endif
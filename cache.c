@@ -0,0 +1,408 @@
+// GPSReader: cache binaria di un file GPX (<file>.gpsc, --cache): le metriche dei segmenti e i punti in colonne
+// compresse, per rielaborare il file senza rileggerlo
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "cache.h"
+
+// processing con la cache binaria (<file>.gpsc): se la cache esiste e l'hash del contenuto del file GPX coincide,
+// segmenti e metriche sono letti dalla cache; altrimenti il file è letto (con il tokenizer della modalità mmap)
+// e la cache viene scritta prima di stampare i risultati
+int processFileCached(const jobConfig *job, const char *filename) {
+
+  trackCache cache = {0};
+  int ret = readTrackCache(job, filename, &cache, NULL);
+
+  if (ret == 0) printTrackCache(job, filename, &cache);
+
+  freeTrackCache(&cache);
+  return ret;
+}
+
+// segmenti, metriche e punti di un file GPX: con --cache dalla cache binaria se è valida, altrimenti dal file (con il
+// tokenizer della modalità mmap), scrivendo la cache se --cache è attiva. In "contentHash" (se non è NULL) l'hash del
+// contenuto del file. Restituisce 0, o 1 dopo aver stampato l'errore
+int readTrackCache(const jobConfig *job, const char *filename, trackCache *cache, uint64_t *contentHash) {
+
+  int fd = open(filename, O_RDONLY);
+  struct stat info;
+
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+    if (fd >= 0) close(fd);
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  size_t size = info.st_size;
+  const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  char cachePath[strlen(filename) + sizeof(CACHE_EXTENSION)];
+  sprintf(cachePath, "%s%s", filename, CACHE_EXTENSION);
+
+  // le metriche conservate dipendono anche dal filtro delle quote, dal modello delle distanze e dalla FC massima
+  uint64_t hash = getContentHash(data, size);
+  if (contentHash != NULL) *contentHash = hash;
+  hash ^= getMetricsSettingsHash(job);
+
+  int ret = 0;
+  int loaded = 0;
+
+  if (job->cache) {
+    STATS_BEGIN(cacheTimer, STAT_PARSE);
+    loaded = loadTrackCache(cachePath, hash, size, cache);
+    STATS_END(cacheTimer, 0);
+  }
+
+  if (loaded) {
+    if (job->debug) { fprintf(getMessageStream(job), "Lettura dalla cache \"%s\"\n", cachePath); }
+  }
+  else {
+    // i punti sono solo raccolti: la stampa (e quella del debug) avviene dopo, come per la cache
+    jobConfig collectJob = *job;
+    collectJob.debug = 0;
+
+    streamState *st = calloc(1, sizeof(streamState));
+    st->job = &collectJob;
+    st->filename = filename;
+    st->cache = cache;
+
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    STATS_BEGIN(parseTimer, STAT_PARSE);
+    ret = parseGpxBuffer(st, data, data + size);
+    STATS_END(parseTimer, 0);
+
+    free(st);
+
+    if (ret == 0 && job->cache && !saveTrackCache(cachePath, hash, size, cache) && job->debug) {
+      fprintf(getMessageStream(job), "Impossibile scrivere la cache \"%s\"\n", cachePath);
+    }
+  }
+
+  munmap((void*) data, size);
+
+  if (ret != 0) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  if (cache->numSegments == 0) {
+    fprintf(getMessageStream(job), "Non ho trovato tracce nel file \"%s\"\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+// stampa metriche e grafico di tutti i segmenti della cache, con i totali delle tracce con più segmenti. Le metriche
+// sono quelle calcolate alla lettura del file GPX; le distanze progressive per il grafico sono ricalcolate dai punti
+void printTrackCache(const jobConfig *job, const char *filename, const trackCache *cache) {
+
+  metrics total = {0};
+  int trackSegments = 0;
+
+  for (int s = 0; s < cache->numSegments; s++) {
+
+    const cachedSegment *segment = &(cache->segments[s]);
+
+    if (job->debug) { fprintf(getMessageStream(job), "Segmento %d\n", trackSegments); }
+
+    metrics results = {0};
+    trackAnalysis analysis;
+    initTrackAnalysis(&analysis, segment->numPoints);
+    getResults(job, segment->points, NULL, segment->numPoints, &results, &analysis);
+
+    printSegment(job, filename, &(segment->results), segment->track, trackSegments, &analysis, NULL);
+
+    if (job->nearPoint) {
+      printNearestPoint(job, segment->points, segment->numPoints, &analysis);
+    }
+
+    freeTrackAnalysis(&analysis);
+
+    mergeResults(&total, &(segment->results));
+    trackSegments++;
+
+    // ultimo segmento della traccia: con più segmenti si stampa anche il totale
+    if (s == cache->numSegments - 1 || cache->segments[s + 1].track != segment->track) {
+      if (trackSegments > 1) {
+        strcpy(total.name, segment->results.name);
+        printTrackTotal(job, filename, &total, segment->track, trackSegments);
+      }
+      memset(&total, 0, sizeof(metrics));
+      trackSegments = 0;
+    }
+  }
+}
+
+// legge la cache, se esiste ed è stata scritta per un file GPX con lo stesso contenuto; restituisce 0 altrimenti
+// (cache assente, di un'altra versione, non aggiornata o danneggiata)
+int loadTrackCache(const char *path, uint64_t hash, uint64_t size, trackCache *cache) {
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return 0;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(cacheHeader)) {
+    close(fd);
+    return 0;
+  }
+
+  size_t cacheSize = info.st_size;
+  const char *data = mmap(NULL, cacheSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) return 0;
+
+  const cacheHeader *header = (const cacheHeader*) data;
+  const cacheSegment *segments = (const cacheSegment*) (data + sizeof(cacheHeader));
+
+  int valid = (memcmp(header->magic, CACHE_MAGIC, 4) == 0 && header->version == CACHE_VERSION
+               && header->metricsSize == sizeof(metrics) && header->sourceHash == hash && header->sourceSize == size
+               && sizeof(cacheHeader) + (uint64_t) header->numSegments * sizeof(cacheSegment) <= cacheSize);
+
+  for (uint32_t s = 0; valid && s < header->numSegments; s++) {
+    const cacheSegment *segment = &segments[s];
+
+    // ogni valore delle colonne occupa almeno un byte: un numero di punti che non ci sta è di una cache danneggiata
+    if (segment->offset > cacheSize || segment->size > cacheSize - segment->offset
+        || (uint64_t) segment->numPoints * CACHE_COLUMNS > segment->size) {
+      valid = 0;
+      break;
+    }
+
+    addCacheSegment(cache, segment->track, &(segment->results));
+
+    cachedSegment *dest = &(cache->segments[cache->numSegments - 1]);
+    dest->results.name[TRACK_NAME_SIZE - 1] = '\0';
+    dest->points = arenaCalloc(segment->numPoints > 0 ? segment->numPoints : 1, sizeof(gpxPoint));
+
+    if (dest->points == NULL) {
+      valid = 0;
+      break;
+    }
+
+    dest->numPoints = dest->capacity = segment->numPoints;
+
+    valid = decodeCacheColumns((const uint8_t*) data + segment->offset, segment->size, dest->points, segment->numPoints);
+  }
+
+  munmap((void*) data, cacheSize);
+
+  if (!valid) {
+    freeTrackCache(cache);
+    memset(cache, 0, sizeof(trackCache));
+  }
+
+  return valid;
+}
+
+// scrive la cache in un file temporaneo e lo rinomina, così chi legge la cache non la trova mai scritta a metà
+int saveTrackCache(const char *path, uint64_t hash, uint64_t size, const trackCache *cache) {
+
+  char tmpPath[strlen(path) + 8];
+  sprintf(tmpPath, "%s.XXXXXX", path);
+
+  int fd = mkstemp(tmpPath);
+  if (fd < 0) return 0;
+
+  // mkstemp() crea il file leggibile solo dal proprietario
+  fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  FILE *fp = fdopen(fd, "wb");
+
+  cacheHeader header = {0};
+  memcpy(header.magic, CACHE_MAGIC, 4);
+  header.version = CACHE_VERSION;
+  header.metricsSize = sizeof(metrics);
+  header.sourceHash = hash;
+  header.sourceSize = size;
+  header.numSegments = cache->numSegments;
+
+  // le colonne di ogni segmento sono codificate in memoria prima di scrivere la tabella dei segmenti
+  cacheSegment *segments = calloc(cache->numSegments > 0 ? cache->numSegments : 1, sizeof(cacheSegment));
+  uint8_t **columns = calloc(cache->numSegments > 0 ? cache->numSegments : 1, sizeof(uint8_t*));
+  uint64_t offset = sizeof(cacheHeader) + (uint64_t) cache->numSegments * sizeof(cacheSegment);
+
+  for (int s = 0; s < cache->numSegments; s++) {
+    const cachedSegment *segment = &(cache->segments[s]);
+
+    // caso peggiore: 10 byte per valore
+    columns[s] = malloc((size_t) segment->numPoints * CACHE_COLUMNS * 10 + 1);
+
+    segments[s].results = segment->results;
+    segments[s].track = segment->track;
+    segments[s].numPoints = segment->numPoints;
+    segments[s].offset = offset;
+    segments[s].size = encodeCacheColumns(segment->points, segment->numPoints, columns[s]);
+    offset += segments[s].size;
+  }
+
+  int ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  if (cache->numSegments > 0) {
+    ok = ok && (fwrite(segments, sizeof(cacheSegment), cache->numSegments, fp) == (size_t) cache->numSegments);
+  }
+
+  for (int s = 0; s < cache->numSegments; s++) {
+    ok = ok && (fwrite(columns[s], 1, segments[s].size, fp) == segments[s].size);
+    free(columns[s]);
+  }
+
+  free(columns);
+  free(segments);
+
+  ok = (fclose(fp) == 0) && ok;
+  ok = ok && (rename(tmpPath, path) == 0);
+
+  if (!ok) unlink(tmpPath);
+  return ok;
+}
+
+// codifica i punti in colonne (latitudine, longitudine, quota, tempo): ogni valore è un intero in virgola fissa,
+// memorizzato come differenza dal valore precedente (zigzag + varint: 1-3 byte per valore in una traccia tipica).
+// Restituisce il numero di byte scritti
+size_t encodeCacheColumns(const gpxPoint *points, int numPoints, uint8_t *buffer) {
+
+  uint8_t *p = buffer;
+
+  for (int column = 0; column < CACHE_COLUMNS; column++) {
+    int64_t prev = 0;
+
+    for (int i = 0; i < numPoints; i++) {
+      int64_t value = getFixedPoint(&points[i], column);
+      uint64_t delta = (uint64_t) value - (uint64_t) prev;
+      uint64_t zigzag = (delta << 1) ^ (uint64_t)((int64_t) delta >> 63);
+
+      while (zigzag >= 0x80) {
+        *p++ = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+      }
+      *p++ = (uint8_t) zigzag;
+
+      prev = value;
+    }
+  }
+
+  return p - buffer;
+}
+
+// decodifica le colonne di un segmento scritte da encodeCacheColumns(); restituisce 0 se i dati non sono validi
+int decodeCacheColumns(const uint8_t *buffer, size_t size, gpxPoint *points, int numPoints) {
+
+  const uint8_t *p = buffer;
+  const uint8_t *end = buffer + size;
+
+  for (int column = 0; column < CACHE_COLUMNS; column++) {
+    int64_t value = 0;
+
+    for (int i = 0; i < numPoints; i++) {
+      uint64_t zigzag = 0;
+      int shift = 0;
+
+      do {
+        if (p >= end || shift > 63) return 0;
+        zigzag |= (uint64_t)(*p & 0x7f) << shift;
+        shift += 7;
+      } while (*p++ & 0x80);
+
+      value = (int64_t)((uint64_t) value + ((zigzag >> 1) ^ -(zigzag & 1)));
+      setFixedPoint(&points[i], column, value);
+    }
+  }
+
+  return (p == end);
+}
+
+// valore in virgola fissa di una colonna della cache: gradi (1e-7), metri (mm), millisecondi
+int64_t getFixedPoint(const gpxPoint *p, int column) {
+  switch (column) {
+    case CACHE_LAT: return llround(p->lat * CACHE_DEGREE_SCALE);
+    case CACHE_LON: return llround(p->lon * CACHE_DEGREE_SCALE);
+    case CACHE_ELEVATION: return llround(p->elevation * CACHE_ELEVATION_SCALE);
+    default: return p->time;
+  }
+}
+
+// inverso di getFixedPoint()
+void setFixedPoint(gpxPoint *p, int column, int64_t value) {
+  switch (column) {
+    case CACHE_LAT: p->lat = value / CACHE_DEGREE_SCALE; break;
+    case CACHE_LON: p->lon = value / CACHE_DEGREE_SCALE; break;
+    case CACHE_ELEVATION: p->elevation = value / CACHE_ELEVATION_SCALE; break;
+    default: p->time = value;
+  }
+}
+
+// hash a 64 bit del contenuto del file, 8 byte alla volta (serve a riconoscere una cache non aggiornata,
+// non ha pretese crittografiche)
+uint64_t getContentHash(const char *data, size_t size) {
+
+  uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+  size_t i = 0;
+
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+  }
+
+  uint64_t word = 0;
+  memcpy(&word, data + i, size - i);
+  hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+  hash ^= hash >> 29;
+
+  return hash;
+}
+
+// aggiunge alla cache un segmento vuoto della traccia "track", con le sue metriche
+void addCacheSegment(trackCache *cache, int track, const metrics *results) {
+
+  if (cache->numSegments == cache->capacity) {
+    cache->capacity = (cache->capacity > 0) ? cache->capacity * 2 : 16;
+    cache->segments = realloc(cache->segments, sizeof(cachedSegment) * cache->capacity);
+  }
+
+  cachedSegment *segment = &(cache->segments[cache->numSegments++]);
+  memset(segment, 0, sizeof(cachedSegment));
+  segment->track = track;
+  segment->results = *results;
+}
+
+// aggiunge un punto all'ultimo segmento della cache, già arrotondato alla precisione delle colonne: così il grafico
+// stampato dopo la prima lettura coincide con quello delle letture successive dalla cache
+void addCachePoint(trackCache *cache, const gpxPoint *p) {
+
+  cachedSegment *segment = &(cache->segments[cache->numSegments - 1]);
+
+  if (segment->numPoints == segment->capacity) {
+    segment->capacity = (segment->capacity > 0) ? segment->capacity * 2 : 1024;
+    segment->points = arenaRealloc(segment->points, sizeof(gpxPoint) * segment->capacity);
+  }
+
+  gpxPoint *dest = &(segment->points[segment->numPoints++]);
+  for (int column = 0; column < CACHE_COLUMNS; column++) {
+    setFixedPoint(dest, column, getFixedPoint(p, column));
+  }
+}
+
+// libera la memoria della cache
+void freeTrackCache(trackCache *cache) {
+  for (int s = 0; s < cache->numSegments; s++) arenaFree(cache->segments[s].points);
+  free(cache->segments);
+}
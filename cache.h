@@ -0,0 +1,72 @@
+// GPSReader: cache binaria di un file GPX (<file>.gpsc, --cache): le metriche dei segmenti e i punti in colonne
+// compresse, per rielaborare il file senza rileggerlo
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "gpsreader.h"
+
+// cache binaria: estensione del file (accanto al file GPX), identificativo e versione del formato,
+// colonne dei punti e loro precisione in virgola fissa (1e-7 gradi, cioè circa 1 cm; 1 mm di quota)
+#define CACHE_EXTENSION ".gpsc"
+#define CACHE_MAGIC "GPSC"
+#define CACHE_VERSION 4
+#define CACHE_COLUMNS 4
+#define CACHE_LAT 0
+#define CACHE_LON 1
+#define CACHE_ELEVATION 2
+#define CACHE_TIME 3
+#define CACHE_DEGREE_SCALE 1e7
+#define CACHE_ELEVATION_SCALE 1e3
+
+// segmento conservato nella cache binaria: metriche calcolate alla lettura del file GPX e tutti i punti
+typedef struct {
+  int track;          // indice della traccia a cui appartiene il segmento
+  metrics results;
+  int numPoints;
+  int capacity;
+  gpxPoint *points;
+} cachedSegment;
+
+// contenuto della cache binaria di un file GPX: i segmenti di tutte le tracce, in ordine
+typedef struct trackCache {
+  int numSegments;
+  int capacity;
+  cachedSegment *segments;
+} trackCache;
+
+// intestazione del file di cache, seguita da una tabella di cacheSegment e dalle colonne dei punti
+typedef struct {
+  char magic[4];            // CACHE_MAGIC
+  uint32_t version;         // CACHE_VERSION
+  uint32_t metricsSize;     // sizeof(metrics): le metriche sono scritte così come sono in memoria
+  uint32_t numSegments;
+  uint64_t sourceHash;      // hash del contenuto del file GPX (e delle impostazioni del filtro delle quote)
+  uint64_t sourceSize;
+} cacheHeader;
+
+// descrizione di un segmento nel file di cache
+typedef struct {
+  metrics results;
+  uint32_t track;
+  uint32_t numPoints;
+  uint64_t offset;          // posizione delle colonne dei punti nel file
+  uint64_t size;            // byte occupati dalle colonne
+} cacheSegment;
+
+int processFileCached(const jobConfig *job, const char *filename);
+int readTrackCache(const jobConfig *job, const char *filename, trackCache *cache, uint64_t *contentHash);
+void printTrackCache(const jobConfig *job, const char *filename, const trackCache *cache);
+int loadTrackCache(const char *path, uint64_t hash, uint64_t size, trackCache *cache);
+int saveTrackCache(const char *path, uint64_t hash, uint64_t size, const trackCache *cache);
+size_t encodeCacheColumns(const gpxPoint *points, int numPoints, uint8_t *buffer);
+int decodeCacheColumns(const uint8_t *buffer, size_t size, gpxPoint *points, int numPoints);
+int64_t getFixedPoint(const gpxPoint *p, int column);
+void setFixedPoint(gpxPoint *p, int column, int64_t value);
+uint64_t getContentHash(const char *data, size_t size);
+void addCacheSegment(trackCache *cache, int track, const metrics *results);
+void addCachePoint(trackCache *cache, const gpxPoint *p);
+void freeTrackCache(trackCache *cache);
+
+#endif
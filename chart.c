@@ -0,0 +1,427 @@
+// GPSReader: grafici ASCII di una o più serie di valori lungo la distanza o il tempo
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+//
+// Il grafico è una matrice rows x cols in cui ogni colonna rappresenta una frazione dell'asse x e ogni riga una frazione
+// dell'intervallo dei valori [yMin, yMax]. La matrice non viene mai costruita: ogni riga è composta in un unico buffer
+// (allocato una volta sola, con l'etichetta dell'asse y) e scritta con una sola fwrite()
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "chart.h"
+
+// prepara un grafico senza serie
+void initChart(chart *c, const char *title, const char *yLabel, const char *xLabel, int rows, int cols) {
+  memset(c, 0, sizeof(chart));
+  c->title = title;
+  c->yLabel = yLabel;
+  c->xLabel = xLabel;
+  c->rows = rows;
+  c->cols = cols;
+  c->xLabelScale = 1.0;
+}
+
+// aggiunge una serie (c->cols valori); restituisce 0 se il grafico ha già CHART_MAX_SERIES serie
+int addChartSeries(chart *c, const double *values, char fillChar, chartStyle style) {
+
+  if (c->numSeries == CHART_MAX_SERIES) return 0;
+
+  chartSeries *s = &(c->series[c->numSeries++]);
+  s->values = values;
+  s->fillChar = fillChar;
+  s->style = style;
+  return 1;
+}
+
+// stampa il grafico: titolo, righe (etichetta dell'asse y e celle) e asse x con le etichette; un grafico senza
+// righe o colonne non viene stampato. Restituisce 1 se non è stato possibile allocare i buffer
+int printChart(FILE *out, const chart *c) {
+
+  int rows = c->rows;
+  int cols = c->cols;
+
+  if (rows <= 0 || cols <= 0) return 0;
+
+  // ogni riga, a quanto corrisponde sull'asse y?
+  double yUnit = (c->yMax - c->yMin) / (double) rows;
+
+  // altezza (in celle) di ogni colonna di ogni serie, arrotondata all'intero superiore; 0 = colonna vuota
+  int *heights = malloc(sizeof(int) * (c->numSeries * cols + 1));
+
+  // buffer di una riga: etichetta (anche più lunga di CHART_Y_LABEL_LENGTH, per valori molto grandi) + celle
+  size_t rowSize = cols + CHART_X_LABEL_SPACING * 8 + 64;
+  char *row = malloc(rowSize);
+
+  if (heights == NULL || row == NULL) {
+    free(heights);
+    free(row);
+    return 1;
+  }
+
+  for (int s = 0; s < c->numSeries; s++) {
+    for (int col = 0; col < cols; col++) {
+      heights[s * cols + col] = getChartHeight(c, c->series[s].values[col]);
+    }
+  }
+
+  // stampa titoli e grafico
+  fprintf(out, "[ %s %d x %d]\n\n", c->title, cols, rows);
+  fprintf(out, "%s\n", c->yLabel);
+
+  // righe dall'alto verso il basso: la riga r è piena per le colonne alte almeno rows - r celle
+  for (int r = 0; r < rows; r++) {
+
+    // l'etichetta di valori enormi (ad es. 1e200) può non stare nel buffer: in quel caso lo si allarga
+    double ylabel = c->yMax - (r * yUnit);
+    int length = snprintf(NULL, 0, "\n[%4.0lf] ", ylabel);
+
+    if ((size_t) length + cols + 1 > rowSize) {
+      char *larger = realloc(row, (size_t) length + cols + 1);
+
+      if (larger == NULL) {
+        free(heights);
+        free(row);
+        return 1;
+      }
+
+      row = larger;
+      rowSize = (size_t) length + cols + 1;
+    }
+
+    snprintf(row, rowSize - cols, "\n[%4.0lf] ", ylabel);
+    char *cells = row + length;
+
+    memset(cells, ' ', cols);
+
+    for (int s = 0; s < c->numSeries; s++) {
+      const int *h = heights + s * cols;
+      char fillChar = c->series[s].fillChar;
+
+      if (c->series[s].style == CHART_AREA) {
+        for (int col = 0; col < cols; col++) {
+          if (r >= rows - h[col]) cells[col] = fillChar;
+        }
+      } else {
+        for (int col = 0; col < cols; col++) {
+          if (h[col] > 0 && r == rows - h[col]) cells[col] = fillChar;
+        }
+      }
+    }
+
+    fwrite(row, 1, length + cols, out);
+  }
+
+  // qual è la posizione dell'inizio dell'ultima etichetta dell'asse x?
+  int xMax = (cols + CHART_X_LABEL_SPACING - (cols % CHART_X_LABEL_SPACING));
+
+  // spazio per le etichette dell'asse x: di solito al massimo 8 caratteri l'una, ma per valori enormi anche molti di più
+  size_t labelsSize = 0;
+
+  for (int col = 0; col < xMax; col += CHART_X_LABEL_SPACING) {
+    labelsSize += snprintf(NULL, 0, "%-*.*lf", CHART_X_LABEL_SPACING, 1, (double) col * c->xUnit / c->xLabelScale);
+  }
+
+  // barre per unità dell'asse x, allineate alla prima colonna
+  size_t axisSize = 1 + CHART_Y_LABEL_LENGTH + (labelsSize > (size_t) xMax ? labelsSize : (size_t) xMax) + strlen(c->xLabel) + 64;
+  char *axis = malloc(axisSize);
+
+  if (axis == NULL) {
+    free(heights);
+    free(row);
+    return 1;
+  }
+
+  int length = 0;
+  axis[length++] = '\n';
+  memset(axis + length, ' ', CHART_Y_LABEL_LENGTH);
+  length += CHART_Y_LABEL_LENGTH;
+
+  for (int col = 0; col < xMax; col++) {
+    axis[length++] = (col % CHART_X_LABEL_SPACING == 0) ? '|' : ' ';
+  }
+
+  fwrite(axis, 1, length, out);
+
+  // valori dell'asse x (il buffer ha spazio per tutte le etichette, misurate sopra)
+  length = 0;
+  axis[length++] = '\n';
+  memset(axis + length, ' ', CHART_Y_LABEL_LENGTH);
+  length += CHART_Y_LABEL_LENGTH;
+
+  for (int col = 0; col < xMax; col += CHART_X_LABEL_SPACING) {
+    double xlabel = (double) col * c->xUnit / c->xLabelScale;
+    // il "-" allinea a sinistra; gli *.* permettono di specificare tramite variabili la lunghezza massima e il numero di decimali
+    length += snprintf(axis + length, axisSize - length, "%-*.*lf", CHART_X_LABEL_SPACING, 1, xlabel);
+  }
+
+  // legenda asse x
+  length += snprintf(axis + length, axisSize - length, "\t %s\n", c->xLabel);
+  fwrite(axis, 1, length, out);
+
+  free(axis);
+  free(heights);
+  free(row);
+  return 0;
+}
+
+// altezza (in celle, da 0 a rows) della colonna di un valore, arrotondata all'intero superiore; 0 per NAN.
+// Con un intervallo nullo (valori tutti uguali) si riempie solo la prima riga dal fondo
+int getChartHeight(const chart *c, double value) {
+
+  if (isnan(value)) return 0;
+
+  double yUnit = (c->yMax - c->yMin) / (double) c->rows;
+  int h = (yUnit > 0) ? (int) ceil((value - c->yMin) / yUnit) : 1;
+
+  if (h < 0) return 0;
+  if (h > c->rows) return c->rows;
+  return h;
+}
+
+// colonna (da 0 a cols - 1) di un valore dell'asse x: i valori oltre l'ultima colonna (o negativi) finiscono nell'ultima (o nella prima).
+// Le funzioni che la usano non fanno nulla se cols non è positivo
+static int getChartColumn(double x, double xUnit, int cols) {
+
+  int col = (xUnit > 0 && x > 0) ? (int)(x / xUnit) : 0;
+  return (col >= cols || col < 0) ? cols - 1 : col;
+}
+
+// valore di ogni colonna di un grafico: media (pesata con "weight", se non è NULL) dei valori y dei punti
+// con x in [c * xUnit, (c+1) * xUnit); i punti oltre l'ultima colonna finiscono nell'ultima, i valori NAN sono ignorati.
+// Le colonne senza punti ripetono il valore della precedente (le prime quello della prima colonna con dei punti);
+// se nessun punto ha un valore tutte le colonne valgono NAN
+void getChartColumns(const double *x, const double *y, const double *weight, int size, double xUnit, double *columns, int cols) {
+
+  if (cols <= 0) return;
+
+  double *sum = calloc(cols, sizeof(double));
+  double *count = calloc(cols, sizeof(double));
+
+  if (sum == NULL || count == NULL) {
+    for (int col = 0; col < cols; col++) columns[col] = NAN;
+    free(sum);
+    free(count);
+    return;
+  }
+
+  for (int i = 0; i < size; i++) {
+    if (isnan(y[i])) continue;
+
+    double w = (weight != NULL) ? weight[i] : 1.0;
+    if (!(w > 0)) continue;
+
+    int col = getChartColumn(x[i], xUnit, cols);
+
+    sum[col] += y[i] * w;
+    count[col] += w;
+  }
+
+  double last = NAN;
+  int first = 1;
+
+  for (int col = 0; col < cols; col++) {
+    if (count[col] > 0) {
+      columns[col] = sum[col] / count[col];
+      last = columns[col];
+
+      if (first) {
+        for (int j = 0; j < col; j++) columns[j] = last;
+        first = 0;
+      }
+    } else {
+      columns[col] = last;
+    }
+  }
+
+  free(sum);
+  free(count);
+}
+
+// inviluppo M4 di una serie: per ogni colonna il primo, l'ultimo, il minimo e il massimo dei valori dei suoi punti,
+// in una sola passata. "low" e "high" (se non sono NULL) sono il minimo e il massimo di ciascun punto quando un punto
+// riassume più valori (ad es. un contenitore del profilo in streaming); first e last possono essere NULL.
+// Le colonne senza punti ripetono l'ultimo valore della precedente; se nessun punto ha un valore valgono NAN
+void getChartEnvelope(const double *x, const double *y, const double *low, const double *high, int size, double xUnit, double *first, double *last, double *min, double *max, int cols) {
+
+  if (cols <= 0) return;
+
+  int *count = calloc(cols, sizeof(int));
+  double *lastValue = malloc(sizeof(double) * cols);
+
+  for (int col = 0; col < cols; col++) {
+    min[col] = max[col] = NAN;
+    if (first != NULL) first[col] = NAN;
+    if (last != NULL) last[col] = NAN;
+  }
+
+  if (count == NULL || lastValue == NULL) {
+    free(count);
+    free(lastValue);
+    return;
+  }
+
+  for (int i = 0; i < size; i++) {
+    if (isnan(y[i])) continue;
+
+    int col = getChartColumn(x[i], xUnit, cols);
+    double lo = (low != NULL) ? low[i] : y[i];
+    double hi = (high != NULL) ? high[i] : y[i];
+
+    if (count[col] == 0 || lo < min[col]) min[col] = lo;
+    if (count[col] == 0 || hi > max[col]) max[col] = hi;
+    if (count[col] == 0 && first != NULL) first[col] = y[i];
+
+    lastValue[col] = y[i];
+    count[col]++;
+  }
+
+  // colonne vuote: un punto fermo all'ultimo valore della colonna precedente
+  double previous = NAN;
+  int firstColumn = -1;
+
+  for (int col = 0; col < cols; col++) {
+    if (count[col] > 0) {
+      if (firstColumn < 0) firstColumn = col;
+      if (last != NULL) last[col] = lastValue[col];
+      previous = lastValue[col];
+      continue;
+    }
+
+    min[col] = max[col] = previous;
+    if (first != NULL) first[col] = previous;
+    if (last != NULL) last[col] = previous;
+  }
+
+  // colonne iniziali vuote: il primo valore della prima colonna con dei punti
+  for (int col = 0; col < firstColumn; col++) {
+    double value = (first != NULL) ? first[firstColumn] : min[firstColumn];
+    min[col] = max[col] = value;
+    if (first != NULL) first[col] = value;
+    if (last != NULL) last[col] = value;
+  }
+
+  free(count);
+  free(lastValue);
+}
+
+// Largest-Triangle-Three-Buckets con un contenitore per colonna (i punti con x nella colonna, che devono essere in
+// ordine di x crescente): per ogni colonna si sceglie il punto che forma il triangolo di area massima con il punto
+// scelto nella colonna precedente e con la media dei punti della colonna successiva non vuota. Il valore della colonna
+// è quello del punto scelto, quindi picchi e avvallamenti restano. Una sola passata sui punti più una sulle colonne
+void getChartLttb(const double *x, const double *y, int size, double xUnit, double *columns, int cols) {
+
+  if (cols <= 0) return;
+
+  int *start = malloc(sizeof(int) * (cols + 1));
+  int *count = calloc(cols, sizeof(int));
+  double *avgX = malloc(sizeof(double) * cols);
+  double *avgY = malloc(sizeof(double) * cols);
+
+  for (int col = 0; col < cols; col++) columns[col] = NAN;
+
+  if (start == NULL || count == NULL || avgX == NULL || avgY == NULL || size == 0) {
+    free(start);
+    free(count);
+    free(avgX);
+    free(avgY);
+    return;
+  }
+
+  // inizio di ogni contenitore e media dei suoi punti (x non decrescente: un punto non torna mai a una colonna precedente)
+  int col = 0;
+  start[0] = 0;
+
+  for (int i = 0; i < size; i++) {
+    int c = getChartColumn(x[i], xUnit, cols);
+    if (c < col) c = col;
+
+    while (col < c) start[++col] = i;
+
+    if (count[col] == 0) avgX[col] = avgY[col] = 0.0;
+    avgX[col] += x[i];
+    avgY[col] += y[i];
+    count[col]++;
+  }
+
+  while (col < cols) start[++col] = size;
+
+  for (int c = 0; c < cols; c++) {
+    if (count[c] > 0) {
+      avgX[c] /= count[c];
+      avgY[c] /= count[c];
+    }
+  }
+
+  // punto scelto nella colonna precedente: per la prima colonna, il primo punto della serie
+  double ax = x[0];
+  double ay = y[0];
+
+  // colonna non vuota successiva: si parte dalla fine (per l'ultima fa da riferimento l'ultimo punto)
+  int next = cols;
+
+  for (int c = 0; c < cols; c++) {
+    if (count[c] == 0) continue;
+
+    if (next <= c) next = c + 1;
+    while (next < cols && count[next] == 0) next++;
+
+    double cx = (next < cols) ? avgX[next] : x[size - 1];
+    double cy = (next < cols) ? avgY[next] : y[size - 1];
+
+    int best = start[c];
+    double bestArea = -1.0;
+
+    for (int i = start[c]; i < start[c + 1]; i++) {
+      double area = fabs((ax - cx) * (y[i] - ay) - (ax - x[i]) * (cy - ay));
+      if (area > bestArea) {
+        bestArea = area;
+        best = i;
+      }
+    }
+
+    columns[c] = y[best];
+    ax = x[best];
+    ay = y[best];
+  }
+
+  fillChartColumns(columns, count, cols);
+
+  free(start);
+  free(count);
+  free(avgX);
+  free(avgY);
+}
+
+// le colonne senza punti (count = 0) ripetono il valore della precedente, le prime quello della prima colonna con dei punti
+void fillChartColumns(double *columns, const int *count, int cols) {
+
+  double last = NAN;
+  int first = 1;
+
+  for (int col = 0; col < cols; col++) {
+    if (count[col] > 0) {
+      last = columns[col];
+
+      if (first) {
+        for (int j = 0; j < col; j++) columns[j] = last;
+        first = 0;
+      }
+    } else {
+      columns[col] = last;
+    }
+  }
+}
+
+// valori minimo e massimo delle colonne (NAN se nessuna colonna ha un valore)
+void getChartRange(const double *columns, int cols, double *min, double *max) {
+
+  *min = NAN;
+  *max = NAN;
+
+  for (int col = 0; col < cols; col++) {
+    if (isnan(columns[col])) continue;
+    if (isnan(*min) || columns[col] < *min) *min = columns[col];
+    if (isnan(*max) || columns[col] > *max) *max = columns[col];
+  }
+}
@@ -0,0 +1,57 @@
+// GPSReader: grafici ASCII di una o più serie di valori (quota, velocità, frequenza cardiaca, pendenza...)
+// lungo la distanza o il tempo
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef CHART_H
+#define CHART_H
+
+#include <stdio.h>
+
+// numero massimo di serie sovrapposte in un grafico
+#define CHART_MAX_SERIES 4
+
+// caratteri occupati dall'etichetta dell'asse y: 4 per i numeri + le quadre che li contengono + lo spazio che la stacca dalla prima colonna
+#define CHART_Y_LABEL_LENGTH 7
+
+// ogni quante colonne si stampa il valore dell'asse x
+#define CHART_X_LABEL_SPACING 5
+
+// modo di disegnare una serie
+typedef enum {
+  CHART_AREA,     // colonne piene dal fondo del grafico fino al valore
+  CHART_LINE      // solo la cella del valore
+} chartStyle;
+
+// serie di un grafico: un valore per colonna (NAN = nessun valore, la colonna resta vuota)
+typedef struct {
+  const double *values;
+  char fillChar;
+  chartStyle style;
+} chartSeries;
+
+// grafico: dimensioni, scale degli assi e serie da disegnare (in ordine: le ultime coprono le prime)
+typedef struct {
+  const char *title;
+  const char *yLabel;
+  const char *xLabel;
+  int rows;
+  int cols;
+  double yMin;              // valore del fondo del grafico
+  double yMax;              // valore della prima riga
+  double xUnit;             // ampiezza di una colonna, nell'unità dell'asse x (m, s)
+  double xLabelScale;       // divisore delle etichette dell'asse x (ad es. 1000 per passare da m a Km)
+  int numSeries;
+  chartSeries series[CHART_MAX_SERIES];
+} chart;
+
+void initChart(chart *c, const char *title, const char *yLabel, const char *xLabel, int rows, int cols);
+int addChartSeries(chart *c, const double *values, char fillChar, chartStyle style);
+int printChart(FILE *out, const chart *c);
+int getChartHeight(const chart *c, double value);
+void getChartColumns(const double *x, const double *y, const double *weight, int size, double xUnit, double *columns, int cols);
+void getChartEnvelope(const double *x, const double *y, const double *low, const double *high, int size, double xUnit, double *first, double *last, double *min, double *max, int cols);
+void getChartLttb(const double *x, const double *y, int size, double xUnit, double *columns, int cols);
+void fillChartColumns(double *columns, const int *count, int cols);
+void getChartRange(const double *columns, int cols, double *min, double *max);
+
+#endif
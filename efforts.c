@@ -0,0 +1,202 @@
+// GPSReader: analisi a finestre di una traccia (migliori tempi su una distanza, massima distanza in una durata,
+// salite migliori, parziali a distanza fissa) sulle distanze progressive e sui tempi dei punti
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+//
+// Una finestra ha l'arrivo in un punto della traccia e la partenza interpolata, in modo che la distanza (o la durata)
+// sia esatta: la partenza sta tra l'ultimo punto a distanza (o istante) non oltre quella richiesta e il successivo.
+// Spostando l'arrivo in avanti la partenza può solo avanzare, quindi con due indici che avanzano soltanto ogni finestra
+// costa una passata lineare sui punti, qualunque sia la sua lunghezza. Le versioni "Naive" cercano la partenza
+// all'indietro da ogni arrivo (costo proporzionale ai punti della finestra) e servono da riferimento per i benchmark:
+// le due versioni valutano le stesse finestre nello stesso ordine, quindi i risultati coincidono esattamente
+
+#include <string.h>
+
+#include "efforts.h"
+
+static void evalDistanceWindow(const effortTrack *t, int start, int end, double target, double length, effortResult *fastest, effortResult *climb);
+static void evalDurationWindow(const effortTrack *t, int start, int end, double target, double duration, effortResult *longest);
+
+// miglior tempo per percorrere "length" metri e (se climb non è NULL e la traccia ha le quote) maggior dislivello
+// guadagnato su "length" metri, in una sola passata. Restituisce 1 se la traccia è lunga almeno "length" metri
+int findDistanceEffort(const effortTrack *t, double length, effortResult *fastest, effortResult *climb) {
+
+  memset(fastest, 0, sizeof(effortResult));
+  if (climb != NULL) memset(climb, 0, sizeof(effortResult));
+
+  int start = 0;
+
+  for (int end = 1; end < t->numPoints; end++) {
+
+    double target = t->distance[end] - length;
+    if (target < t->distance[0]) continue;
+
+    while (start + 1 < end && t->distance[start + 1] <= target) start++;
+
+    evalDistanceWindow(t, start, end, target, length, fastest, climb);
+  }
+
+  return (fastest->found || (climb != NULL && climb->found));
+}
+
+// massima distanza percorsa in "duration" secondi. Restituisce 1 se la traccia dura almeno "duration" secondi
+int findDurationEffort(const effortTrack *t, double duration, effortResult *longest) {
+
+  memset(longest, 0, sizeof(effortResult));
+
+  int start = 0;
+
+  for (int end = 1; end < t->numPoints; end++) {
+
+    double target = t->time[end] - duration * 1000.0;
+    if (target < t->time[0]) continue;
+
+    while (start + 1 < end && t->time[start + 1] <= target) start++;
+
+    evalDurationWindow(t, start, end, target, duration, longest);
+  }
+
+  return longest->found;
+}
+
+// parziali ogni "step" metri dal primo punto, con tempi e quote interpolati ai confini; l'ultimo parziale è la parte
+// rimanente della traccia. In "splits" vanno al più maxSplits parziali; restituisce quanti sono, anche oltre maxSplits
+int getEffortSplits(const effortTrack *t, double step, effortSplit *splits, int maxSplits) {
+
+  if (t->numPoints < 2 || !(step > 0)) return 0;
+
+  double base = t->distance[0];
+  double prevTime = (double) t->time[0];
+  double prevElevation = (t->elevation != NULL) ? t->elevation[0] : 0.0;
+  int count = 0;
+
+  for (int i = 1; i < t->numPoints; i++) {
+
+    // confini superati dal tratto tra i punti i-1 e i
+    while (t->distance[i] - base >= step * (count + 1)) {
+      double d0 = t->distance[i - 1];
+      double d1 = t->distance[i];
+      double f = (d1 > d0) ? (base + step * (count + 1) - d0) / (d1 - d0) : 1.0;
+      double time = t->time[i - 1] + (t->time[i] - t->time[i - 1]) * f;
+      double elevation = (t->elevation != NULL) ? t->elevation[i - 1] + (t->elevation[i] - t->elevation[i - 1]) * f : 0.0;
+
+      if (count < maxSplits) {
+        splits[count].distance = step;
+        splits[count].time = (time - prevTime) / 1000.0;
+        splits[count].elevation = elevation - prevElevation;
+      }
+
+      count++;
+      prevTime = time;
+      prevElevation = elevation;
+    }
+  }
+
+  int last = t->numPoints - 1;
+  double remaining = t->distance[last] - base - step * count;
+
+  if (remaining > 0) {
+    if (count < maxSplits) {
+      splits[count].distance = remaining;
+      splits[count].time = (t->time[last] - prevTime) / 1000.0;
+      splits[count].elevation = (t->elevation != NULL) ? t->elevation[last] - prevElevation : 0.0;
+    }
+    count++;
+  }
+
+  return count;
+}
+
+// come findDistanceEffort(), cercando la partenza all'indietro da ogni arrivo (riferimento per i benchmark)
+int findDistanceEffortNaive(const effortTrack *t, double length, effortResult *fastest, effortResult *climb) {
+
+  memset(fastest, 0, sizeof(effortResult));
+  if (climb != NULL) memset(climb, 0, sizeof(effortResult));
+
+  for (int end = 1; end < t->numPoints; end++) {
+
+    double target = t->distance[end] - length;
+    if (target < t->distance[0]) continue;
+
+    int start = end - 1;
+    while (start > 0 && t->distance[start] > target) start--;
+
+    evalDistanceWindow(t, start, end, target, length, fastest, climb);
+  }
+
+  return (fastest->found || (climb != NULL && climb->found));
+}
+
+// come findDurationEffort(), cercando la partenza all'indietro da ogni arrivo (riferimento per i benchmark)
+int findDurationEffortNaive(const effortTrack *t, double duration, effortResult *longest) {
+
+  memset(longest, 0, sizeof(effortResult));
+
+  for (int end = 1; end < t->numPoints; end++) {
+
+    double target = t->time[end] - duration * 1000.0;
+    if (target < t->time[0]) continue;
+
+    int start = end - 1;
+    while (start > 0 && t->time[start] > target) start--;
+
+    evalDurationWindow(t, start, end, target, duration, longest);
+  }
+
+  return longest->found;
+}
+
+// finestra di "length" metri con l'arrivo nel punto end e la partenza alla distanza "target", tra i punti start e start + 1:
+// a parità di tempo (o di dislivello) resta la finestra trovata per prima
+static void evalDistanceWindow(const effortTrack *t, int start, int end, double target, double length, effortResult *fastest, effortResult *climb) {
+
+  double d0 = t->distance[start];
+  double d1 = t->distance[start + 1];
+  double f = (d1 > d0) ? (target - d0) / (d1 - d0) : 0.0;
+  double from = t->time[start] + (t->time[start + 1] - t->time[start]) * f;
+  double time = (t->time[end] - from) / 1000.0;
+
+  if (time > 0 && (!fastest->found || time < fastest->time)) {
+    fastest->found = 1;
+    fastest->start = start;
+    fastest->end = end;
+    fastest->startDistance = target;
+    fastest->distance = length;
+    fastest->time = time;
+    fastest->gain = (t->elevation != NULL) ? t->elevation[end] - (t->elevation[start] + (t->elevation[start + 1] - t->elevation[start]) * f) : 0.0;
+  }
+
+  if (climb == NULL || t->elevation == NULL) return;
+
+  double gain = t->elevation[end] - (t->elevation[start] + (t->elevation[start + 1] - t->elevation[start]) * f);
+
+  if (!climb->found || gain > climb->gain) {
+    climb->found = 1;
+    climb->start = start;
+    climb->end = end;
+    climb->startDistance = target;
+    climb->distance = length;
+    climb->time = (time > 0) ? time : 0.0;
+    climb->gain = gain;
+  }
+}
+
+// finestra di "duration" secondi con l'arrivo nel punto end e la partenza all'istante "target" (ms), tra i punti start
+// e start + 1: a parità di distanza resta la finestra trovata per prima
+static void evalDurationWindow(const effortTrack *t, int start, int end, double target, double duration, effortResult *longest) {
+
+  double t0 = (double) t->time[start];
+  double t1 = (double) t->time[start + 1];
+  double f = (t1 > t0) ? (target - t0) / (t1 - t0) : 0.0;
+  double from = t->distance[start] + (t->distance[start + 1] - t->distance[start]) * f;
+  double distance = t->distance[end] - from;
+
+  if (distance > 0 && (!longest->found || distance > longest->distance)) {
+    longest->found = 1;
+    longest->start = start;
+    longest->end = end;
+    longest->startDistance = from;
+    longest->distance = distance;
+    longest->time = duration;
+    longest->gain = (t->elevation != NULL) ? t->elevation[end] - (t->elevation[start] + (t->elevation[start + 1] - t->elevation[start]) * f) : 0.0;
+  }
+}
@@ -0,0 +1,54 @@
+// GPSReader: analisi a finestre di una traccia (migliori tempi su una distanza, massima distanza in una durata,
+// salite migliori, parziali a distanza fissa) sulle distanze progressive e sui tempi dei punti
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef EFFORTS_H
+#define EFFORTS_H
+
+#include <stdint.h>
+
+// tipo di finestra: una distanza (m) da percorrere nel minor tempo, o una durata (s) in cui percorrere più strada
+typedef enum {
+  EFFORT_DISTANCE,
+  EFFORT_DURATION
+} effortType;
+
+// finestra richiesta
+typedef struct {
+  effortType type;
+  double length;              // m o s, secondo il tipo
+} effortWindow;
+
+// punti di una traccia: distanze progressive e istanti non decrescenti; le quote servono solo per le salite
+typedef struct {
+  int numPoints;
+  const double *distance;     // distanza progressiva (m) del punto i
+  const int64_t *time;        // istante (ms) del punto i
+  const double *elevation;    // quota (m) del punto i, NULL se non serve
+} effortTrack;
+
+// risultato di una finestra: la partenza è interpolata tra i punti start e start + 1, l'arrivo è il punto end
+typedef struct {
+  int found;                  // 0 se la traccia è più corta della finestra (o non ha i tempi)
+  int start;
+  int end;
+  double startDistance;       // distanza progressiva (m) della partenza
+  double distance;            // m percorsi
+  double time;                // s impiegati
+  double gain;                // m di dislivello tra partenza e arrivo
+} effortResult;
+
+// parziale a distanza fissa (l'ultimo può essere più corto)
+typedef struct {
+  double distance;            // m
+  double time;                // s
+  double elevation;           // variazione di quota (m)
+} effortSplit;
+
+int findDistanceEffort(const effortTrack *t, double length, effortResult *fastest, effortResult *climb);
+int findDurationEffort(const effortTrack *t, double duration, effortResult *longest);
+int getEffortSplits(const effortTrack *t, double step, effortSplit *splits, int maxSplits);
+int findDistanceEffortNaive(const effortTrack *t, double length, effortResult *fastest, effortResult *climb);
+int findDurationEffortNaive(const effortTrack *t, double duration, effortResult *longest);
+
+#endif
@@ -15,589 +15,4813 @@
 // - Calcolo distanze tra ogni singolo punto (latitudine/longitudine) della traccia: applicando la formula dell'emisenoverso 
 // (https://it.wikipedia.org/wiki/Formula_dell%27emisenoverso)
 //
-// Uso: gpsreader [file] [width] [height] [debug]
+// Uso: gpsreader [opzioni] [file] [width] [height] [debug]
 //      
+//      [opzioni] --parser=stream (default) lettura in streaming a memoria costante
+//                --parser=dom lettura dell'intero documento in memoria (DOM libxml2)
+//                --parser=parallel lettura dei punti a blocchi su più thread (--parse-threads=N)
+//                --parser=mmap file mappato in memoria, letto con un tokenizer minimo
+//                --cache usa (e scrive) la cache binaria <file>.gpsc
+//                --arena memoria dell'elaborazione da un'arena per thread, azzerata a fine file
+//                --chart=elevation,speed,hr,grade grafici da stampare (--chart-x=distance|time)
+//                --downsample=m4|lttb|avg riduzione dei punti alle colonne del grafico altimetrico
+//                --smooth=median[:N]|kalman, --hysteresis=M, --resample=M filtro delle quote per il dislivello
+//                --format=json|csv|ndjson output per l'elaborazione automatica (--series: anche le serie dei punti)
+//                --near=LAT,LON punto di ogni segmento più vicino alle coordinate (con dom o --cache)
+//                --distance=haversine|wgs84|flat sfera, ellissoide WGS-84 (Vincenty) o piano tangente per le distanze
+//                --efforts[=LISTA] migliori tempi su distanze e durate, salite migliori e parziali per Km
+//                --stats tempi, chiamate, punti/s e memoria delle fasi dell'elaborazione
+//                --serve=SOCKET server su un socket Unix (--serve-queue=N), --client=SOCKET per inviargli un file
 //      [file] nome del file GPX da elaborare
 //      [width] larghezza (in caratteri) del grafico altimetrico
 //      [height] altezza (in caratteri) del grafico altimetrico
 //      [debug] 0 = debug disattivo; 1 = debug attivo
 //
 // Compilazione:
-// gcc gpsreader.c -o gpsreader.out -I/usr/include/libxml2 -lxml2 -lm
+// gcc gpsreader.c cache.c index.c serve.c bench.c chart.c textbuf.c spatial.c efforts.c -o gpsreader.out -I/usr/include/libxml2 -lxml2 -lm -pthread
 //
 // Run di esempio:
 // clear && ./gpsreader.out samples/trailrunning.gpx 60 40
 //
 
+// memmem()
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <strings.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "gpsreader.h"
+#include "cache.h"
+#include "index.h"
+#include "serve.h"
+#include "bench.h"
+
+// contatore delle espressioni XPath valutate (usato in modalità debug); uno per thread
+_Thread_local long _XPATH_EVALS_ = 0;
+
+// funzioni usate per il calcolo delle distanze, una per modello della Terra, scelte alla prima chiamata di getSegmentDistances()
+distanceKernel _DISTANCE_KERNELS_[DISTANCE_MODES] = { NULL };
+
+// arena di memoria del thread, attiva durante l'elaborazione di un file con --arena
+_Thread_local memoryArena _ARENA_ = {0};
+
+// contatori delle richieste di memoria passate da arenaMalloc() e simili, e delle chiamate effettive a malloc()
+long _ALLOCATIONS_ = 0;
+long _SYSTEM_ALLOCATIONS_ = 0;
+
+// global variable: 1 = --stats, misura tempi e contatori delle fasi
+int _STATS_ = 0;
+
+// tempi e contatori delle fasi del thread, sommati a _STATS_TOTAL_ alla fine del thread, e timer della fase in corso
+_Thread_local statsEntry _THREAD_STATS_[STATS_STAGES] = {{0}};
+_Thread_local statsTimer *_STATS_TIMER_ = NULL;
+
+// tempi e contatori di tutti i thread; inizio della misura (tick e tempo, per convertire i tick in ns)
+statsEntry _STATS_TOTAL_[STATS_STAGES] = {{0}};
+pthread_mutex_t _STATS_MUTEX_ = PTHREAD_MUTEX_INITIALIZER;
+uint64_t _STATS_START_TICKS_ = 0;
+struct timespec _STATS_START_TIME_;
+
+// buffer in cui sono composti i record JSON/CSV, riutilizzato per tutti i record del thread
+_Thread_local textBuffer _RECORD_BUFFER_ = {0};
+
+// record JSON/CSV scritti dal thread per il file in elaborazione
+_Thread_local long _FILE_RECORDS_ = 0;
+
+// global variable con la cartella o l'elenco dei file da elaborare in modalità batch (NULL = un solo file)
+const char *_BATCH_ = NULL;
+
+// global variable con il numero di thread della modalità batch (0 = tanti quanti i core)
+int _THREADS_ = 0;
+
+// global variable con l'intervallo (s) tra due controlli del file nella modalità --follow (0 = modalità non attiva)
+double _FOLLOW_ = 0.0;
+
+// global variable con i secondi senza nuovi dati dopo i quali --follow termina (0 = solo con Ctrl+C)
+double _FOLLOW_IDLE_ = 0.0;
+
+// global variable impostata da SIGINT/SIGTERM per terminare --follow
+volatile sig_atomic_t _FOLLOW_STOP_ = 0;
+
+// main
+int main(int argc, char *argv[]) {
+
+  // impostazioni dell'elaborazione, completate dalla riga di comando
+  jobConfig config = {
+    .altigraphSize = { .rows = DEFAULT_ALTIGRAPH_ROWS, .cols = DEFAULT_ALTIGRAPH_COLS },
+    .parserMode = PARSER_STREAM,
+    .hrMax = DEFAULT_HR_MAX,
+    .distance = DISTANCE_HAVERSINE,
+    .charts = SERIES_ELEVATION,
+    .chartAxis = AXIS_DISTANCE,
+    .downsample = DOWNSAMPLE_M4,
+    .smoothing = SMOOTH_NONE,
+    .smoothWindow = DEFAULT_SMOOTH_WINDOW,
+    .format = FORMAT_TEXT,
+    .index = NULL,
+    .out = stdout,
+    .messages = NULL
+  };
+
+  // argomenti posizionali (tutto ciò che non è un'opzione "--nome=valore")
+  char *args[argc];
+  int numArgs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) == 0) {
+      if (!parseOption(argv[i], &config)) {
+        printf("Opzione non riconosciuta: %s\n", argv[i]);
+        return 1;
+      }
+      continue;
+    }
+    args[numArgs++] = argv[i];
+  }
+
+  // server e client elaborano (o inviano) una richiesta alla volta, senza batch, indice né --follow
+  if ((_SERVE_ != NULL || _CLIENT_ != NULL) && _BENCH_ == NULL && (_BATCH_ != NULL || _INDEX_ != NULL || _FOLLOW_ > 0)) {
+    fprintf(getMessageStream(&config), "--batch, --index e --follow non sono disponibili con --serve o --client: le opzioni vengono ignorate\n");
+    _BATCH_ = NULL;
+    _INDEX_ = NULL;
+    _FOLLOW_ = 0.0;
+  }
+
+  // in modalità batch, nel server (e nei benchmark) i file non sono tra gli argomenti: il primo argomento è [width]
+  int first = (_BATCH_ != NULL || _BENCH_ != NULL || _SERVE_ != NULL) ? 0 : 1;
+
+  const char *filename = (first && numArgs > 0) ? args[0] : NULL;
+  
+  // per attivare il debug
+  config.debug = ((numArgs > first + 2) ? atoi(args[first + 2]) : 0);
+  config.altigraphSize.rows = ((numArgs > first + 1) ? abs(atoi(args[first + 1])) : DEFAULT_ALTIGRAPH_ROWS);
+  config.altigraphSize.cols = ((numArgs > first) ? abs(atoi(args[first])) : DEFAULT_ALTIGRAPH_COLS);
+
+  // l'intestazione non deve finire nell'output JSON/CSV
+  if (config.format == FORMAT_TEXT) printf("\n[ C GPS Reader v1.0 - by gabriele.bernuzzi@studenti.unimi.it ]\n");
+
+  // validazione argomenti
+  if (first && (numArgs < 1 ? (_INDEX_ == NULL && _CLIENT_ == NULL) : !fileExists(filename))) {
+    printf("Uso: gpsreader [opzioni] [file] [width] [height] [debug]\n\t\n\t\n[opzioni]\n  --parser=stream lettura in streaming, a memoria costante (default)\n  --parser=dom lettura dell'intero documento in memoria\n  --parser=parallel lettura dei punti di ogni segmento a blocchi, su più thread\n  --parser=mmap file mappato in memoria e letto senza libxml2\n  --parse-threads=N numero di thread per --parser=parallel (default: numero di core)\n  --arena memoria dell'elaborazione (anche di libxml2) da un'arena azzerata a fine file\n  --cache usa la cache binaria <file>.gpsc (scritta alla prima lettura del file)\n  --hr-max=N frequenza cardiaca massima per le zone cardiache (default: 190)\n  --chart=LISTA grafici da stampare, separati da virgole: elevation, speed, hr, grade, none (default: elevation)\n  --chart-x=distance|time asse x dei grafici (default: distance)\n  --smooth=median[:N]|kalman|none livellamento delle quote per il dislivello (mediana mobile di N campioni, default 5, o Kalman)\n  --hysteresis=M il dislivello cresce solo per variazioni di quota di almeno M metri\n  --resample=M le quote per il dislivello sono ricampionate ogni M metri di distanza\n  --downsample=m4|lttb|avg riduzione dei punti alle colonne del grafico altimetrico: inviluppo min/max, Largest-Triangle-Three-Buckets o media (default: m4)\n  --format=text|json|csv|ndjson formato dell'output: testo (default), array JSON, CSV o un oggetto JSON per riga\n  --series con --format: anche il profilo altimetrico e le serie dei punti di ogni segmento\n  --near=LAT,LON per ogni segmento il punto più vicino e la distanza lungo la traccia (con --parser=dom o --cache)\n  --distance=haversine|wgs84|flat modello della Terra per le distanze: sfera (emisenoverso, default), ellissoide WGS-84 (Vincenty) o piano tangente all'ellissoide (più veloce)\n  --efforts[=LISTA] migliori tempi su distanze e durate (ad es. 1km,400m,5min,1h; default: 1km,5km,10km,5min,20min), salite migliori e parziali per Km di ogni segmento\n  --index=FILE aggiunge le tracce dei file (o del batch) all'indice delle attività FILE e ne stampa il riepilogo: settimane, migliori tempi, distribuzioni di quota e zone cardiache\n  --follow[=S] segue il file mentre cresce, controllandolo ogni S secondi (default 1): si leggono solo i punti aggiunti e si stampano le metriche aggiornate\n  --follow-idle=S con --follow, termina dopo S secondi senza nuovi dati (default: solo con Ctrl+C)\n  --stats a fine elaborazione, tempo, chiamate, punti/s e memoria di ogni fase\n  --batch=[dir|lista|-] elabora tutti i file .gpx di una cartella, o quelli elencati in un file (- = standard input); [file] va omesso\n  --threads=N numero di thread per la modalità batch (default: numero di core)\n  --serve=SOCKET resta in ascolto sul socket Unix SOCKET ed elabora le richieste (file GPX o percorsi) su --threads thread, con le opzioni della riga di comando; Ctrl+C per terminare\n  --serve-queue=N con --serve, richieste al più in attesa di un thread: oltre, la risposta è BUSY (default: 64)\n  --client=SOCKET invia [file] al server su SOCKET con le opzioni che valgono per una richiesta (--format, --chart, --efforts, ...) e stampa la risposta; senza file, contatori e latenze del server\n  --client-path con --client, invia il percorso assoluto del file invece del contenuto\n  --bench=segments benchmark su tracce sintetiche con un numero crescente di segmenti\n  --bench=distance confronto tra getDistance() e il calcolo vettoriale delle distanze\n  --bench=geodesic costo ed errore dei modelli di --distance, per lunghezza dei segmenti\n  --bench=batch file/s della modalità batch da 1 a N thread\n  --bench=parallel lettura parallela di una traccia sintetica con un numero crescente di blocchi\n  --bench=arena allocazioni e picco di memoria su samples/cycling.gpx, con e senza arena\n  --bench=cache tempi di una traccia di 100000 punti con e senza cache\n  --bench=parser MB/s delle modalità di lettura sui file di samples/ (o di --batch)\n  --bench=chart costo per cella della stampa di un grafico 1000 x 500\n  --bench=export record/s dei formati di output sul carico batch e costo della formattazione dei numeri\n  --bench=stages tempi di lettura, estrazione, metriche, profilo e grafico su una traccia sintetica (ns/punto, MB/s)\n  --synthetic=points=N,segments=S,ext,noise=M,seed=K traccia sintetica di --bench=stages (default: 200000 punti in 4 segmenti)\n  --bench-json=FILE scrive anche in FILE i risultati di --bench=stages in JSON\n  --bench=spatial ricerche del punto più vicino e in un rettangolo su 100000 punti, con l'indice e scorrendo i punti\n  --bench=follow costo di un aggiornamento di --follow su una traccia che cresce, contro la rilettura completa del file\n  --bench=index costo dell'aggiunta e dell'aggiornamento di un'attività in un indice di 100000 attività\n  --bench=efforts costo dell'analisi a finestre su una traccia di 1000000 di punti, contro la ricerca all'indietro da ogni arrivo\n  --bench=serve richieste/s e latenze di --serve su samples/cycling.gpx, contro un processo per file\n  --bench=golden confronta le metriche dei file di samples/ con i valori attesi di samples/golden.csv\n\t\n[file]\n  nome del file GPX da elaborare\n\t\n[width]\n  larghezza (in caratteri) del grafico altimetrico\n\t\n[height]\n  altezza (in caratteri) del grafico altimetrico\n\t\n[debug]\n  0 = debug disattivo; 1 = debug attivo\n\n");
+    return 1;
+  }
+
+  // un grafico senza colonne o senza righe non ha senso (e "abc" vale 0)
+  if (config.altigraphSize.cols <= 0 || config.altigraphSize.rows <= 0) {
+    fprintf(getMessageStream(&config), "[width] e [height] devono essere numeri maggiori di 0\n");
+    return 1;
+  }
+
+  if (config.debug) { fprintf(getMessageStream(&config), "\n\t[Debug mode ON]\n"); }
+
+  // le altre modalità di lettura non conservano le coordinate dei punti
+  if (config.nearPoint && config.parserMode != PARSER_DOM && !config.cache) {
+    fprintf(getMessageStream(&config), "--near richiede --parser=dom o --cache: l'opzione viene ignorata\n");
+  }
+
+  // --follow segue un solo file
+  if (_FOLLOW_ > 0 && (_BATCH_ != NULL || _INDEX_ != NULL)) {
+    fprintf(getMessageStream(&config), "--follow non è disponibile in modalità batch o con --index: l'opzione viene ignorata\n");
+    _FOLLOW_ = 0.0;
+  }
+
+  // indice delle attività: le tracce dei file vi vengono aggiunte, poi se ne stampa il riepilogo (anche senza file)
+  activityIndex index;
+
+  if (_INDEX_ != NULL && _BENCH_ == NULL) {
+    if (config.format == FORMAT_CSV) {
+      fprintf(stderr, "Il riepilogo dell'indice non è disponibile in formato CSV\n");
+      return 1;
+    }
+
+    if (!openActivityIndex(&index, _INDEX_)) {
+      fprintf(getMessageStream(&config), "Impossibile usare l'indice delle attività \"%s\"\n", _INDEX_);
+      return 1;
+    }
+
+    config.index = &index;
+  }
+
+  // con --arena (e per i benchmark che la usano) le allocazioni di libxml2 passano da arenaMalloc() e simili:
+  // va fatto prima di inizializzare il parser
+  if (config.arena || _STATS_ || (_BENCH_ != NULL && (strcmp(_BENCH_, "serve") == 0 || strcmp(_BENCH_, "arena") == 0 || strcmp(_BENCH_, "golden") == 0))) {
+    xmlMemSetup(arenaFree, arenaMalloc, arenaRealloc, arenaStrdup);
+  }
+
+  if (_STATS_) startStats();
+
+  // Inizializzazione parser libxml (una sola volta, prima di avviare eventuali thread)
+  xmlInitParser();
+
+  int ret;
+
+  if (_BENCH_ != NULL) {
+    ret = runBenchmark(&config, _BENCH_);
+  } else if (_SERVE_ != NULL) {
+    ret = serveRequests(&config, _SERVE_, _THREADS_);
+  } else if (_CLIENT_ != NULL) {
+    ret = runClient(&config, _CLIENT_, filename, argc, argv, (numArgs > 1) ? config.altigraphSize.cols : 0, (numArgs > 2) ? config.altigraphSize.rows : 0);
+  } else {
+    printOutputBegin(&config, config.out);
+    ret = (_BATCH_ != NULL) ? processBatch(&config, _BATCH_, _THREADS_) : (_FOLLOW_ > 0) ? processFileFollow(&config, filename) : (filename != NULL) ? processFile(&config, filename) : 0;
+
+    if (config.index != NULL) {
+      printIndexReport(&config, config.index, _INDEX_);
+      closeActivityIndex(config.index);
+    }
+
+    printOutputEnd(&config, config.out);
+  }
+
+  if (_STATS_) printStats(&config);
+
+  xmlCleanupParser();
+  releaseArena();
+  releaseRecordBuffer();
+    
+  return ret;
+}
+
+// interpreta un'opzione "--nome=valore"; restituisce 0 se l'opzione non è riconosciuta
+int parseOption(const char *option, jobConfig *config) {
+
+  if (strcmp(option, "--parser=stream") == 0) {
+    config->parserMode = PARSER_STREAM;
+    return 1;
+  }
+
+  if (strcmp(option, "--parser=dom") == 0) {
+    config->parserMode = PARSER_DOM;
+    return 1;
+  }
+
+  if (strcmp(option, "--parser=parallel") == 0) {
+    config->parserMode = PARSER_PARALLEL;
+    return 1;
+  }
+
+  if (strcmp(option, "--parser=mmap") == 0) {
+    config->parserMode = PARSER_MMAP;
+    return 1;
+  }
+
+  if (strcmp(option, "--arena") == 0) {
+    config->arena = 1;
+    return 1;
+  }
+
+  if (strcmp(option, "--cache") == 0) {
+    config->cache = 1;
+    return 1;
+  }
+
+  if (strncmp(option, "--parse-threads=", 16) == 0) {
+    config->parseThreads = atoi(option + 16);
+    return (config->parseThreads > 0);
+  }
+
+  if (strncmp(option, "--near=", 7) == 0) {
+    char *end;
+    config->nearLat = strtod(option + 7, &end);
+    if (*end != ',') return 0;
+    config->nearLon = strtod(end + 1, &end);
+    config->nearPoint = 1;
+    return (*end == '\0' && fabs(config->nearLat) <= 90 && fabs(config->nearLon) <= 180);
+  }
+
+  if (strcmp(option, "--efforts") == 0) {
+    return parseEffortList(DEFAULT_EFFORTS, config);
+  }
+
+  if (strncmp(option, "--efforts=", 10) == 0) {
+    return parseEffortList(option + 10, config);
+  }
+
+  if (strncmp(option, "--hr-max=", 9) == 0) {
+    config->hrMax = atoi(option + 9);
+    return (config->hrMax > 0);
+  }
+
+  if (strncmp(option, "--chart=", 8) == 0) {
+    config->charts = parseChartList(option + 8);
+    return (config->charts >= 0);
+  }
+
+  if (strcmp(option, "--downsample=avg") == 0) {
+    config->downsample = DOWNSAMPLE_AVG;
+    return 1;
+  }
+
+  if (strcmp(option, "--downsample=m4") == 0) {
+    config->downsample = DOWNSAMPLE_M4;
+    return 1;
+  }
+
+  if (strcmp(option, "--downsample=lttb") == 0) {
+    config->downsample = DOWNSAMPLE_LTTB;
+    return 1;
+  }
+
+  if (strcmp(option, "--smooth=none") == 0) {
+    config->smoothing = SMOOTH_NONE;
+    return 1;
+  }
+
+  if (strcmp(option, "--smooth=kalman") == 0) {
+    config->smoothing = SMOOTH_KALMAN;
+    return 1;
+  }
+
+  if (strncmp(option, "--smooth=median", 15) == 0) {
+    config->smoothing = SMOOTH_MEDIAN;
+    if (option[15] == '\0') return 1;
+    config->smoothWindow = atoi(option + 16);
+    return (option[15] == ':' && config->smoothWindow > 0 && config->smoothWindow <= SMOOTH_MAX_WINDOW);
+  }
+
+  if (strncmp(option, "--hysteresis=", 13) == 0) {
+    config->hysteresis = atof(option + 13);
+    return (config->hysteresis >= 0);
+  }
+
+  if (strncmp(option, "--resample=", 11) == 0) {
+    config->resampleDistance = atof(option + 11);
+    return (config->resampleDistance >= 0);
+  }
+
+  if (strcmp(option, "--format=text") == 0) {
+    config->format = FORMAT_TEXT;
+    return 1;
+  }
+
+  if (strcmp(option, "--format=json") == 0) {
+    config->format = FORMAT_JSON;
+    return 1;
+  }
+
+  if (strcmp(option, "--format=csv") == 0) {
+    config->format = FORMAT_CSV;
+    return 1;
+  }
+
+  if (strcmp(option, "--format=ndjson") == 0) {
+    config->format = FORMAT_NDJSON;
+    return 1;
+  }
+
+  if (strcmp(option, "--series") == 0) {
+    config->exportSeries = 1;
+    return 1;
+  }
+
+  if (strcmp(option, "--chart-x=distance") == 0) {
+    config->chartAxis = AXIS_DISTANCE;
+    return 1;
+  }
+
+  if (strcmp(option, "--chart-x=time") == 0) {
+    config->chartAxis = AXIS_TIME;
+    return 1;
+  }
+
+  if (strncmp(option, "--batch=", 8) == 0) {
+    _BATCH_ = option + 8;
+    return 1;
+  }
+
+  if (strncmp(option, "--threads=", 10) == 0) {
+    _THREADS_ = atoi(option + 10);
+    return (_THREADS_ > 0);
+  }
+
+  if (strncmp(option, "--index=", 8) == 0) {
+    _INDEX_ = option + 8;
+    return (_INDEX_[0] != '\0');
+  }
+
+  if (strcmp(option, "--follow") == 0) {
+    _FOLLOW_ = FOLLOW_INTERVAL;
+    return 1;
+  }
+
+  if (strncmp(option, "--follow=", 9) == 0) {
+    _FOLLOW_ = atof(option + 9);
+    return (_FOLLOW_ > 0);
+  }
+
+  if (strncmp(option, "--follow-idle=", 14) == 0) {
+    _FOLLOW_IDLE_ = atof(option + 14);
+    return (_FOLLOW_IDLE_ > 0);
+  }
+
+  if (strcmp(option, "--distance=haversine") == 0) {
+    config->distance = DISTANCE_HAVERSINE;
+    return 1;
+  }
+
+  if (strcmp(option, "--distance=wgs84") == 0) {
+    config->distance = DISTANCE_WGS84;
+    return 1;
+  }
+
+  if (strcmp(option, "--distance=flat") == 0) {
+    config->distance = DISTANCE_FLAT;
+    return 1;
+  }
+
+  if (strncmp(option, "--serve=", 8) == 0) {
+    _SERVE_ = option + 8;
+    return (_SERVE_[0] != '\0');
+  }
+
+  if (strncmp(option, "--serve-queue=", 14) == 0) {
+    _SERVE_QUEUE_ = atoi(option + 14);
+    return (_SERVE_QUEUE_ > 0);
+  }
+
+  if (strncmp(option, "--client=", 9) == 0) {
+    _CLIENT_ = option + 9;
+    return (_CLIENT_[0] != '\0');
+  }
+
+  if (strcmp(option, "--client-path") == 0) {
+    _CLIENT_PATH_ = 1;
+    return 1;
+  }
+
+  if (strcmp(option, "--stats") == 0) {
+    _STATS_ = 1;
+    return 1;
+  }
+
+  if (strncmp(option, "--bench=", 8) == 0) {
+    _BENCH_ = option + 8;
+    return 1;
+  }
+
+  if (strncmp(option, "--synthetic=", 12) == 0) {
+    syntheticTrack track;
+    _SYNTHETIC_ = option + 12;
+    return parseSyntheticSpec(_SYNTHETIC_, &track);
+  }
+
+  if (strncmp(option, "--bench-json=", 13) == 0) {
+    _BENCH_JSON_ = option + 13;
+    return 1;
+  }
+
+  return 0;
+}
+
+// elenco dei grafici separati da virgole (elevation,speed,hr,grade): restituisce i bit SERIES_*, -1 se un nome non è valido
+int parseChartList(const char *list) {
+
+  static const struct { const char *name; int series; } names[] = {
+    { "elevation", SERIES_ELEVATION }, { "speed", SERIES_SPEED }, { "hr", SERIES_HR }, { "grade", SERIES_GRADE }, { "none", 0 }
+  };
+
+  int charts = 0;
+
+  while (*list != '\0') {
+    size_t length = strcspn(list, ",");
+    int found = 0;
+
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+      if (strlen(names[i].name) == length && strncmp(list, names[i].name, length) == 0) {
+        charts |= names[i].series;
+        found = 1;
+      }
+    }
+
+    if (!found) return -1;
+
+    list += length;
+    if (*list == ',') list++;
+  }
+
+  return charts;
+}
+
+// elenco delle finestre di --efforts separate da virgole: distanze (1km, 400m) e durate (5min, 30s, 1h).
+// Restituisce 0 se un elemento non è valido o se sono più di EFFORTS_MAX
+int parseEffortList(const char *list, jobConfig *config) {
+
+  static const struct { const char *unit; effortType type; double scale; } units[] = {
+    { "km", EFFORT_DISTANCE, 1000.0 }, { "m", EFFORT_DISTANCE, 1.0 }, { "min", EFFORT_DURATION, 60.0 }, { "s", EFFORT_DURATION, 1.0 }, { "h", EFFORT_DURATION, 3600.0 }
+  };
+
+  config->numEfforts = 0;
+
+  while (*list != '\0') {
+    size_t length = strcspn(list, ",");
+    char *end;
+    double value = strtod(list, &end);
+    size_t unitLength = length - (end - list);
+    int found = 0;
+
+    for (int i = 0; i < (int)(sizeof(units) / sizeof(units[0])) && !found && end > list && value > 0 && isfinite(value); i++) {
+      if (strlen(units[i].unit) == unitLength && strncmp(end, units[i].unit, unitLength) == 0) {
+        if (config->numEfforts == EFFORTS_MAX) return 0;
+        config->efforts[config->numEfforts].type = units[i].type;
+        config->efforts[config->numEfforts].length = value * units[i].scale;
+        config->numEfforts++;
+        found = 1;
+      }
+    }
+
+    if (!found) return 0;
+
+    list += length;
+    if (*list == ',') list++;
+  }
+
+  return (config->numEfforts > 0);
+}
+
+// processing del file XML, con la modalità di lettura scelta
+int processFile(const jobConfig *job, const char *filename) {
+
+  _FILE_RECORDS_ = 0;
+
+  // con l'arena attiva l'elaborazione prosegue normalmente; alla fine tutta la sua memoria viene recuperata in un colpo
+  if (job->arena && !_ARENA_.active) {
+    _ARENA_.active = 1;
+    int ret = processFile(job, filename);
+    resetArena();
+    return ret;
+  }
+
+  if (job->index != NULL) {
+    return indexFile(job, filename);
+  }
+
+  if (job->cache) {
+    return processFileCached(job, filename);
+  }
+
+  switch (job->parserMode) {
+    case PARSER_DOM: return processFileDom(job, filename);
+    case PARSER_PARALLEL: return processFileParallel(job, filename);
+    case PARSER_MMAP: return processFileMmap(job, filename);
+    default: return processFileStream(job, filename);
+  }
+}
+
+// elaborazione di più file su un pool di thread (tanti quanti i core, se numThreads è 0); l'output di ogni file
+// è raccolto in memoria e stampato nell'ordine dell'elenco, indipendentemente dall'ordine di completamento
+int processBatch(const jobConfig *config, const char *source, int numThreads) {
+
+  fileList files;
+  if (!getBatchFiles(source, &files)) {
+    printf("Impossibile leggere l'elenco dei file da \"%s\"\n", source);
+    return 1;
+  }
+
+  if (numThreads <= 0) {
+    numThreads = getNumCores();
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  long records = 0;
+  int failed = runBatch(config, &files, numThreads, config->out, &records);
+
+  double elapsed = getElapsedSeconds(&start);
+
+  // con l'output JSON/CSV il riepilogo va sullo standard error, con il numero di record
+  if (config->format == FORMAT_TEXT) {
+    fprintf(config->out, "[ Batch: %d file (%d con errori), %d thread, %.2lf s, %.1lf file/s ]\n", files.size, failed, numThreads, elapsed, (elapsed > 0) ? files.size / elapsed : 0.0);
+  } else {
+    fprintf(stderr, "[ Batch: %d file (%d con errori), %d thread, %.2lf s, %.1lf file/s, %ld record, %.1lf record/s ]\n", files.size, failed, numThreads, elapsed, (elapsed > 0) ? files.size / elapsed : 0.0, records, (elapsed > 0) ? records / elapsed : 0.0);
+  }
+
+  freeFileList(&files);
+
+  return (failed > 0) ? 1 : 0;
+}
+
+// elabora i file dell'elenco con numThreads thread, scrivendo su "out" i risultati nell'ordine dell'elenco (e in
+// "records", se non è NULL, il numero di record JSON/CSV); restituisce il numero di file che non è stato possibile elaborare
+int runBatch(const jobConfig *config, const fileList *files, int numThreads, FILE *out, long *records) {
+
+  batchQueue queue;
+  queue.config = config;
+  queue.files = files;
+  queue.results = calloc(files->size > 0 ? files->size : 1, sizeof(batchResult));
+  queue.next = 0;
+  pthread_mutex_init(&queue.mutex, NULL);
+  pthread_cond_init(&queue.completed, NULL);
+
+  if (numThreads > files->size) numThreads = (files->size > 0) ? files->size : 1;
+
+  pthread_t threads[numThreads];
+  for (int t = 0; t < numThreads; t++) {
+    pthread_create(&threads[t], NULL, batchWorker, &queue);
+  }
+
+  // i risultati vengono scritti appena disponibili, ma sempre nell'ordine dell'elenco
+  int failed = 0;
+  long numRecords = 0;
+
+  for (int i = 0; i < files->size; i++) {
+    batchResult *result = &(queue.results[i]);
+
+    pthread_mutex_lock(&queue.mutex);
+    while (!result->done) {
+      pthread_cond_wait(&queue.completed, &queue.mutex);
+    }
+    pthread_mutex_unlock(&queue.mutex);
+
+    // nell'array JSON i record di un file sono separati da quelli dei file precedenti da una virgola
+    if (config->format == FORMAT_JSON && result->records > 0 && numRecords > 0) fputs(",\n", out);
+
+    fwrite(result->output, 1, result->outputSize, out);
+    free(result->output);
+
+    numRecords += result->records;
+    if (result->ret != 0) failed++;
+  }
+
+  if (records != NULL) *records = numRecords;
+
+  for (int t = 0; t < numThreads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  pthread_mutex_destroy(&queue.mutex);
+  pthread_cond_destroy(&queue.completed);
+  free(queue.results);
+
+  return failed;
+}
+
+// thread del pool: prende il prossimo file dell'elenco e lo elabora con le proprie impostazioni,
+// scrivendo l'output in un buffer in memoria
+void *batchWorker(void *arg) {
+
+  batchQueue *queue = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&queue->mutex);
+    int i = queue->next++;
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (i >= queue->files->size) break;
+
+    batchResult *result = &(queue->results[i]);
+
+    jobConfig job = *(queue->config);
+    job.out = open_memstream(&(result->output), &(result->outputSize));
+
+    result->ret = processFile(&job, queue->files->files[i]);
+    result->records = _FILE_RECORDS_;
+
+    fclose(job.out);
+
+    pthread_mutex_lock(&queue->mutex);
+    result->done = 1;
+    pthread_cond_broadcast(&queue->completed);
+    pthread_mutex_unlock(&queue->mutex);
+  }
+
+  mergeThreadStats();
+  releaseArena();
+  releaseRecordBuffer();
+  return NULL;
+}
+
+// costruisce l'elenco dei file di un batch: se "source" è una cartella, tutti i suoi file .gpx in ordine alfabetico;
+// altrimenti un file (o lo standard input, se "-") con un percorso per riga. Restituisce 0 in caso di errore
+int getBatchFiles(const char *source, fileList *list) {
+
+  list->size = 0;
+  list->capacity = 64;
+  list->files = malloc(sizeof(char*) * list->capacity);
+
+  struct stat info;
+  if (strcmp(source, "-") != 0 && stat(source, &info) == 0 && S_ISDIR(info.st_mode)) {
+
+    DIR *dir = opendir(source);
+    if (dir == NULL) return 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+      size_t length = strlen(entry->d_name);
+      if (length < 4 || strcasecmp(entry->d_name + length - 4, ".gpx") != 0) continue;
+
+      char *path = malloc(strlen(source) + length + 2);
+      sprintf(path, "%s/%s", source, entry->d_name);
+      addFile(list, path);
+    }
+    closedir(dir);
+
+    qsort(list->files, list->size, sizeof(char*), compareFileNames);
+    return 1;
+  }
+
+  FILE *fp = (strcmp(source, "-") == 0) ? stdin : fopen(source, "r");
+  if (fp == NULL) return 0;
+
+  char line[4096];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') continue;
+    addFile(list, strdup(line));
+  }
+
+  if (fp != stdin) fclose(fp);
+  return 1;
+}
+
+// aggiunge un percorso all'elenco (il percorso deve essere già allocato: sarà liberato da freeFileList)
+void addFile(fileList *list, char *path) {
+  if (list->size == list->capacity) {
+    list->capacity *= 2;
+    list->files = realloc(list->files, sizeof(char*) * list->capacity);
+  }
+  list->files[list->size++] = path;
+}
+
+// libera la memoria dell'elenco dei file
+void freeFileList(fileList *list) {
+  for (int i = 0; i < list->size; i++) free(list->files[i]);
+  free(list->files);
+}
+
+// confronto tra percorsi per qsort
+int compareFileNames(const void *a, const void *b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// numero di core disponibili
+int getNumCores(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return (cores > 0) ? (int)cores : 1;
+}
+
+// processing del file XML caricando tutto il documento in memoria (DOM)
+int processFileDom(const jobConfig *job, const char *filename) {
+
+  // parsing file XML
+  STATS_BEGIN(parseTimer, STAT_PARSE);
+  xmlDocPtr xmlDoc = xmlParseFile(filename);
+  STATS_END(parseTimer, 0);
+
+  if (xmlDoc == NULL) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  // Creazione di un "contesto" nell'ambito del documento XML nel quale sarà valutata una certa espressione XPath
+  // Questo specifico contesto racchiude tutto il documento (verrà usato infatti per cercare le tracce)
+  xmlXPathContextPtr docContext = xmlXPathNewContext(xmlDoc);
+
+  // namespace per identificare il contenuto come aderente al formato GPX
+  xmlXPathRegisterNs(docContext, (xmlChar*)"gpx", (xmlChar*) GPX_NAMESPACE_STR);
+
+  // Ricerca delle tracce: sono nei nodi /gpx/trk; i segmenti (trkseg) e i loro punti sono cercati
+  // a partire dal nodo della traccia, in modo che ogni punto sia letto una sola volta
+  xmlXPathObjectPtr tracks = getTracks(docContext);
+  int numSegments = 0;
+
+  // loop sulle tracce (nodi "trk")
+  xmlNodeSetPtr trackNodes = (tracks != NULL) ? tracks->nodesetval : NULL;
+
+  for (int t = 0; trackNodes != NULL && t < trackNodes->nodeNr; t++) {
+
+    // totali della traccia, ottenuti sommando i risultati dei suoi segmenti
+    metrics total = {0};
+
+    // nome della traccia (si trova nel nodo "name")
+    getTrackName(xmlDoc, trackNodes->nodeTab[t], total.name);
+
+    // nell'ambito di questa traccia devo cercare i segmenti che la compongono; serve quindi creare un altro contesto per valutare 
+    // l'espressione XPath di ricerca
+    xmlXPathContextPtr trackContext = createXPathContext(xmlDoc, trackNodes->nodeTab[t]);
+    xmlXPathObjectPtr trackSegments = getTrackSegments(trackContext);
+    xmlNodeSetPtr segmentNodes = trackSegments->nodesetval;
+    int trackSegmentsNr = (segmentNodes != NULL) ? segmentNodes->nodeNr : 0;
+
+    if (job->debug) { fprintf(getMessageStream(job), "Numero segmenti traccia: %d\n", trackSegmentsNr); }
+
+    for (int n = 0; n < trackSegmentsNr; n++, numSegments++) {
+
+      // contenitore risultati in output
+      metrics results = {0};
+      strcpy(results.name, total.name);
+      
+      if (job->debug) { fprintf(getMessageStream(job), "Segmento %d\n", n); }
+
+      // i punti del segmento sono cercati nel contesto del solo segmento
+      xmlXPathContextPtr segmentContext = createXPathContext(xmlDoc, segmentNodes->nodeTab[n]);
+
+      // recupero dei punti del segmento
+      xmlXPathObjectPtr points = getPoints(segmentContext);
+
+      int numPoints = (points->nodesetval != NULL) ? points->nodesetval->nodeNr : 0;
+
+      // Costruisco un array per contenere i dati di tutti i punti, in modo da non doverli più leggere da XML
+      gpxPoint *allPoints = arenaMalloc(sizeof(gpxPoint) * numPoints);
+
+      // i valori dei sensori (se presenti) vanno in colonne a parte, lette nella stessa passata sui nodi
+      sensorStore sensors;
+      initSensorStore(&sensors, numPoints);
+      
+      long xpathEvals = _XPATH_EVALS_;
+
+      // i punti sono misurati tutti insieme: un timer per punto costerebbe quanto getPointData()
+      STATS_BEGIN(pointsTimer, STAT_POINTS);
+
+      for (int p = 0; p < numPoints; p++) {
+        sensorSample sample;
+        allPoints[p] = getPointData(points->nodesetval->nodeTab[p], &sample);      
+        storeSensorSample(&sensors, p, &sample);
+      }
+
+      STATS_END(pointsTimer, numPoints);
+
+      if (job->debug) { fprintf(getMessageStream(job), "Espressioni XPath valutate per %d punti: %ld\n", numPoints, _XPATH_EVALS_ - xpathEvals); }
+
+      // un'unica passata sui punti calcola le metriche e conserva le distanze progressive per il grafico
+      trackAnalysis analysis;
+      initTrackAnalysis(&analysis, numPoints);
+
+      getResults(job, allPoints, &sensors, numPoints, &results, &analysis);
+      mergeResults(&total, &results);
+      
+      // free
+      freeSensorStore(&sensors);
+      xmlXPathFreeObject(points);
+      xmlXPathFreeContext(segmentContext);
+      
+      // stampa dei risultati finali e dei grafici (altimetrico e quelli richiesti con --chart)
+      printSegment(job, filename, &results, t, n, &analysis, NULL);
+
+      if (job->nearPoint) {
+        printNearestPoint(job, allPoints, numPoints, &analysis);
+      }
+    
+      arenaFree(allPoints);
+      freeTrackAnalysis(&analysis);
+    } // for n
+
+    // con più segmenti si stampa anche il totale della traccia
+    if (trackSegmentsNr > 1) {
+      printTrackTotal(job, filename, &total, t, trackSegmentsNr);
+    }
+
+    xmlXPathFreeObject(trackSegments);
+    xmlXPathFreeContext(trackContext);
+  } // for t
+
+  if (tracks != NULL) xmlXPathFreeObject(tracks);
+  xmlXPathFreeContext(docContext);
+
+  if (numSegments == 0) {
+    fprintf(getMessageStream(job), "Non ho trovato tracce nel file \"%s\"\n", filename);
+    xmlFreeDoc(xmlDoc);
+    return 1;
+  }
+  
+  // free
+  xmlFreeDoc(xmlDoc);
+
+  return 0;
+}
+
+// processing del file XML in streaming (xmlTextReader): i punti sono passati all'accumulatore man mano che vengono letti,
+// senza costruire l'albero del documento; la memoria occupata non dipende dalla dimensione del file
+int processFileStream(const jobConfig *job, const char *filename) {
+
+  xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, 0);
+  if (reader == NULL) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  // lo stato contiene il profilo altimetrico (qualche decina di KB): meglio non tenerlo sullo stack
+  streamState *st = arenaCalloc(1, sizeof(streamState));
+  st->job = job;
+  st->filename = filename;
+
+  int ret;
+  STATS_BEGIN(parseTimer, STAT_PARSE);
+
+  while ((ret = xmlTextReaderRead(reader)) == 1) {
+    processStreamNode(reader, st);
+  }
+
+  STATS_END(parseTimer, 0);
+
+  int numSegments = st->numSegments;
+
+  freeStreamState(st);
+  xmlFreeTextReader(reader);
+
+  if (ret != 0) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  if (numSegments == 0) {
+    fprintf(getMessageStream(job), "Non ho trovato tracce nel file \"%s\"\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+// elabora il nodo corrente del reader: apertura/chiusura di trk, trkseg, trkpt e testo di ele, time, name
+void processStreamNode(xmlTextReaderPtr reader, streamState *st) {
+
+  int type = xmlTextReaderNodeType(reader);
+
+  // testo di un elemento di interesse (può arrivare in più nodi, ad es. in presenza di CDATA)
+  if (type == XML_READER_TYPE_TEXT || type == XML_READER_TYPE_CDATA || type == XML_READER_TYPE_SIGNIFICANT_WHITESPACE) {
+    if (st->field != NULL) {
+      const char *value = (const char*) xmlTextReaderConstValue(reader);
+      int length = strlen(value);
+      if (st->textLength + length >= STREAM_TEXT_SIZE) length = STREAM_TEXT_SIZE - 1 - st->textLength;
+      memcpy(st->text + st->textLength, value, length);
+      st->textLength += length;
+      st->text[st->textLength] = '\0';
+    }
+    return;
+  }
+
+  if (type != XML_READER_TYPE_ELEMENT && type != XML_READER_TYPE_END_ELEMENT) return;
+
+  const xmlChar *name = xmlTextReaderConstLocalName(reader);
+  int empty = (type == XML_READER_TYPE_ELEMENT) && xmlTextReaderIsEmptyElement(reader);
+
+  // sensori del punto: elementi delle estensioni (hr, cad, ...), riconosciuti dal solo nome locale
+  if (st->inPoint) {
+    int channel = getSensorChannel((const char*) name, xmlStrlen(name));
+
+    if (channel >= 0) {
+      if (type == XML_READER_TYPE_ELEMENT && !empty) {
+        st->field = name;
+        st->sensorChannel = channel;
+        st->textLength = 0;
+        st->text[0] = '\0';
+      }
+      else if (type == XML_READER_TYPE_END_ELEMENT && st->sensorChannel == channel) {
+        char *end;
+        double value = strtod(st->text, &end);
+        if (end != st->text) setSensorValue(&(st->sample), channel, value);
+        st->field = NULL;
+        st->sensorChannel = -1;
+      }
+      return;
+    }
+  }
+
+  // si considerano solo gli elementi del namespace GPX (le estensioni Garmin hanno un namespace proprio)
+  const xmlChar *ns = xmlTextReaderConstNamespaceUri(reader);
+  if (ns == NULL || !xmlStrEqual(ns, (xmlChar*) GPX_NAMESPACE_STR)) return;
+
+  if (type == XML_READER_TYPE_ELEMENT) {
+
+    if (xmlStrEqual(name, (xmlChar*)"trk")) {
+      beginStreamTrack(st);
+    }
+    else if (st->inTrack && xmlStrEqual(name, (xmlChar*)"trkseg")) {
+      beginStreamSegment(st);
+    }
+    else if (st->inSegment && xmlStrEqual(name, (xmlChar*)"trkpt")) {
+      st->inPoint = 1;
+      st->sensorChannel = -1;
+      memset(&(st->point), 0, sizeof(gpxPoint));
+      memset(&(st->sample), 0, sizeof(sensorSample));
+      readStreamPointAttributes(reader, &(st->point));
+    }
+    else if ((st->inPoint && (xmlStrEqual(name, (xmlChar*)"ele") || xmlStrEqual(name, (xmlChar*)"time")))
+          || (st->inTrack && !st->inSegment && xmlStrEqual(name, (xmlChar*)"name"))) {
+      st->field = name;
+      st->textLength = 0;
+      st->text[0] = '\0';
+    }
+
+    // un elemento vuoto (<trkseg/>) non genera il nodo di chiusura: lo si chiude subito
+    if (!empty) return;
+  }
+
+  if (st->field != NULL && xmlStrEqual(name, st->field)) {
+    char *end;
+
+    if (xmlStrEqual(name, (xmlChar*)"ele")) {
+      st->point.elevation = strtod(st->text, &end);
+    }
+    else if (xmlStrEqual(name, (xmlChar*)"time")) {
+      parseTimestamp(st->text, &(st->point.time));
+    }
+    else {
+      size_t length = strnlen(st->text, sizeof(st->trackName) - 1);
+      memcpy(st->trackName, st->text, length);
+      st->trackName[length] = '\0';
+    }
+
+    st->field = NULL;
+  }
+  else if (st->inPoint && xmlStrEqual(name, (xmlChar*)"trkpt")) {
+    st->inPoint = 0;
+    addStreamPoint(st);
+  }
+  else if (st->inSegment && xmlStrEqual(name, (xmlChar*)"trkseg")) {
+    endStreamSegment(st);
+  }
+  else if (st->inTrack && xmlStrEqual(name, (xmlChar*)"trk")) {
+    endStreamTrack(st);
+  }
+}
+
+// latitudine/longitudine dagli attributi del trkpt corrente, senza allocare copie delle stringhe
+void readStreamPointAttributes(xmlTextReaderPtr reader, gpxPoint *p) {
+  char *end;
+
+  if (xmlTextReaderMoveToAttribute(reader, (xmlChar*)"lat") == 1) {
+    p->lat = strtod((const char*) xmlTextReaderConstValue(reader), &end);
+  }
+
+  if (xmlTextReaderMoveToAttribute(reader, (xmlChar*)"lon") == 1) {
+    p->lon = strtod((const char*) xmlTextReaderConstValue(reader), &end);
+  }
+
+  xmlTextReaderMoveToElement(reader);
+}
+
+// apertura di una traccia letta in streaming
+void beginStreamTrack(streamState *st) {
+  st->inTrack = 1;
+  st->numTracks++;
+  st->trackSegments = 0;
+  memset(&(st->total), 0, sizeof(metrics));
+  strcpy(st->trackName, "Senza nome");
+}
+
+// apertura di un segmento letto in streaming: i suoi punti andranno in un nuovo accumulatore
+void beginStreamSegment(streamState *st) {
+  st->inSegment = 1;
+  st->numSegments++;
+  st->trackSegments++;
+  memset(&(st->results), 0, sizeof(metrics));
+  strcpy(st->results.name, st->trackName);
+  initProfile(&(st->profile));
+
+  // l'analisi a finestre ha bisogno delle distanze e dei tempi di tutti i punti del segmento
+  if (st->job->numEfforts > 0 && st->cache == NULL) initTrackAnalysis(&(st->analysis), 1024);
+
+  initAccumulator(&(st->acc), st->job, &(st->results), &(st->profile), (st->analysis.capacity > 0) ? &(st->analysis) : NULL);
+
+  if (st->cache != NULL) addCacheSegment(st->cache, st->numTracks - 1, &(st->results));
+
+  if (st->job->debug) { fprintf(getMessageStream(st->job), "Segmento %d\n", st->trackSegments - 1); }
+}
+
+// chiusura di un segmento letto in streaming: calcolo finale delle metriche e stampa
+void endStreamSegment(streamState *st) {
+
+  st->inSegment = 0;
+
+  finalizeAccumulator(&(st->acc));
+  mergeResults(&(st->total), &(st->results));
+
+  // in lettura per la cache i risultati sono conservati insieme ai punti, e stampati in seguito
+  if (st->cache != NULL) {
+    st->cache->segments[st->cache->numSegments - 1].results = st->results;
+    return;
+  }
+
+  // stampa dei risultati finali e del grafico altimetrico: in streaming i punti non sono conservati, quindi gli altri
+  // grafici non sono disponibili (a meno che con --efforts non si siano conservate distanze e tempi)
+  if (st->analysis.capacity > 0) {
+    printSegment(st->job, st->filename, &(st->results), st->numTracks - 1, st->trackSegments - 1, &(st->analysis), NULL);
+    freeTrackAnalysis(&(st->analysis));
+    memset(&(st->analysis), 0, sizeof(trackAnalysis));
+  }
+  else {
+    printSegment(st->job, st->filename, &(st->results), st->numTracks - 1, st->trackSegments - 1, NULL, &(st->profile));
+  }
+}
+
+// punto letto in streaming: passa all'accumulatore (e alla cache, se i punti vanno raccolti)
+void addStreamPoint(streamState *st) {
+  accumulatePoint(&(st->acc), &(st->point), &(st->sample));
+  st->numPoints++;
+  if (st->cache != NULL) addCachePoint(st->cache, &(st->point));
+}
+
+// libera lo stato del parser in streaming (e i punti del segmento rimasto aperto per un errore di lettura)
+void freeStreamState(streamState *st) {
+  if (st->analysis.capacity > 0) freeTrackAnalysis(&(st->analysis));
+  arenaFree(st);
+}
+
+// chiusura di una traccia letta in streaming: con più segmenti si stampa anche il totale della traccia
+void endStreamTrack(streamState *st) {
+
+  st->inTrack = 0;
+
+  if (st->cache == NULL && st->trackSegments > 1) {
+    strcpy(st->total.name, st->trackName);
+    printTrackTotal(st->job, st->filename, &(st->total), st->numTracks - 1, st->trackSegments);
+  }
+}
+
+// processing del file GPX mappato in memoria (mmap), con un tokenizer minimo al posto di libxml2: i tag e i numeri
+// sono letti direttamente dai byte del file, senza copiarli in stringhe intermedie
+int processFileMmap(const jobConfig *job, const char *filename) {
+
+  int fd = open(filename, O_RDONLY);
+  struct stat info;
+
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+    if (fd >= 0) close(fd);
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  size_t size = info.st_size;
+  const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  // il file è letto una sola volta dall'inizio alla fine
+  madvise((void*) data, size, MADV_SEQUENTIAL);
+
+  int ret = processGpxBuffer(job, filename, data, size);
+
+  munmap((void*) data, size);
+  return ret;
+}
+
+// elabora un documento GPX già in memoria con il tokenizer della modalità mmap (un file mappato, o il contenuto di una
+// richiesta di --serve); "filename" è il nome usato nell'output e nei messaggi
+int processGpxBuffer(const jobConfig *job, const char *filename, const char *data, size_t size) {
+
+  // lo stato è lo stesso della lettura in streaming: cambia solo chi produce i tag
+  streamState *st = arenaCalloc(1, sizeof(streamState));
+  st->job = job;
+  st->filename = filename;
+
+  STATS_BEGIN(parseTimer, STAT_PARSE);
+  int ret = parseGpxBuffer(st, data, data + size);
+  STATS_END(parseTimer, 0);
+
+  int numSegments = st->numSegments;
+
+  freeStreamState(st);
+
+  if (ret != 0) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  if (numSegments == 0) {
+    fprintf(getMessageStream(job), "Non ho trovato tracce nel file \"%s\"\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+// modalità --follow, per i file che un dispositivo scrive durante l'attività: il file viene controllato ogni _FOLLOW_
+// secondi e si leggono solo i byte aggiunti, che aggiornano gli accumulatori del segmento in corso; dopo ogni
+// aggiornamento si stampano le metriche e il profilo altimetrico del segmento. Il costo di un aggiornamento dipende
+// solo dai punti nuovi. Termina con Ctrl+C (o dopo _FOLLOW_IDLE_ secondi senza nuovi dati), chiudendo i segmenti aperti
+int processFileFollow(const jobConfig *job, const char *filename) {
+
+  followState f;
+
+  if (!initFollow(&f, job, filename)) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  // SIGINT e SIGTERM interrompono l'attesa (senza SA_RESTART) e fanno terminare il ciclo
+  struct sigaction action, prevInt, prevTerm;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stopFollow;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, &prevInt);
+  sigaction(SIGTERM, &action, &prevTerm);
+  _FOLLOW_STOP_ = 0;
+
+  if (job->format == FORMAT_TEXT) fprintf(job->out, "[ Controllo del file <%s> ogni %g s, Ctrl+C per terminare ]\n\n", filename, _FOLLOW_);
+
+  struct timespec interval = { (time_t) _FOLLOW_, (long) ((_FOLLOW_ - (time_t) _FOLLOW_) * 1e9) };
+  struct timespec lastChange;
+  clock_gettime(CLOCK_MONOTONIC, &lastChange);
+
+  int ret = 0;
+
+  while (!_FOLLOW_STOP_) {
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    off_t size = f.size;
+    int newPoints = updateFollow(&f);
+
+    if (newPoints < 0) {
+      ret = 1;
+      break;
+    }
+
+    if (newPoints > 0) printFollowUpdate(&f, newPoints, getElapsedSeconds(&start));
+
+    if (f.size != size) lastChange = start;
+    else if (_FOLLOW_IDLE_ > 0 && getElapsedSeconds(&lastChange) >= _FOLLOW_IDLE_) break;
+
+    nanosleep(&interval, NULL);
+  }
+
+  sigaction(SIGINT, &prevInt, NULL);
+  sigaction(SIGTERM, &prevTerm, NULL);
+
+  int numSegments = (ret == 0) ? finishFollow(&f) : -1;
+  freeFollow(&f);
+
+  if (numSegments < 0) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  if (numSegments == 0) {
+    fprintf(getMessageStream(job), "Non ho trovato tracce nel file \"%s\"\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+// apre il file da seguire e prepara lo stato del parser; restituisce 0 se il file non si può aprire
+int initFollow(followState *f, const jobConfig *job, const char *filename) {
+
+  memset(f, 0, sizeof(followState));
+
+  f->fd = open(filename, O_RDONLY);
+  if (f->fd < 0) return 0;
+
+  f->st = arenaCalloc(1, sizeof(streamState));
+  f->st->job = job;
+  f->st->filename = filename;
+  return 1;
+}
+
+// legge i byte aggiunti al file dall'ultimo controllo e li passa al parser fino alla fine dell'ultimo punto completo:
+// il resto (un punto scritto a metà, o i tag di chiusura che alcuni dispositivi riscrivono dopo ogni punto) viene
+// riletto al controllo successivo. Se il file si accorcia è stato riscritto: lo si rilegge dall'inizio.
+// Restituisce il numero di punti nuovi, -1 in caso di errore
+int updateFollow(followState *f) {
+
+  streamState *st = f->st;
+  struct stat info;
+
+  if (fstat(f->fd, &info) != 0) return -1;
+
+  if (info.st_size < f->consumed) {
+    fprintf(getMessageStream(st->job), "Il file \"%s\" è stato troncato: lo rileggo dall'inizio\n", st->filename);
+
+    // lo stato riparte da zero: prima si liberano i punti conservati del segmento aperto (con --efforts)
+    const jobConfig *job = st->job;
+    const char *filename = st->filename;
+    if (st->analysis.capacity > 0) freeTrackAnalysis(&(st->analysis));
+    memset(st, 0, sizeof(streamState));
+    st->job = job;
+    st->filename = filename;
+
+    f->consumed = 0;
+    f->size = 0;
+  }
+
+  if (info.st_size == f->size) return 0;
+
+  long numPoints = st->numPoints;
+  size_t chunkSize = FOLLOW_CHUNK_SIZE;
+
+  // a blocchi, perché la prima lettura comprende tutto il file; un blocco senza punti completi viene raddoppiato
+  while (f->consumed < info.st_size) {
+
+    size_t length = info.st_size - f->consumed;
+    if (length > chunkSize) length = chunkSize;
+
+    ssize_t read = readFollow(f, length);
+    if (read < 0) return -1;
+
+    const char *end = findLastPointEnd(f->buffer, f->buffer + read);
+
+    if (end == NULL) {
+      if ((size_t) read < chunkSize || f->consumed + read >= info.st_size) break;
+      chunkSize *= 2;
+      continue;
+    }
+
+    STATS_BEGIN(parseTimer, STAT_PARSE);
+    int ret = parseGpxBuffer(st, f->buffer, end);
+    STATS_END(parseTimer, 0);
+
+    if (ret != 0) return -1;
+
+    f->consumed += end - f->buffer;
+
+    // il file si è accorciato durante la lettura: il resto al prossimo controllo
+    if ((size_t) read < length) break;
+  }
+
+  f->size = info.st_size;
+  return st->numPoints - numPoints;
+}
+
+// legge nel buffer (al più) length byte del file a partire da "consumed"; restituisce quanti ne ha letti, -1 in caso di errore
+ssize_t readFollow(followState *f, size_t length) {
+
+  if (length > f->bufferSize) {
+    char *buffer = realloc(f->buffer, length);
+    if (buffer == NULL) return -1;
+    f->buffer = buffer;
+    f->bufferSize = length;
+  }
+
+  size_t done = 0;
+
+  while (done < length) {
+    ssize_t n = pread(f->fd, f->buffer + done, length - done, f->consumed + done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -1;
+    if (n == 0) break;
+    done += n;
+  }
+
+  return done;
+}
+
+// fine di --follow: i byte rimasti (di solito i tag di chiusura) vanno al parser, e il segmento e la traccia ancora aperti
+// vengono chiusi come se il file fosse terminato. Restituisce il numero di segmenti letti, -1 in caso di errore
+int finishFollow(followState *f) {
+
+  streamState *st = f->st;
+
+  if (updateFollow(f) < 0) return -1;
+
+  struct stat info;
+
+  if (fstat(f->fd, &info) == 0 && info.st_size > f->consumed) {
+    ssize_t read = readFollow(f, info.st_size - f->consumed);
+
+    // un tag scritto a metà alla fine del file non è un errore: la registrazione può essere stata interrotta
+    if (read > 0) parseGpxBuffer(st, f->buffer, f->buffer + read);
+  }
+
+  // un punto incompleto viene scartato
+  st->inPoint = 0;
+
+  if (st->inSegment) endStreamSegment(st);
+  if (st->inTrack) endStreamTrack(st);
+
+  return st->numSegments;
+}
+
+// chiude il file e libera lo stato di --follow
+void freeFollow(followState *f) {
+  close(f->fd);
+  free(f->buffer);
+  freeStreamState(f->st);
+  memset(f, 0, sizeof(followState));
+}
+
+// stampa di un aggiornamento: con l'output di testo un'intestazione con i punti letti e il tempo di lettura, poi le metriche
+// e il profilo del segmento in corso (i segmenti chiusi durante l'aggiornamento sono già stati stampati da endStreamSegment())
+void printFollowUpdate(followState *f, int newPoints, double elapsed) {
+
+  streamState *st = f->st;
+  const jobConfig *job = st->job;
+
+  if (job->format == FORMAT_TEXT) {
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    fprintf(job->out, "[ Aggiornamento delle %02d:%02d:%02d: %d punti nuovi (%ld in tutto), letti in %.3lf ms ]\n\n", local.tm_hour, local.tm_min, local.tm_sec, newPoints, st->numPoints, elapsed * 1000.0);
+  }
+
+  if (st->inSegment && st->acc.numPoints + st->acc.blockSize > 0) {
+    metrics live;
+    getLiveResults(&(st->acc), &live);
+    printSegment(job, st->filename, &live, st->numTracks - 1, st->trackSegments - 1, NULL, &(st->profile));
+  }
+
+  fflush(job->out);
+}
+
+// gestore di SIGINT e SIGTERM durante --follow
+void stopFollow(int signum) {
+  (void) signum;
+  _FOLLOW_STOP_ = 1;
+}
+
+// legge i tag del documento tra data ed end e aggiorna lo stato come la lettura in streaming. Si considerano solo
+// trk, trkseg, trkpt, ele, time, name; il contenuto di extensions viene saltato. Restituisce 0, o -1 se un tag non è chiuso
+int parseGpxBuffer(streamState *st, const char *data, const char *end) {
+
+  const char *cursor = data;
+  gpxTag tag;
+  int found;
+
+  while ((found = nextGpxTag(&cursor, end, &tag)) == 1) {
+
+    if (tag.type == GPX_TAG_CLOSE) {
+      if (st->inPoint && isGpxTag(&tag, "trkpt")) {
+        st->inPoint = 0;
+        addStreamPoint(st);
+      }
+      else if (st->inSegment && isGpxTag(&tag, "trkseg")) {
+        endStreamSegment(st);
+      }
+      else if (st->inTrack && isGpxTag(&tag, "trk")) {
+        endStreamTrack(st);
+      }
+      continue;
+    }
+
+    if (isGpxTag(&tag, "extensions")) {
+      // le estensioni di un punto contengono i sensori; le altre vengono saltate
+      if (tag.type == GPX_TAG_OPEN && st->inPoint && parseGpxSensors(&cursor, end, &(st->sample)) != 1) return -1;
+      if (tag.type == GPX_TAG_OPEN && !st->inPoint && skipGpxElement(&cursor, end) != 1) return -1;
+    }
+    else if (isGpxTag(&tag, "trk")) {
+      beginStreamTrack(st);
+      if (tag.type == GPX_TAG_EMPTY) endStreamTrack(st);
+    }
+    else if (st->inTrack && isGpxTag(&tag, "trkseg")) {
+      beginStreamSegment(st);
+      if (tag.type == GPX_TAG_EMPTY) endStreamSegment(st);
+    }
+    else if (st->inSegment && isGpxTag(&tag, "trkpt")) {
+      memset(&(st->point), 0, sizeof(gpxPoint));
+      memset(&(st->sample), 0, sizeof(sensorSample));
+
+      const char *value;
+      if ((value = getGpxAttribute(&tag, "lat")) != NULL) st->point.lat = parseGpxNumber(value, tag.attributesEnd);
+      if ((value = getGpxAttribute(&tag, "lon")) != NULL) st->point.lon = parseGpxNumber(value, tag.attributesEnd);
+
+      st->inPoint = 1;
+      if (tag.type == GPX_TAG_EMPTY) {
+        st->inPoint = 0;
+        addStreamPoint(st);
+      }
+    }
+    else if (tag.type == GPX_TAG_OPEN && ((st->inPoint && (isGpxTag(&tag, "ele") || isGpxTag(&tag, "time"))) ||
+                                          (st->inTrack && !st->inSegment && isGpxTag(&tag, "name")))) {
+
+      // il testo dell'elemento arriva fino al tag successivo (comprese eventuali sezioni CDATA)
+      char buffer[TRACK_NAME_SIZE];
+      const char *text, *textEnd;
+      int inBuffer = getGpxText(cursor, end, buffer, sizeof(buffer), &text, &textEnd);
+      if (inBuffer < 0) return -1;
+
+      if (isGpxTag(&tag, "ele")) {
+        st->point.elevation = parseGpxNumber(text, textEnd);
+      }
+      else if (isGpxTag(&tag, "time")) {
+        // parseTimestamp() si ferma al primo carattere non previsto: il '<' del tag di chiusura (o il terminatore)
+        parseTimestamp(text, &(st->point.time));
+      }
+      else if (inBuffer) {
+        memcpy(st->trackName, buffer, textEnd - text + 1);
+      }
+      else {
+        copyGpxText(st->trackName, TRACK_NAME_SIZE, text, textEnd);
+      }
+    }
+  }
+
+  return found;
+}
+
+// fine dell'ultimo tag di chiusura di un punto (</trkpt>, o <trkpt .../>) tra data ed end, NULL se non ce ne sono.
+// I tag sono cercati a ritroso dalla fine, quindi il costo dipende solo dai byte successivi all'ultimo punto
+const char *findLastPointEnd(const char *data, const char *end) {
+
+  const char *p = end;
+
+  while ((p = memrchr(data, '>', p - data)) != NULL) {
+
+    const char *lt = memrchr(data, '<', p - data);
+    if (lt == NULL) return NULL;
+
+    const char *cursor = lt;
+    gpxTag tag;
+
+    if (nextGpxTag(&cursor, p + 1, &tag) == 1 && cursor == p + 1 && tag.type != GPX_TAG_OPEN && isGpxTag(&tag, "trkpt")) return p + 1;
+
+    p = lt;
+  }
+
+  return NULL;
+}
+
+// prossimo tag del documento a partire da *cursor, saltando testo, commenti, istruzioni di elaborazione, DOCTYPE e CDATA.
+// Restituisce 1 se ha trovato un tag (e sposta il cursore dopo il tag), 0 alla fine del documento, -1 se il tag non è chiuso
+int nextGpxTag(const char **cursor, const char *end, gpxTag *tag) {
+
+  const char *p = *cursor;
+
+  for (;;) {
+    p = memchr(p, '<', end - p);
+    if (p == NULL) return 0;
+    if (end - p < 2) return -1;
+
+    if (p[1] != '?' && p[1] != '!') break;
+
+    // <?...?>, <!--...-->, <![CDATA[...]]>, <!DOCTYPE ...>
+    const char *close = "?>";
+    if (p[1] == '!') {
+      close = (end - p >= 4 && strncmp(p, "<!--", 4) == 0) ? "-->" : (end - p >= 9 && strncmp(p, "<![CDATA[", 9) == 0) ? "]]>" : ">";
+    }
+
+    p = memmem(p + 2, end - p - 2, close, strlen(close));
+    if (p == NULL) return -1;
+    p += strlen(close);
+  }
+
+  // fine del tag: il primo '>' fuori dai valori degli attributi
+  const char *gt = p + 1;
+
+  for (;;) {
+    while (gt < end && *gt != '>' && *gt != '"' && *gt != '\'') gt++;
+    if (gt == end) return -1;
+    if (*gt == '>') break;
+
+    gt = memchr(gt + 1, *gt, end - gt - 1);
+    if (gt == NULL) return -1;
+    gt++;
+  }
+
+  tag->type = (p[1] == '/') ? GPX_TAG_CLOSE : (gt[-1] == '/') ? GPX_TAG_EMPTY : GPX_TAG_OPEN;
+
+  // nome locale: si scarta l'eventuale prefisso del namespace
+  const char *name = p + 1 + (tag->type == GPX_TAG_CLOSE);
+  const char *nameEnd = name;
+
+  while (nameEnd < gt && *nameEnd != '/' && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r' && *nameEnd != '\n') {
+    if (*nameEnd == ':') name = nameEnd + 1;
+    nameEnd++;
+  }
+
+  tag->name = name;
+  tag->nameLength = nameEnd - name;
+  tag->attributes = nameEnd;
+  tag->attributesEnd = gt;
+
+  *cursor = gt + 1;
+  return 1;
+}
+
+// il tag ha il nome (locale) indicato?
+int isGpxTag(const gpxTag *tag, const char *name) {
+  return (strncmp(tag->name, name, tag->nameLength) == 0 && name[tag->nameLength] == '\0');
+}
+
+// salta il contenuto dell'elemento appena aperto, fino al suo tag di chiusura compreso
+int skipGpxElement(const char **cursor, const char *end) {
+
+  gpxTag tag;
+  int depth = 1;
+  int found;
+
+  while (depth > 0 && (found = nextGpxTag(cursor, end, &tag)) == 1) {
+    if (tag.type == GPX_TAG_OPEN) depth++;
+    else if (tag.type == GPX_TAG_CLOSE) depth--;
+  }
+
+  return (depth == 0) ? 1 : -1;
+}
+
+// legge i sensori dalle estensioni di un punto (appena aperte), fino al tag di chiusura compreso:
+// a ogni livello di annidamento un elemento con il nome di un canale ha come testo il valore del sensore
+int parseGpxSensors(const char **cursor, const char *end, sensorSample *sample) {
+
+  gpxTag tag;
+  int depth = 1;
+  int found;
+
+  while (depth > 0 && (found = nextGpxTag(cursor, end, &tag)) == 1) {
+    if (tag.type == GPX_TAG_CLOSE) {
+      depth--;
+      continue;
+    }
+    if (tag.type == GPX_TAG_EMPTY) continue;
+
+    depth++;
+
+    int channel = getSensorChannel(tag.name, tag.nameLength);
+    if (channel >= 0) {
+      char buffer[TRACK_NAME_SIZE];
+      const char *text, *textEnd;
+      if (getGpxText(*cursor, end, buffer, sizeof(buffer), &text, &textEnd) < 0) return -1;
+      if (textEnd > text) setSensorValue(sample, channel, parseGpxNumber(text, textEnd));
+    }
+  }
+
+  return (depth == 0) ? 1 : -1;
+}
+
+// valore di un attributo del tag (puntatore al primo carattere dopo le virgolette), NULL se l'attributo non c'è
+const char *getGpxAttribute(const gpxTag *tag, const char *name) {
+
+  size_t length = strlen(name);
+  const char *p = tag->attributes;
+
+  while (p < tag->attributesEnd) {
+    const char *equals = memchr(p, '=', tag->attributesEnd - p);
+    if (equals == NULL) return NULL;
+
+    // nome dell'attributo: dal primo carattere non bianco fino a '=' (esclusi eventuali spazi)
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    const char *nameEnd = equals;
+    while (nameEnd > p && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) nameEnd--;
+
+    const char *quote = equals + 1;
+    while (quote < tag->attributesEnd && *quote != '"' && *quote != '\'') quote++;
+    if (quote >= tag->attributesEnd) return NULL;
+
+    const char *value = quote + 1;
+    const char *valueEnd = memchr(value, *quote, tag->attributesEnd - value);
+    if (valueEnd == NULL) return NULL;
+
+    if ((size_t)(nameEnd - p) == length && strncmp(p, name, length) == 0) return value;
+
+    p = valueEnd + 1;
+  }
+
+  return NULL;
+}
+
+// copia un testo del file in "dest" (al più size - 1 byte), sostituendo le entità predefinite di XML e i riferimenti
+// numerici (&#N; e &#xH;, scritti in UTF-8 come fa libxml2; un carattere che non ci sta è troncato come dalle altre letture)
+void copyGpxText(char *dest, int size, const char *text, const char *textEnd) {
+
+  static const char *entities[] = { "&lt;", "&gt;", "&amp;", "&quot;", "&apos;" };
+  static const char characters[] = "<>&\"'";
+  int length = 0;
+
+  while (text < textEnd && length < size - 1) {
+    int e = 0;
+    if (*text == '&') {
+      while (e < 5 && !(textEnd - text >= (long) strlen(entities[e]) && strncmp(text, entities[e], strlen(entities[e])) == 0)) e++;
+    }
+
+    char utf8[4];
+    int utf8Length = 0;
+
+    if (*text == '&' && e < 5) {
+      dest[length++] = characters[e];
+      text += strlen(entities[e]);
+    } else if (*text == '&' && (utf8Length = decodeCharReference(&text, textEnd, utf8)) > 0) {
+      for (int i = 0; i < utf8Length && length < size - 1; i++) dest[length++] = utf8[i];
+    } else {
+      dest[length++] = *text++;
+    }
+  }
+
+  dest[length] = '\0';
+}
+
+// riferimento numerico a un carattere (&#N; o &#xH;) all'inizio di *text: lo scrive in UTF-8 in "utf8" e ne restituisce
+// i byte (da 1 a 4), spostando *text dopo il ';'. Restituisce 0 (e non sposta *text) se non è un riferimento valido
+int decodeCharReference(const char **text, const char *textEnd, char *utf8) {
+
+  const char *p = *text;
+  if (textEnd - p < 4 || p[0] != '&' || p[1] != '#') return 0;
+  p += 2;
+
+  int hex = (*p == 'x');
+  if (hex) p++;
+
+  uint32_t code = 0;
+  const char *digits = p;
+
+  for (; p < textEnd && *p != ';'; p++) {
+    int digit = (*p >= '0' && *p <= '9') ? *p - '0' :
+                (hex && *p >= 'a' && *p <= 'f') ? *p - 'a' + 10 :
+                (hex && *p >= 'A' && *p <= 'F') ? *p - 'A' + 10 : -1;
+
+    if (digit < 0) return 0;
+    code = code * (hex ? 16 : 10) + digit;
+    if (code > 0x10FFFF) return 0;
+  }
+
+  // caratteri non ammessi da XML: il NUL e le metà delle coppie UTF-16
+  if (p == textEnd || p == digits || code == 0 || (code >= 0xD800 && code <= 0xDFFF)) return 0;
+
+  *text = p + 1;
+
+  if (code < 0x80) {
+    utf8[0] = code;
+    return 1;
+  }
+
+  if (code < 0x800) {
+    utf8[0] = 0xC0 | (code >> 6);
+    utf8[1] = 0x80 | (code & 0x3F);
+    return 2;
+  }
+
+  if (code < 0x10000) {
+    utf8[0] = 0xE0 | (code >> 12);
+    utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+    utf8[2] = 0x80 | (code & 0x3F);
+    return 3;
+  }
+
+  utf8[0] = 0xF0 | (code >> 18);
+  utf8[1] = 0x80 | ((code >> 12) & 0x3F);
+  utf8[2] = 0x80 | ((code >> 6) & 0x3F);
+  utf8[3] = 0x80 | (code & 0x3F);
+  return 4;
+}
+
+// testo dell'elemento appena aperto, da cursor al tag successivo. Il testo semplice resta nel file (restituisce 0, e le
+// entità vanno sostituite con copyGpxText()); se contiene sezioni CDATA, commenti o istruzioni di elaborazione viene
+// ricomposto in "buffer" (al più size - 1 caratteri, terminato da '\0'), con il contenuto delle CDATA così com'è e le
+// entità del resto già sostituite, e restituisce 1. In *text e *textEnd l'inizio e la fine del testo; -1 se non è chiuso
+int getGpxText(const char *cursor, const char *end, char *buffer, int size, const char **text, const char **textEnd) {
+
+  const char *p = memchr(cursor, '<', end - cursor);
+  if (p == NULL || end - p < 2) return -1;
+
+  if (p[1] != '!' && p[1] != '?') {
+    *text = cursor;
+    *textEnd = p;
+    return 0;
+  }
+
+  int length = 0;
+  p = cursor;
+
+  for (;;) {
+    const char *lt = memchr(p, '<', end - p);
+    if (lt == NULL || end - lt < 2) return -1;
+
+    copyGpxText(buffer + length, size - length, p, lt);
+    length += strlen(buffer + length);
+
+    if (lt[1] != '!' && lt[1] != '?') break;
+
+    // <![CDATA[...]]> è testo; <!--...--> e <?...?> si saltano
+    int cdata = (end - lt >= 9 && strncmp(lt, "<![CDATA[", 9) == 0);
+    const char *close = cdata ? "]]>" : (lt[1] == '?') ? "?>" : "-->";
+    const char *from = lt + (cdata ? 9 : 2);
+
+    const char *closeStart = memmem(from, end - from, close, strlen(close));
+    if (closeStart == NULL) return -1;
+
+    if (cdata) {
+      int copied = closeStart - from;
+      if (copied > size - 1 - length) copied = size - 1 - length;
+      memcpy(buffer + length, from, copied);
+      length += copied;
+      buffer[length] = '\0';
+    }
+
+    p = closeStart + strlen(close);
+  }
+
+  *text = buffer;
+  *textEnd = buffer + length;
+  return 1;
+}
+
+// numero decimale letto direttamente dal file, senza copiarlo: con al più 15 cifre significative e 22 decimali
+// (i valori dei GPX) mantissa e potenza di 10 sono rappresentate esattamente, e una sola divisione dà lo stesso
+// risultato di strtod(). Negli altri casi (esponente, troppe cifre) si usa strtod() su una copia del numero
+double parseGpxNumber(const char *p, const char *end) {
+
+  static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  const char *start = p;
+
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+
+  int negative = (p < end && *p == '-');
+  if (p < end && (*p == '-' || *p == '+')) p++;
+
+  uint64_t mantissa = 0;
+  int digits = 0, decimals = 0, point = 0;
+
+  for (; p < end; p++) {
+    if (*p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa > 0) digits++;
+      if (point) decimals++;
+    }
+    else if (*p == '.' && !point) {
+      point = 1;
+    }
+    else {
+      break;
+    }
+
+    if (digits > 15 || decimals > 22) break;
+  }
+
+  if (digits <= 15 && decimals <= 22 && (p == end || (*p != 'e' && *p != 'E' && *p != '.' && (*p < '0' || *p > '9')))) {
+    double value = (double) mantissa / powersOf10[decimals];
+    return negative ? -value : value;
+  }
+
+  char buffer[64];
+  size_t length = end - start;
+  if (length > sizeof(buffer) - 1) length = sizeof(buffer) - 1;
+  memcpy(buffer, start, length);
+  buffer[length] = '\0';
+
+  return strtod(buffer, NULL);
+}
+
+// processing del file XML a blocchi, su più thread: una scansione dei byte del file individua tracce e segmenti,
+// poi i punti di ogni segmento sono divisi in blocchi (sempre all'inizio di un <trkpt) letti in parallelo.
+// Le metriche parziali dei blocchi sono unite aggiungendo la coppia di punti a cavallo di ogni confine
+int processFileParallel(const jobConfig *job, const char *filename) {
+
+  size_t size;
+  char *data = readFileContents(filename, &size);
+  if (data == NULL) {
+    fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+    return 1;
+  }
+
+  const char *end = data + size;
+
+  // il prologo fino al tag di apertura della radice compreso viene ripetuto davanti a ogni blocco
+  const char *root = findElement(data, end, "gpx");
+  const char *rootEnd = (root != NULL) ? memchr(root, '>', end - root) : NULL;
+
+  // senza una radice riconoscibile (o con elementi con prefisso, ad es. <gpx:trk>) si usa la lettura in streaming,
+  // che segnala anche gli errori e l'assenza di tracce
+  if (rootEnd == NULL || rootEnd[-1] == '/' || findElement(rootEnd, end, "trk") == NULL) {
+    free(data);
+    return processFileStream(job, filename);
+  }
+
+  size_t headerSize = rootEnd + 1 - data;
+  int numThreads = (job->parseThreads > 0) ? job->parseThreads : getNumCores();
+  int numTracks = 0;
+  int numSegments = 0;
+  int ret = 0;
+
+  // loop sulle tracce (elementi "trk")
+  const char *track = rootEnd;
+
+  while (ret == 0 && (track = findElement(track, end, "trk")) != NULL) {
+
+    const char *trackEnd = findElement(track, end, "/trk");
+    if (trackEnd == NULL) trackEnd = end;
+
+    // totali della traccia, ottenuti sommando i risultati dei suoi segmenti
+    metrics total = {0};
+
+    // il nome della traccia precede il primo segmento
+    const char *segment = findElement(track, trackEnd, "trkseg");
+    getChunkTrackName(track, (segment != NULL) ? segment : trackEnd, total.name);
+
+    int trackSegmentsNr = 0;
+
+    for (; segment != NULL; segment = findElement(segment, trackEnd, "trkseg"), trackSegmentsNr++, numSegments++) {
+
+      // contenuto del segmento: dalla fine del tag di apertura al tag di chiusura (vuoto per <trkseg/>)
+      const char *segmentStart = memchr(segment, '>', trackEnd - segment);
+      if (segmentStart == NULL) break;
+      segmentStart++;
+
+      const char *segmentEnd = (segmentStart[-2] == '/') ? segmentStart : findElement(segmentStart, trackEnd, "/trkseg");
+      if (segmentEnd == NULL) segmentEnd = trackEnd;
+
+      if (job->debug) { fprintf(getMessageStream(job), "Segmento %d\n", trackSegmentsNr); }
+
+      // contenitore risultati in output
+      metrics results = {0};
+      strcpy(results.name, total.name);
+
+      trackAnalysis analysis;
+      if (!analyzeSegmentChunks(job, data, headerSize, segmentStart, segmentEnd, numThreads, &results, &analysis)) {
+        fprintf(getMessageStream(job), "Errore nella lettura del file \"%s\"\n", filename);
+        ret = 1;
+        break;
+      }
+
+      mergeResults(&total, &results);
+
+      // stampa dei risultati finali e dei grafici (altimetrico e quelli richiesti con --chart)
+      printSegment(job, filename, &results, numTracks, trackSegmentsNr, &analysis, NULL);
+
+      freeTrackAnalysis(&analysis);
+      segment = segmentEnd;
+    } // for segment
+
+    // con più segmenti si stampa anche il totale della traccia
+    if (ret == 0 && trackSegmentsNr > 1) {
+      printTrackTotal(job, filename, &total, numTracks, trackSegmentsNr);
+    }
+
+    numTracks++;
+    track = trackEnd;
+  } // while track
+
+  free(data);
+
+  if (ret == 0 && numSegments == 0) {
+    fprintf(getMessageStream(job), "Non ho trovato tracce nel file \"%s\"\n", filename);
+    return 1;
+  }
+
+  return ret;
+}
+
+// legge tutto il file in memoria; restituisce NULL in caso di errore
+char *readFileContents(const char *filename, size_t *size) {
+
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) return NULL;
+
+  struct stat info;
+  if (fstat(fileno(fp), &info) != 0) {
+    fclose(fp);
+    return NULL;
+  }
+
+  *size = info.st_size;
+  char *data = malloc(*size + 1);
+
+  if (data == NULL || fread(data, 1, *size, fp) != *size) {
+    free(data);
+    fclose(fp);
+    return NULL;
+  }
+
+  data[*size] = '\0';
+  fclose(fp);
+  return data;
+}
+
+// primo tag di apertura dell'elemento "name" (senza prefisso) tra from e to, o di chiusura se "name" inizia con '/';
+// NULL se non c'è. Commenti, sezioni CDATA e istruzioni di elaborazione sono saltati come in nextGpxTag()
+const char *findElement(const char *from, const char *to, const char *name) {
+
+  size_t length = strlen(name);
+
+  while (from < to && (from = memchr(from, '<', to - from)) != NULL) {
+
+    if (to - from >= 2 && (from[1] == '!' || from[1] == '?')) {
+      const char *close = (from[1] == '?') ? "?>" : (to - from >= 4 && strncmp(from, "<!--", 4) == 0) ? "-->" :
+                          (to - from >= 9 && strncmp(from, "<![CDATA[", 9) == 0) ? "]]>" : ">";
+
+      from = memmem(from + 2, to - from - 2, close, strlen(close));
+      if (from == NULL) return NULL;
+      from += strlen(close);
+      continue;
+    }
+
+    const char *next = from + 1 + length;
+
+    // il nome deve essere seguito da uno spazio, da '>' o da '/' (altrimenti <trk troverebbe anche <trkseg)
+    if (next < to && strncmp(from + 1, name, length) == 0 && (*next == '>' || *next == '/' || *next == ' ' || *next == '\t' || *next == '\r' || *next == '\n')) {
+      return from;
+    }
+    from++;
+  }
+
+  return NULL;
+}
+
+// nome della traccia, cercato tra from e to (la parte della traccia che precede il primo segmento); entità e sezioni
+// CDATA sono lette come nelle altre modalità
+void getChunkTrackName(const char *from, const char *to, char *trackName) {
+
+  strcpy(trackName, "Senza nome");
+
+  const char *name = findElement(from, to, "name");
+  gpxTag tag;
+  if (name == NULL || nextGpxTag(&name, to, &tag) != 1 || tag.type != GPX_TAG_OPEN) return;
+
+  char buffer[TRACK_NAME_SIZE];
+  const char *text, *textEnd;
+  int inBuffer = getGpxText(name, to, buffer, sizeof(buffer), &text, &textEnd);
+
+  if (inBuffer < 0) return;
+  if (inBuffer) memcpy(trackName, buffer, textEnd - text + 1);
+  else copyGpxText(trackName, TRACK_NAME_SIZE, text, textEnd);
+}
+
+// metriche e distanze progressive dei punti compresi tra from e to (il contenuto di un segmento), letti in numChunks
+// blocchi su altrettanti thread. Restituisce 0 se un blocco non è XML valido
+int analyzeSegmentChunks(const jobConfig *job, const char *header, size_t headerSize, const char *from, const char *to, int numChunks, metrics *r, trackAnalysis *analysis) {
+
+  // i blocchi iniziano tutti con un <trkpt: il primo al primo punto, gli altri al primo punto dopo la loro quota di byte
+  const char *first = findElement(from, to, "trkpt");
+  size_t size = (first != NULL) ? (size_t)(to - first) : 0;
+
+  // i blocchi troppo piccoli non ripagano il costo del thread e del parser
+  if (numChunks > (int)(size / PARALLEL_MIN_CHUNK_SIZE) + 1) {
+    numChunks = (int)(size / PARALLEL_MIN_CHUNK_SIZE) + 1;
+  }
+
+  // un confine cercato a metà di un commento o di una sezione CDATA li spezzerebbe: il segmento è letto in un solo blocco
+  if (numChunks > 1 && (memmem(first, size, "<!--", 4) != NULL || memmem(first, size, "<![CDATA[", 9) != NULL)) {
+    numChunks = 1;
+  }
+
+  const char *bounds[numChunks + 1];
+  bounds[0] = (first != NULL) ? first : to;
+  bounds[numChunks] = to;
+
+  for (int c = 1; c < numChunks; c++) {
+    const char *target = first + (size * c) / numChunks;
+    if (target <= bounds[c - 1]) target = bounds[c - 1] + 1;
+
+    const char *next = (target < to) ? findElement(target, to, "trkpt") : NULL;
+    bounds[c] = (next != NULL) ? next : to;
+  }
+
+  parseChunk *chunks = calloc(numChunks, sizeof(parseChunk));
+  pthread_t threads[numChunks];
+
+  for (int c = 0; c < numChunks; c++) {
+    chunks[c].job = job;
+    chunks[c].header = header;
+    chunks[c].headerSize = headerSize;
+    chunks[c].data = bounds[c];
+    chunks[c].dataSize = bounds[c + 1] - bounds[c];
+
+    // l'ultimo blocco è elaborato dal thread chiamante
+    if (c < numChunks - 1) pthread_create(&threads[c], NULL, parseChunkWorker, &chunks[c]);
+  }
+
+  parseChunkWorker(&chunks[numChunks - 1]);
+
+  int ok = 1;
+  int numPoints = 0;
+
+  for (int c = 0; c < numChunks; c++) {
+    if (c < numChunks - 1) pthread_join(threads[c], NULL);
+    if (chunks[c].ret != 0) ok = 0;
+    numPoints += chunks[c].results.numPoints;
+  }
+
+  // unione dei risultati dei blocchi, nell'ordine della traccia
+  initTrackAnalysis(analysis, numPoints);
+
+  int64_t elapsedTime = 0;
+  gpxPoint lastPoint;
+
+  for (int c = 0; c < numChunks; c++) {
+    if (ok && chunks[c].results.numPoints > 0) {
+      mergeChunkResults(job, r, analysis, &chunks[c], &elapsedTime, &lastPoint);
+    }
+    freeTrackAnalysis(&(chunks[c].analysis));
+  }
+
+  r->totalTime = elapsedTime / 1000.0;
+  r->avgspeed = getAvgSpeed(r->distance, r->totalTime);
+
+  // il filtro delle quote ha uno stato che attraversa i confini dei blocchi: il dislivello si ricalcola in sequenza
+  // dalle quote del segmento, già unite nell'analisi
+  if (ok && isElevationFilterActive(job)) filterAnalysisElevation(job, analysis, r);
+
+  free(chunks);
+
+  if (!ok) freeTrackAnalysis(analysis);
+
+  return ok;
+}
+
+// thread della lettura parallela: legge i punti di un blocco con il parser in streaming e ne calcola le metriche parziali
+void *parseChunkWorker(void *arg) {
+
+  parseChunk *chunk = arg;
+
+  // la stampa dei punti (debug) è disattivata: i blocchi sono elaborati in un ordine qualunque
+  jobConfig job = *(chunk->job);
+  job.debug = 0;
+
+  initTrackAnalysis(&(chunk->analysis), (int)(chunk->dataSize / 64) + 1);
+
+  xmlTextReaderPtr reader = xmlReaderForIO(readChunkInput, NULL, chunk, NULL, NULL, 0);
+  if (reader == NULL) {
+    chunk->ret = 1;
+    return NULL;
+  }
+
+  // i punti del blocco sono già all'interno di una traccia e di un segmento
+  streamState *st = calloc(1, sizeof(streamState));
+  st->job = &job;
+  st->inTrack = 1;
+  st->inSegment = 1;
+  initAccumulator(&(st->acc), &job, &(chunk->results), NULL, &(chunk->analysis));
+
+  int ret;
+  STATS_BEGIN(parseTimer, STAT_PARSE);
+
+  while ((ret = xmlTextReaderRead(reader)) == 1) {
+    processStreamNode(reader, st);
+  }
+
+  STATS_END(parseTimer, 0);
+
+  finalizeAccumulator(&(st->acc));
+
+  chunk->elapsedTime = st->acc.elapsedTime;
+  chunk->firstPoint = st->acc.firstPoint;
+  chunk->firstSample = st->acc.firstSample;
+  chunk->lastPoint = st->acc.prevPoint;
+  chunk->ret = (ret != 0);
+
+  free(st);
+  xmlFreeTextReader(reader);
+
+  mergeThreadStats();
+  return NULL;
+}
+
+// callback di lettura del parser: restituisce in sequenza il prologo, i byte del blocco e la chiusura del documento
+int readChunkInput(void *context, char *buffer, int len) {
+
+  parseChunk *chunk = context;
+
+  const char *parts[] = { chunk->header, chunk->data, PARALLEL_CHUNK_FOOTER };
+  size_t sizes[] = { chunk->headerSize, chunk->dataSize, strlen(PARALLEL_CHUNK_FOOTER) };
+
+  size_t position = chunk->position;
+  int written = 0;
+
+  for (int i = 0; i < 3 && written < len; i++) {
+    if (position >= sizes[i]) {
+      position -= sizes[i];
+      continue;
+    }
+
+    size_t length = sizes[i] - position;
+    if (length > (size_t)(len - written)) length = len - written;
+
+    memcpy(buffer + written, parts[i] + position, length);
+    written += length;
+    chunk->position += length;
+    position = 0;
+  }
+
+  return written;
+}
+
+// aggiunge ai risultati del segmento quelli di un blocco: prima la coppia di confine (l'ultimo punto già elaborato e
+// il primo del blocco), poi le metriche parziali; le distanze progressive del blocco sono spostate della distanza già percorsa
+void mergeChunkResults(const jobConfig *job, metrics *r, trackAnalysis *analysis, const parseChunk *chunk, int64_t *elapsedTime, gpxPoint *lastPoint) {
+
+  const metrics *partial = &(chunk->results);
+
+  if (r->numPoints == 0) {
+    r->minElevation = partial->minElevation;
+    r->maxElevation = partial->maxElevation;
+  }
+  else {
+    // la distanza di confine è calcolata con la stessa funzione usata per il resto della traccia
+    double lat[2] = { lastPoint->lat * GRAD_TO_RAD, chunk->firstPoint.lat * GRAD_TO_RAD };
+    double lon[2] = { lastPoint->lon * GRAD_TO_RAD, chunk->firstPoint.lon * GRAD_TO_RAD };
+    double cosLat[2] = { cos(lat[0]), cos(lat[1]) };
+    double distances[2];
+
+    trackCoordinates c = { 2, lat, lon, cosLat };
+    getSegmentDistances(job, &c, distances);
+
+    r->distance += distances[1];
+
+    double ascent = getAscent(&(chunk->firstPoint), lastPoint);
+    (ascent > 0) ? (r->ascent += ascent) : (r->descent += fabs(ascent));
+
+    *elapsedTime += chunk->firstPoint.time - lastPoint->time;
+
+    // il tempo tra i due punti va nella zona cardiaca del primo punto del blocco
+    addHeartRateZoneTime(&(r->sensors), &(chunk->firstSample), chunk->firstPoint.time - lastPoint->time, chunk->job->hrMax);
+
+    if (partial->minElevation < r->minElevation) r->minElevation = partial->minElevation;
+    if (partial->maxElevation > r->maxElevation) r->maxElevation = partial->maxElevation;
+  }
+
+  for (int i = 0; i < chunk->analysis.numPoints; i++) {
+    addAnalysisPoint(analysis, r->distance + chunk->analysis.distance[i], chunk->analysis.elevation[i], chunk->analysis.time[i], chunk->analysis.heartRate[i]);
+  }
+
+  r->distance += partial->distance;
+  r->ascent += partial->ascent;
+  r->descent += partial->descent;
+  r->numPoints += partial->numPoints;
+  mergeSensorMetrics(&(r->sensors), &(partial->sensors));
+  *elapsedTime += chunk->elapsedTime;
+  *lastPoint = chunk->lastPoint;
+}
+
+// allocazione di memoria per libxml2 (tramite xmlMemSetup) e per i punti delle tracce: se l'arena del thread è attiva
+// la memoria viene dall'arena, altrimenti da malloc(). L'intestazione di ogni blocco ne indica l'origine, così
+// free() e realloc() funzionano anche su memoria allocata prima dell'attivazione dell'arena o da un altro thread
+void *arenaMalloc(size_t size) {
+
+  __atomic_fetch_add(&_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+  STATS_BYTES(size);
+
+  allocationHeader *header;
+
+  if (_ARENA_.active) {
+    header = arenaBump(&_ARENA_, sizeof(allocationHeader) + size);
+    if (header == NULL) return NULL;
+    header->origin = ARENA_ORIGIN_ARENA;
+  } else {
+    __atomic_fetch_add(&_SYSTEM_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+    header = malloc(sizeof(allocationHeader) + size);
+    if (header == NULL) return NULL;
+    header->origin = ARENA_ORIGIN_HEAP;
+  }
+
+  header->size = size;
+  return header + 1;
+}
+
+// come calloc(), con la memoria di arenaMalloc()
+void *arenaCalloc(size_t count, size_t size) {
+  void *ptr = arenaMalloc(count * size);
+  if (ptr != NULL) memset(ptr, 0, count * size);
+  return ptr;
+}
+
+// come realloc(): nell'arena, l'ultimo blocco allocato cresce sul posto se c'è spazio
+void *arenaRealloc(void *ptr, size_t size) {
+
+  if (ptr == NULL) return arenaMalloc(size);
+
+  allocationHeader *header = (allocationHeader*) ptr - 1;
+
+  if (header->origin == ARENA_ORIGIN_HEAP && !_ARENA_.active) {
+    __atomic_fetch_add(&_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&_SYSTEM_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+    if (size > header->size) STATS_BYTES(size - header->size);
+    header = realloc(header, sizeof(allocationHeader) + size);
+    if (header == NULL) return NULL;
+    header->size = size;
+    return header + 1;
+  }
+
+  arenaBlock *block = _ARENA_.current;
+  if (header->origin == ARENA_ORIGIN_ARENA && _ARENA_.active && block != NULL
+      && (char*) header + ARENA_ALIGN(sizeof(allocationHeader) + header->size) == block->data + block->used
+      && (char*) header + ARENA_ALIGN(sizeof(allocationHeader) + size) <= block->data + block->size) {
+    __atomic_fetch_add(&_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+    if (size > header->size) STATS_BYTES(size - header->size);
+    block->used = ((char*) header - block->data) + ARENA_ALIGN(sizeof(allocationHeader) + size);
+    header->size = size;
+    return ptr;
+  }
+
+  void *newPtr = arenaMalloc(size);
+  if (newPtr == NULL) return NULL;
+
+  memcpy(newPtr, ptr, (header->size < size) ? header->size : size);
+  arenaFree(ptr);
+
+  return newPtr;
+}
+
+// come free(): la memoria dell'arena viene recuperata tutta insieme, a fine file
+void arenaFree(void *ptr) {
+
+  if (ptr == NULL) return;
+
+  allocationHeader *header = (allocationHeader*) ptr - 1;
+  if (header->origin == ARENA_ORIGIN_HEAP) free(header);
+}
+
+// come strdup(), con la memoria di arenaMalloc()
+char *arenaStrdup(const char *str) {
+  size_t length = strlen(str) + 1;
+  char *copy = arenaMalloc(length);
+  if (copy != NULL) memcpy(copy, str, length);
+  return copy;
+}
+
+// riserva "size" byte nell'arena, passando al blocco successivo (o allocandone uno nuovo) se quello corrente è pieno;
+// le richieste più grandi di un quarto di blocco hanno un blocco dedicato. Restituisce NULL se malloc() fallisce
+void *arenaBump(memoryArena *arena, size_t size) {
+
+  size = ARENA_ALIGN(size);
+
+  if (size > ARENA_BLOCK_SIZE / 4) {
+    __atomic_fetch_add(&_SYSTEM_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+    arenaBlock *large = malloc(sizeof(arenaBlock) + size);
+    if (large == NULL) return NULL;
+    large->next = arena->large;
+    large->size = large->used = size;
+    arena->large = large;
+    return large->data;
+  }
+
+  if (arena->current == NULL) {
+    arena->current = arena->blocks;
+  }
+
+  while (arena->current != NULL && arena->current->used + size > arena->current->size) {
+    if (arena->current->next == NULL) break;
+    arena->current = arena->current->next;
+  }
+
+  if (arena->current == NULL || arena->current->used + size > arena->current->size) {
+    __atomic_fetch_add(&_SYSTEM_ALLOCATIONS_, 1, __ATOMIC_RELAXED);
+    arenaBlock *block = malloc(sizeof(arenaBlock) + ARENA_BLOCK_SIZE);
+    if (block == NULL) return NULL;
+    block->next = NULL;
+    block->size = ARENA_BLOCK_SIZE;
+    block->used = 0;
+
+    if (arena->current == NULL) arena->blocks = block;
+    else arena->current->next = block;
+    arena->current = block;
+  }
+
+  void *ptr = arena->current->data + arena->current->used;
+  arena->current->used += size;
+  return ptr;
+}
+
+// fine dell'elaborazione di un file: l'arena del thread viene disattivata e azzerata. I blocchi ordinari restano
+// allocati per il file successivo, quelli dedicati alle richieste grandi vengono liberati
+void resetArena(void) {
+
+  // l'ultimo errore di libxml2 del thread (messaggio, nome del file, ...) può essere nell'arena: va liberato ora,
+  // altrimenti il prossimo errore libererebbe con xmlFree() memoria già riutilizzata
+  xmlResetLastError();
+
+  _ARENA_.active = 0;
+
+  for (arenaBlock *block = _ARENA_.blocks; block != NULL; block = block->next) {
+    block->used = 0;
+  }
+  _ARENA_.current = _ARENA_.blocks;
+
+  while (_ARENA_.large != NULL) {
+    arenaBlock *next = _ARENA_.large->next;
+    free(_ARENA_.large);
+    _ARENA_.large = next;
+  }
+}
+
+// libera tutti i blocchi dell'arena del thread (alla fine del thread o del programma)
+void releaseArena(void) {
+
+  resetArena();
+
+  while (_ARENA_.blocks != NULL) {
+    arenaBlock *next = _ARENA_.blocks->next;
+    free(_ARENA_.blocks);
+    _ARENA_.blocks = next;
+  }
+  _ARENA_.current = NULL;
+}
+
+// inizio della misura di --stats: tick e tempo di riferimento per convertire i tick in ns
+void startStats(void) {
+  clock_gettime(CLOCK_MONOTONIC, &_STATS_START_TIME_);
+  _STATS_START_TICKS_ = getStatsTicks();
+}
+
+// contatore dei timer: su x86 il time-stamp counter (qualche ns per lettura), altrimenti l'orologio monotono in ns
+uint64_t getStatsTicks(void) {
+#ifdef HAVE_X86_SIMD
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+// inizio di una fase: il timer diventa quello in corso del thread. Dentro una fase uguale il timer è ignorato,
+// così il tempo e i punti non sono contati due volte (ad es. i blocchi dell'accumulatore dentro getResults())
+void beginStatsTimer(statsTimer *timer, statsStage stage) {
+
+  timer->stage = stage;
+  timer->parent = _STATS_TIMER_;
+  timer->nested = 0;
+
+  if (timer->parent != NULL && timer->parent->stage == stage) {
+    timer->start = 0;
+    return;
+  }
+
+  _STATS_TIMER_ = timer;
+  timer->start = getStatsTicks();
+}
+
+// fine di una fase: il tempo, al netto delle fasi annidate, va alla fase e viene tolto a quella esterna
+void endStatsTimer(statsTimer *timer, long points) {
+
+  if (timer->start == 0) return;
+
+  uint64_t elapsed = getStatsTicks() - timer->start;
+  statsEntry *e = &_THREAD_STATS_[timer->stage];
+
+  e->calls++;
+  e->ticks += elapsed - timer->nested;
+  e->points += points;
+
+  if (timer->parent != NULL) timer->parent->nested += elapsed;
+  _STATS_TIMER_ = timer->parent;
+}
+
+// memoria richiesta durante la fase in corso (fuori da tutte le fasi, in STAT_OTHER)
+void addStatsBytes(size_t size) {
+  statsStage stage = (_STATS_TIMER_ != NULL) ? _STATS_TIMER_->stage : STAT_OTHER;
+  _THREAD_STATS_[stage].bytes += size;
+}
+
+// somma i tempi e i contatori del thread a quelli complessivi (alla fine di ogni thread, e nel thread principale prima
+// della stampa) e li azzera
+void mergeThreadStats(void) {
+
+  if (!_STATS_) return;
+
+  pthread_mutex_lock(&_STATS_MUTEX_);
+
+  for (int i = 0; i < STATS_STAGES; i++) {
+    _STATS_TOTAL_[i].calls += _THREAD_STATS_[i].calls;
+    _STATS_TOTAL_[i].ticks += _THREAD_STATS_[i].ticks;
+    _STATS_TOTAL_[i].points += _THREAD_STATS_[i].points;
+    _STATS_TOTAL_[i].bytes += _THREAD_STATS_[i].bytes;
+  }
+
+  pthread_mutex_unlock(&_STATS_MUTEX_);
+  memset(_THREAD_STATS_, 0, sizeof(_THREAD_STATS_));
+}
+
+// stampa di --stats (sullo standard error nei formati JSON/CSV): per ogni fase tempo, quota del totale, chiamate,
+// punti, punti/s e memoria richiesta. Con più thread (batch, lettura parallela) i tempi sono sommati su tutti i thread,
+// quindi possono superare il tempo trascorso; "altro" è il tempo trascorso non attribuito a nessuna fase
+void printStats(const jobConfig *job) {
+
+  FILE *out = getMessageStream(job);
+
+#ifdef HAVE_STATS
+  mergeThreadStats();
+
+  const char *names[STATS_STAGES] = { "lettura", "XPath", "punti", "metriche", "profilo", "output", "altro" };
+
+  // ns per tick, dal tempo trascorso dall'inizio della misura
+  double elapsed = getElapsedSeconds(&_STATS_START_TIME_);
+  uint64_t ticks = getStatsTicks() - _STATS_START_TICKS_;
+  double tickNs = (ticks > 0) ? elapsed * 1e9 / ticks : 1.0;
+
+  double measured = 0.0;
+  for (int i = 0; i < STAT_OTHER; i++) measured += _STATS_TOTAL_[i].ticks * tickNs / 1e9;
+
+  fprintf(out, "\n[ Statistiche: %.2lf ms trascorsi ]\n\n", elapsed * 1000.0);
+  fprintf(out, "%-10s %12s %7s %10s %12s %14s %14s\n", "fase", "tempo (ms)", "%", "chiamate", "punti", "punti/s", "memoria (KB)");
+
+  double total = (measured > elapsed) ? measured : elapsed;
+
+  for (int i = 0; i < STATS_STAGES; i++) {
+    const statsEntry *e = &_STATS_TOTAL_[i];
+
+    // le fasi che non fanno parte della modalità di lettura usata non sono stampate
+    if (i != STAT_OTHER && e->calls == 0) continue;
+
+    double seconds = (i == STAT_OTHER) ? fmax(elapsed - measured, 0.0) : e->ticks * tickNs / 1e9;
+
+    fprintf(out, "%-10s %12.3lf %6.1lf%%", names[i], seconds * 1000.0, (total > 0) ? seconds * 100.0 / total : 0.0);
+
+    if (i == STAT_OTHER) fprintf(out, " %10s %12s %14s", "-", "-", "-");
+    else if (e->points > 0 && seconds > 0) fprintf(out, " %10ld %12ld %14.0lf", e->calls, e->points, e->points / seconds);
+    else fprintf(out, " %10ld %12s %14s", e->calls, "-", "-");
+
+    fprintf(out, " %14.1lf\n", e->bytes / 1024.0);
+  }
+#else
+  fprintf(out, "Statistiche non disponibili: il programma è stato compilato con -DNO_STATS\n");
+#endif
+}
+
+// prepara l'accumulatore per una nuova traccia
+void initAccumulator(trackAccumulator *acc, const jobConfig *job, metrics *r, elevationProfile *profile, trackAnalysis *analysis) {
+  memset(acc, 0, sizeof(trackAccumulator));
+  acc->job = job;
+  acc->results = r;
+  acc->profile = profile;
+  acc->analysis = analysis;
+
+  if (isElevationFilterActive(job)) initElevationFilter(&(acc->filter), job);
+}
+
+// aggiunge un punto alle metriche accumulate fino ad ora; il punto viene messo da parte e
+// conteggiato quando il blocco è pieno (o alla chiusura dell'accumulatore)
+void accumulatePoint(trackAccumulator *acc, const gpxPoint *p, const sensorSample *sample) {
+
+  if (sample != NULL) acc->sensorBlock[acc->blockSize] = *sample;
+  else acc->sensorBlock[acc->blockSize].present = 0;
+
+  acc->block[acc->blockSize++] = *p;
+
+  if (acc->blockSize == ACCUMULATOR_BLOCK) {
+    flushAccumulator(acc);
+  }
+}
+
+// elabora i punti messi da parte: le distanze del blocco (a partire dall'ultimo punto già elaborato)
+// sono calcolate tutte insieme, poi si aggiornano le metriche punto per punto
+void flushAccumulator(trackAccumulator *acc) {
+
+  if (acc->blockSize == 0) return;
+
+  STATS_BEGIN(metricsTimer, STAT_METRICS);
+
+  // il primo punto della traccia non ha un precedente: fa da precedente a se stesso
+  const gpxPoint *prevPoint = (acc->numPoints > 0) ? &(acc->prevPoint) : &(acc->block[0]);
+
+  acc->lat[0] = prevPoint->lat * GRAD_TO_RAD;
+  acc->lon[0] = prevPoint->lon * GRAD_TO_RAD;
+  acc->cosLat[0] = cos(acc->lat[0]);
+
+  for (int i = 0; i < acc->blockSize; i++) {
+    acc->lat[i + 1] = acc->block[i].lat * GRAD_TO_RAD;
+    acc->lon[i + 1] = acc->block[i].lon * GRAD_TO_RAD;
+    acc->cosLat[i + 1] = cos(acc->lat[i + 1]);
+  }
+
+  trackCoordinates c = { acc->blockSize + 1, acc->lat, acc->lon, acc->cosLat };
+  getSegmentDistances(acc->job, &c, acc->distances);
+
+  for (int i = 0; i < acc->blockSize; i++) {
+    addPointResults(acc, &(acc->block[i]), &(acc->sensorBlock[i]), acc->distances[i + 1]);
+  }
+
+  STATS_END(metricsTimer, acc->blockSize);
+  acc->blockSize = 0;
+}
+
+// aggiorna le metriche con un punto, nota la distanza dal punto precedente
+void addPointResults(trackAccumulator *acc, const gpxPoint *p, const sensorSample *sample, double distance) {
+
+  metrics *r = acc->results;
+
+  // struct con i dati del punto corrente
+  gpxPoint currPoint = *p;
+
+  if (acc->job->debug) { printPoint(acc->job, &currPoint, acc->numPoints); }
+
+  // se siamo al primo elemento, il punto "precedente" è il punto stesso;
+  if (acc->numPoints == 0) {
+    acc->firstPoint = currPoint;
+    acc->firstSample = *sample;
+    acc->prevPoint = currPoint;
+
+    // impostazione di minima e massima altezza a partire dal primo punto, così si ha un termine di paragone
+    r->minElevation = currPoint.elevation;
+    r->maxElevation = currPoint.elevation;
+  }
+
+  // distanza dal punto precedente
+  r->distance += distance; 
+
+  if (acc->filter.job != NULL) {
+    // le quote passano dal filtro, che accumula il dislivello
+    addFilterPoint(&(acc->filter), r->distance, currPoint.elevation);
+    r->ascent = acc->filter.ascent;
+    r->descent = acc->filter.descent;
+  }
+  else {
+    // ascesa (o discesa)
+    double ascent = getAscent(&currPoint, &(acc->prevPoint));
+
+    // dislivello positivo (salita) o negativo (discesa)
+    (ascent > 0) ? (r->ascent += ascent) : (r->descent += fabs(ascent));
+  }
+
+  // tempo rispetto al punto precedente (i tempi sono già in ms: basta una sottrazione)
+  acc->elapsedTime += currPoint.time - acc->prevPoint.time;
+  r->totalTime = acc->elapsedTime / 1000.0;
+
+  // sensori: solo i canali presenti nel punto
+  if (sample->present) {
+    addSensorResults(&(r->sensors), sample, currPoint.time - acc->prevPoint.time, acc->job->hrMax);
+  }
+
+  // quota minima/massima
+  if (currPoint.elevation < r->minElevation) {
+    r->minElevation = currPoint.elevation;
+  }
+
+  if (currPoint.elevation > r->maxElevation) {
+    r->maxElevation = currPoint.elevation;
+  }
+
+  // profilo altimetrico (quota alla distanza progressiva raggiunta)
+  if (acc->profile != NULL) {
+    addProfilePoint(acc->profile, r->distance, currPoint.elevation);
+  }
+
+  if (acc->analysis != NULL) {
+    double heartRate = (sample->present & (1u << CHANNEL_HR)) ? sample->value[CHANNEL_HR] : NAN;
+    addAnalysisPoint(acc->analysis, r->distance, currPoint.elevation, currPoint.time, heartRate);
+  }
+
+  // il punto appena elaborato diventa il "punto precedente"
+  acc->prevPoint = currPoint;
+  acc->numPoints++;
+}
+
+// calcoli finali, da eseguire dopo l'ultimo punto
+void finalizeAccumulator(trackAccumulator *acc) {
+
+  // punti rimasti nel blocco
+  flushAccumulator(acc);
+
+  if (acc->filter.job != NULL) {
+    finalizeElevationFilter(&(acc->filter));
+    acc->results->ascent = acc->filter.ascent;
+    acc->results->descent = acc->filter.descent;
+  }
+
+  // Calcolo della velocità media
+  acc->results->avgspeed = getAvgSpeed(acc->results->distance, acc->results->totalTime);
+  acc->results->numPoints = acc->numPoints;
+}
+
+// metriche di un segmento ancora aperto, in "live": i punti del blocco sono elaborati subito (le metriche non cambiano
+// se il blocco viene svuotato prima) e il filtro delle quote è chiuso su una copia, così il segmento può proseguire
+void getLiveResults(trackAccumulator *acc, metrics *live) {
+
+  flushAccumulator(acc);
+  *live = *(acc->results);
+
+  if (acc->filter.job != NULL) {
+    elevationFilter filter = acc->filter;
+    finalizeElevationFilter(&filter);
+    live->ascent = filter.ascent;
+    live->descent = filter.descent;
+  }
+
+  live->avgspeed = getAvgSpeed(live->distance, live->totalTime);
+  live->numPoints = acc->numPoints;
+}
+
+// somma ai totali di una traccia i risultati di un suo segmento. I segmenti sono interruzioni della registrazione:
+// la distanza e il tempo tra la fine di un segmento e l'inizio del successivo non vengono conteggiati
+void mergeResults(metrics *total, const metrics *segment) {
+
+  // un segmento senza punti non ha quote significative
+  if (segment->numPoints == 0) return;
+
+  if (total->numPoints == 0 || segment->minElevation < total->minElevation) {
+    total->minElevation = segment->minElevation;
+  }
+
+  if (total->numPoints == 0 || segment->maxElevation > total->maxElevation) {
+    total->maxElevation = segment->maxElevation;
+  }
+
+  total->distance += segment->distance;
+  total->ascent += segment->ascent;
+  total->descent += segment->descent;
+  total->totalTime += segment->totalTime;
+  total->numPoints += segment->numPoints;
+  mergeSensorMetrics(&(total->sensors), &(segment->sensors));
+
+  total->avgspeed = getAvgSpeed(total->distance, total->totalTime);
+}
+
+// dato un array di punti, calcola le metriche da inserire nei risultati finali;
+// se "analysis" non è NULL vi conserva le distanze progressive e le quote di ogni punto
+void getResults(const jobConfig *job, const gpxPoint *pointSet, const sensorStore *sensors, int size, metrics *r, trackAnalysis *analysis) {  
+
+  // i blocchi dell'accumulatore fanno parte di questa fase (un timer annidato nella stessa fase è ignorato)
+  STATS_BEGIN(metricsTimer, STAT_METRICS);
+
+  // l'accumulatore contiene i buffer del blocco di punti (qualche decina di KB): meglio non tenerlo sullo stack
+  trackAccumulator *acc = arenaMalloc(sizeof(trackAccumulator));
+  initAccumulator(acc, job, r, NULL, analysis);
+
+  // loop sull'array dei punti
+  for (int p = 0; p < size; p++) {
+    sensorSample sample;
+    loadSensorSample(sensors, p, &sample);
+    accumulatePoint(acc, &pointSet[p], &sample);
+  } // for p
+
+  finalizeAccumulator(acc);
+  arenaFree(acc);
+
+  STATS_END(metricsTimer, size);
+}
+
+// c'è un filtro delle quote da applicare prima del calcolo del dislivello?
+int isElevationFilterActive(const jobConfig *job) {
+  return (job->smoothing != SMOOTH_NONE || job->hysteresis > 0 || job->resampleDistance > 0);
+}
+
+// prepara il filtro delle quote di un segmento
+void initElevationFilter(elevationFilter *f, const jobConfig *job) {
+  memset(f, 0, sizeof(elevationFilter));
+  f->job = job;
+  f->windowSize = (job->smoothWindow < SMOOTH_MAX_WINDOW) ? job->smoothWindow : SMOOTH_MAX_WINDOW;
+}
+
+// un punto del segmento (distanza progressiva in m, quota): con il ricampionamento ne escono zero o più campioni,
+// interpolati ogni resampleDistance metri, altrimenti il punto stesso
+void addFilterPoint(elevationFilter *f, double distance, double elevation) {
+
+  double step = f->job->resampleDistance;
+
+  if (step <= 0 || f->numPoints == 0) {
+    addFilterSample(f, distance, elevation);
+    f->nextDistance = distance + step;
+    f->emitted = 1;
+  }
+  else {
+    f->emitted = 0;
+
+    while (f->nextDistance <= distance) {
+      double t = (distance > f->prevDistance) ? (f->nextDistance - f->prevDistance) / (distance - f->prevDistance) : 1.0;
+      addFilterSample(f, f->nextDistance, f->prevElevation + t * (elevation - f->prevElevation));
+
+      f->emitted = (f->nextDistance == distance);
+      f->nextDistance += step;
+    }
+  }
+
+  f->prevDistance = distance;
+  f->prevElevation = elevation;
+  f->numPoints++;
+}
+
+// un campione: livellamento, poi isteresi. Senza isteresi conta ogni variazione della quota livellata; con l'isteresi
+// la variazione rispetto all'ultimo campione conteggiato deve superare la soglia
+void addFilterSample(elevationFilter *f, double distance, double elevation) {
+
+  double smoothed = getSmoothedElevation(f, distance, elevation);
+
+  if (f->numSamples++ == 0) {
+    f->reference = smoothed;
+    return;
+  }
+
+  double delta = smoothed - f->reference;
+
+  if (fabs(delta) < f->job->hysteresis || delta == 0) return;
+
+  (delta > 0) ? (f->ascent += delta) : (f->descent -= delta);
+  f->reference = smoothed;
+}
+
+// quota livellata: mediana degli ultimi campioni (la finestra è un buffer circolare) o stima del filtro di Kalman,
+// la cui incertezza cresce con la distanza percorsa dall'ultimo campione
+double getSmoothedElevation(elevationFilter *f, double distance, double elevation) {
+
+  if (f->job->smoothing == SMOOTH_MEDIAN) {
+    f->window[f->windowPos++ % f->windowSize] = elevation;
+
+    int n = (f->windowPos < f->windowSize) ? f->windowPos : f->windowSize;
+    double sorted[SMOOTH_MAX_WINDOW];
+
+    // ordinamento per inserzione: la finestra è di pochi campioni
+    for (int i = 0; i < n; i++) {
+      double value = f->window[i];
+      int j = i;
+      while (j > 0 && sorted[j - 1] > value) {
+        sorted[j] = sorted[j - 1];
+        j--;
+      }
+      sorted[j] = value;
+    }
+
+    return (n % 2 == 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+  }
+
+  if (f->job->smoothing == SMOOTH_KALMAN) {
+    if (f->numSamples == 0) {
+      f->kalmanElevation = elevation;
+      f->kalmanVariance = KALMAN_MEASUREMENT_NOISE;
+    }
+    else {
+      f->kalmanVariance += KALMAN_PROCESS_NOISE * fabs(distance - f->kalmanDistance);
+
+      double gain = f->kalmanVariance / (f->kalmanVariance + KALMAN_MEASUREMENT_NOISE);
+      f->kalmanElevation += gain * (elevation - f->kalmanElevation);
+      f->kalmanVariance *= (1.0 - gain);
+    }
+
+    f->kalmanDistance = distance;
+    return f->kalmanElevation;
+  }
+
+  return elevation;
+}
+
+// fine del segmento: con il ricampionamento, anche l'ultimo punto diventa un campione
+void finalizeElevationFilter(elevationFilter *f) {
+  if (f->numPoints > 0 && !f->emitted) {
+    addFilterSample(f, f->prevDistance, f->prevElevation);
+    f->emitted = 1;
+  }
+}
+
+// dislivello di un segmento ricalcolato con il filtro a partire dalle quote conservate nell'analisi
+void filterAnalysisElevation(const jobConfig *job, const trackAnalysis *analysis, metrics *r) {
+
+  elevationFilter f;
+  initElevationFilter(&f, job);
+
+  for (int i = 0; i < analysis->numPoints; i++) {
+    addFilterPoint(&f, analysis->distance[i], analysis->elevation[i]);
+  }
+
+  finalizeElevationFilter(&f);
+  r->ascent = f.ascent;
+  r->descent = f.descent;
+}
+
+// impronta delle impostazioni che cambiano le metriche, cioè il filtro delle quote, il modello delle distanze e la FC
+// massima delle zone cardiache (0 con le impostazioni di default), per non usare metriche calcolate con altre impostazioni
+uint64_t getMetricsSettingsHash(const jobConfig *job) {
+
+  if (!isElevationFilterActive(job) && job->distance == DISTANCE_HAVERSINE && job->hrMax == DEFAULT_HR_MAX) return 0;
+
+  struct { int64_t smoothing; int64_t window; double hysteresis; double resample; int64_t distanceMode; int64_t hrMax; } settings;
+  memset(&settings, 0, sizeof(settings));
+
+  settings.smoothing = job->smoothing;
+  settings.window = (job->smoothing == SMOOTH_MEDIAN) ? job->smoothWindow : 0;
+  settings.hysteresis = job->hysteresis;
+  settings.resample = job->resampleDistance;
+  settings.distanceMode = job->distance;
+  settings.hrMax = job->hrMax;
+
+  return getContentHash((const char*) &settings, sizeof(settings));
+}
+
+// canale di un elemento delle estensioni dal suo nome locale (-1 se non è un sensore). Oltre ai nomi della
+// TrackPointExtension di Garmin (hr, cad, atemp) si riconoscono la potenza "power" e "PowerInWatts"
+int getSensorChannel(const char *name, int length) {
+
+  static const struct { const char *name; int channel; } names[] = {
+    { "hr", CHANNEL_HR }, { "cad", CHANNEL_CAD }, { "atemp", CHANNEL_ATEMP },
+    { "power", CHANNEL_POWER }, { "PowerInWatts", CHANNEL_POWER }
+  };
+
+  for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+    if (strncmp(name, names[i].name, length) == 0 && names[i].name[length] == '\0') return names[i].channel;
+  }
+
+  return -1;
+}
+
+// imposta il valore di un canale
+void setSensorValue(sensorSample *sample, int channel, double value) {
+  sample->value[channel] = (float) value;
+  sample->present |= 1u << channel;
+}
+
+// aggiunge alle metriche dei sensori i valori di un punto; "interval" è il tempo (ms) trascorso dal punto precedente
+void addSensorResults(sensorMetrics *m, const sensorSample *sample, int64_t interval, int hrMax) {
+
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    if (!(sample->present & (1u << c))) continue;
+
+    double value = sample->value[c];
+
+    if (m->count[c] == 0 || value < m->min[c]) m->min[c] = value;
+    if (m->count[c] == 0 || value > m->max[c]) m->max[c] = value;
+
+    m->sum[c] += value;
+    m->count[c]++;
+  }
+
+  addHeartRateZoneTime(m, sample, interval, hrMax);
+}
+
+// il tempo trascorso dal punto precedente viene attribuito alla zona cardiaca del punto
+void addHeartRateZoneTime(sensorMetrics *m, const sensorSample *sample, int64_t interval, int hrMax) {
+
+  if (!(sample->present & (1u << CHANNEL_HR)) || interval <= 0) return;
+
+  m->hrZoneTime[getHeartRateZone(sample->value[CHANNEL_HR], hrMax)] += interval;
+}
+
+// zona (0..HR_ZONES-1) di una frequenza cardiaca: limiti al 60, 70, 80 e 90% della FC massima
+int getHeartRateZone(double hr, int hrMax) {
+
+  int zone = (int)((hr * 10.0) / hrMax) - 5;
+
+  if (zone < 0) return 0;
+  if (zone >= HR_ZONES) return HR_ZONES - 1;
+  return zone;
+}
+
+// somma alle metriche dei sensori di una traccia quelle di un suo segmento (o di un blocco di punti)
+void mergeSensorMetrics(sensorMetrics *total, const sensorMetrics *part) {
+
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    if (part->count[c] == 0) continue;
+
+    if (total->count[c] == 0 || part->min[c] < total->min[c]) total->min[c] = part->min[c];
+    if (total->count[c] == 0 || part->max[c] > total->max[c]) total->max[c] = part->max[c];
+
+    total->sum[c] += part->sum[c];
+    total->count[c] += part->count[c];
+  }
+
+  for (int z = 0; z < HR_ZONES; z++) {
+    total->hrZoneTime[z] += part->hrZoneTime[z];
+  }
+}
+
+// prepara le colonne dei sensori per "capacity" punti; nessuna memoria viene allocata finché non arriva un valore
+void initSensorStore(sensorStore *store, int capacity) {
+  memset(store, 0, sizeof(sensorStore));
+  store->capacity = capacity;
+}
+
+// conserva i sensori del punto "index": per ogni canale presente si imposta il bit del bitmap e il valore
+void storeSensorSample(sensorStore *store, int index, const sensorSample *sample) {
+
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    if (!(sample->present & (1u << c))) continue;
+
+    if (store->values[c] == NULL) {
+      store->present[c] = arenaCalloc((store->capacity + 63) / 64, sizeof(uint64_t));
+      store->values[c] = arenaMalloc(sizeof(float) * store->capacity);
+    }
+
+    store->present[c][index >> 6] |= (uint64_t)1 << (index & 63);
+    store->values[c][index] = sample->value[c];
+  }
+}
+
+// sensori del punto "index" (nessun canale se store è NULL)
+void loadSensorSample(const sensorStore *store, int index, sensorSample *sample) {
+
+  sample->present = 0;
+  if (store == NULL) return;
+
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    if (store->present[c] == NULL || !((store->present[c][index >> 6] >> (index & 63)) & 1)) continue;
+
+    sample->value[c] = store->values[c][index];
+    sample->present |= 1u << c;
+  }
+}
+
+// libera le colonne dei sensori
+void freeSensorStore(sensorStore *store) {
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    arenaFree(store->present[c]);
+    arenaFree(store->values[c]);
+  }
+}
+
+// prepara un profilo altimetrico vuoto
+void initProfile(elevationProfile *profile) {
+  memset(profile, 0, sizeof(elevationProfile));
+  profile->binDistance = PROFILE_BIN_DISTANCE;
+}
+
+// aggiunge al profilo la quota di un punto posto alla distanza progressiva "distance" (in m)
+void addProfilePoint(elevationProfile *profile, double distance, double elevation) {
+
+  int bin = (int)(distance / profile->binDistance);
+
+  // la traccia non ci sta più: si fondono i contenitori a coppie raddoppiandone l'ampiezza
+  while (bin >= PROFILE_BINS) {
+    for (int i = 0; i < PROFILE_BINS / 2; i++) {
+      int a = 2*i;
+      int b = 2*i + 1;
+
+      // minimo e massimo di un contenitore vuoto non contano
+      double minElevation = (profile->count[a] == 0) ? profile->minElevation[b] : (profile->count[b] == 0) ? profile->minElevation[a] : fmin(profile->minElevation[a], profile->minElevation[b]);
+      double maxElevation = (profile->count[a] == 0) ? profile->maxElevation[b] : (profile->count[b] == 0) ? profile->maxElevation[a] : fmax(profile->maxElevation[a], profile->maxElevation[b]);
+
+      profile->elevation[i] = profile->elevation[a] + profile->elevation[b];
+      profile->minElevation[i] = minElevation;
+      profile->maxElevation[i] = maxElevation;
+      profile->count[i] = profile->count[a] + profile->count[b];
+    }
+    memset(profile->elevation + PROFILE_BINS / 2, 0, sizeof(double) * PROFILE_BINS / 2);
+    memset(profile->count + PROFILE_BINS / 2, 0, sizeof(int) * PROFILE_BINS / 2);
+
+    profile->binDistance *= 2;
+    profile->numBins = (profile->numBins + 1) / 2;
+    bin = (int)(distance / profile->binDistance);
+  }
+
+  if (profile->count[bin] == 0 || elevation < profile->minElevation[bin]) profile->minElevation[bin] = elevation;
+  if (profile->count[bin] == 0 || elevation > profile->maxElevation[bin]) profile->maxElevation[bin] = elevation;
+
+  profile->elevation[bin] += elevation;
+  profile->count[bin]++;
+
+  if (bin >= profile->numBins) {
+    profile->numBins = bin + 1;
+  }
+}
+
+// quota media per ciascuna unità di distanza del grafico, a partire dal profilo accumulato:
+// ogni contenitore finisce nella colonna in cui cade il suo centro
+void getProfileAvgElevation(const jobConfig *job, const elevationProfile *profile, const altigraphUnits *units, double *avgElevation, int avgElevationSize) {
+
+  if (avgElevationSize < 1) return;
+
+  // sullo heap, come gli altri buffer delle colonne: la larghezza del grafico può essere di milioni di colonne
+  int *count = calloc(avgElevationSize, sizeof(int));
+
+  if (count == NULL) {
+    for (int c = 0; c < avgElevationSize; c++) avgElevation[c] = NAN;
+    return;
+  }
+
+  for (int c = 0; c < avgElevationSize; c++) {
+    avgElevation[c] = 0.0;
+  }
+
+  for (int b = 0; b < profile->numBins; b++) {
+    if (profile->count[b] == 0) continue;
+
+    double center = (b + 0.5) * profile->binDistance;
+    int c = (units->distance > 0) ? (int)(center / units->distance) : 0;
+    if (c >= avgElevationSize) c = avgElevationSize - 1;
+
+    avgElevation[c] += profile->elevation[b];
+    count[c] += profile->count[b];
+  }
+
+  for (int c = 0; c < avgElevationSize; c++) {
+    if (count[c] > 0) avgElevation[c] /= count[c];
+  }
+
+  fillEmptyColumns(avgElevation, count, avgElevationSize);
+  free(count);
+
+  if (job->debug) { for (int j = 0; j < avgElevationSize; j++) { fprintf(getMessageStream(job), "\navgElevation[%d]: %lf", j, avgElevation[j]); } }
+}
+
+// le colonne del grafico senza punti (grafico più largo della traccia, o punti molto distanziati) ripetono la quota
+// della colonna precedente; le eventuali colonne vuote iniziali prendono la quota della prima colonna piena
+void fillEmptyColumns(double *avgElevation, const int *count, int avgElevationSize) {
+
+  double lastElevation = 0.0;
+  int first = 1;
+
+  for (int c = 0; c < avgElevationSize; c++) {
+    if (count[c] > 0) {
+      lastElevation = avgElevation[c];
+
+      if (first) {
+        for (int j = 0; j < c; j++) avgElevation[j] = lastElevation;
+        first = 0;
+      }
+    } else {
+      avgElevation[c] = lastElevation;
+    }
+  }
+}
+
+// prepara un'analisi vuota, con spazio per "capacity" punti (se ne servono di più lo spazio viene raddoppiato)
+void initTrackAnalysis(trackAnalysis *a, int capacity) {
+
+  if (capacity < 1) capacity = 1;
+
+  a->numPoints = 0;
+  a->capacity = capacity;
+  a->distance = arenaMalloc(sizeof(double) * capacity);
+  a->elevation = arenaMalloc(sizeof(double) * capacity);
+  a->elevationSum = arenaMalloc(sizeof(double) * (capacity + 1));
+  a->elevationSum[0] = 0.0;
+  a->time = arenaMalloc(sizeof(int64_t) * capacity);
+  a->heartRate = arenaMalloc(sizeof(double) * capacity);
+}
+
+// aggiunge un punto all'analisi, data la sua distanza progressiva
+void addAnalysisPoint(trackAnalysis *a, double distance, double elevation, int64_t time, double heartRate) {
+
+  if (a->numPoints == a->capacity) {
+    a->capacity *= 2;
+    a->distance = arenaRealloc(a->distance, sizeof(double) * a->capacity);
+    a->elevation = arenaRealloc(a->elevation, sizeof(double) * a->capacity);
+    a->elevationSum = arenaRealloc(a->elevationSum, sizeof(double) * (a->capacity + 1));
+    a->time = arenaRealloc(a->time, sizeof(int64_t) * a->capacity);
+    a->heartRate = arenaRealloc(a->heartRate, sizeof(double) * a->capacity);
+  }
+
+  int i = a->numPoints++;
+  a->distance[i] = distance;
+  a->elevation[i] = elevation;
+  a->elevationSum[i + 1] = a->elevationSum[i] + elevation;
+  a->time[i] = time;
+  a->heartRate[i] = heartRate;
+}
+
+// libera la memoria dell'analisi
+void freeTrackAnalysis(trackAnalysis *a) {
+  arenaFree(a->distance);
+  arenaFree(a->elevation);
+  arenaFree(a->elevationSum);
+  arenaFree(a->time);
+  arenaFree(a->heartRate);
+}
+
+// indice del primo punto con distanza progressiva >= distance (numPoints se non ce ne sono), con una ricerca binaria
+int findDistanceIndex(const trackAnalysis *a, double distance) {
+
+  int lo = 0;
+  int hi = a->numPoints;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (a->distance[mid] < distance) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+// analisi a finestre di un segmento: una passata sui punti per ogni finestra di --efforts (per le distanze, nella stessa
+// passata, anche la salita migliore) e una per i parziali per Km
+void getSegmentEfforts(const jobConfig *job, const trackAnalysis *analysis, segmentEfforts *e) {
+
+  STATS_BEGIN(metricsTimer, STAT_METRICS);
+
+  memset(e, 0, sizeof(segmentEfforts));
+  effortTrack t = { analysis->numPoints, analysis->distance, analysis->time, analysis->elevation };
+
+  for (int w = 0; w < job->numEfforts; w++) {
+    if (job->efforts[w].type == EFFORT_DISTANCE) {
+      findDistanceEffort(&t, job->efforts[w].length, &(e->best[w]), &(e->climb[w]));
+    } else {
+      findDurationEffort(&t, job->efforts[w].length, &(e->best[w]));
+    }
+  }
+
+  // un parziale per ogni Km intero, più quello rimanente
+  int maxSplits = (analysis->numPoints > 1) ? (int)((analysis->distance[analysis->numPoints - 1] - analysis->distance[0]) / EFFORT_SPLIT_DISTANCE) + 1 : 0;
+  e->splits = arenaMalloc(sizeof(effortSplit) * (maxSplits + 1));
+  e->numSplits = getEffortSplits(&t, EFFORT_SPLIT_DISTANCE, e->splits, maxSplits + 1);
+  if (e->numSplits > maxSplits + 1) e->numSplits = maxSplits + 1;
+
+  STATS_END(metricsTimer, analysis->numPoints);
+}
+
+// libera la memoria dei parziali
+void freeSegmentEfforts(segmentEfforts *e) {
+  arenaFree(e->splits);
+  e->splits = NULL;
+  e->numSplits = 0;
+}
+
+// nome di una finestra per la stampa: "5 Km", "400 m", "20 min", "1 h", "30 s"
+void getEffortName(const effortWindow *w, char *name, int size) {
+
+  if (w->type == EFFORT_DISTANCE) {
+    if (w->length >= 1000.0) snprintf(name, size, "%g Km", w->length / 1000.0);
+    else snprintf(name, size, "%g m", w->length);
+  }
+  else if (fmod(w->length, 3600.0) == 0) snprintf(name, size, "%g h", w->length / 3600.0);
+  else if (fmod(w->length, 60.0) == 0) snprintf(name, size, "%g min", w->length / 60.0);
+  else snprintf(name, size, "%g s", w->length);
+}
+
+// quota media per ciascuna unità di distanza del grafico: i punti della colonna c sono quelli con distanza progressiva
+// in [c * unità, (c+1) * unità), individuati con una ricerca binaria; la media si ricava dalle somme progressive delle quote.
+// Il costo non dipende dal numero di punti ma solo dal numero di colonne (per il logaritmo dei punti)
+void getAvgElevation(const jobConfig *job, const trackAnalysis *analysis, const altigraphUnits *units, double *avgElevation, int avgElevationSize) {
+
+  if (avgElevationSize < 1) return;
+
+  // sullo heap: la larghezza del grafico può essere di milioni di colonne (le colonne senza memoria restano vuote)
+  int *count = calloc(avgElevationSize, sizeof(int));
+
+  if (count == NULL) {
+    for (int c = 0; c < avgElevationSize; c++) avgElevation[c] = NAN;
+    return;
+  }
+
+  int lo = 0;
+
+  for (int c = 0; c < avgElevationSize; c++) {
+
+    // l'ultima colonna comprende tutti i punti rimasti (anche quelli oltre la distanza totale per effetto degli arrotondamenti)
+    int hi = (c == avgElevationSize - 1) ? analysis->numPoints : findDistanceIndex(analysis, (c + 1) * units->distance);
+    if (hi < lo) hi = lo;
+
+    count[c] = hi - lo;
+    avgElevation[c] = (count[c] > 0) ? (analysis->elevationSum[hi] - analysis->elevationSum[lo]) / count[c] : 0.0;
+
+    if (job->debug) { fprintf(getMessageStream(job), "Unita di distanza %d: punti %d - %d, quota media %lf\n", c, lo, hi, avgElevation[c]); }
+
+    lo = hi;
+  }
+
+  fillEmptyColumns(avgElevation, count, avgElevationSize);
+  free(count);
+
+  // stampo l'array avgElevation
+  if (job->debug) { for (int j = 0; j < avgElevationSize; j++) { fprintf(getMessageStream(job), "\navgElevation[%d]: %lf", j, avgElevation[j]); } }
+}
+
+// Verifica se esiste il file passato in ingresso
+// il qualificatore "const" impedisce la modifica della variabile passata per reference nell'argomento della funzione
+int fileExists(const char *filename) {
+  // basta verificare i permessi: il file verrà aperto dal parser
+  return (access(filename, R_OK) == 0);
+}
+
+// funzione di utilità: crea un contesto nell'ambito del documento XML nel quale sarà valutata una certa espressione XPath
+// a partire da un certo nodo
+xmlXPathContextPtr createXPathContext(xmlDocPtr doc, xmlNodePtr node) {
+  xmlXPathContextPtr ctx = xmlXPathNewContext(doc);
+  // namespace per identificare il contenuto come GPX
+  xmlXPathRegisterNs(ctx, (xmlChar*)"gpx", (xmlChar*) GPX_NAMESPACE_STR);
+  ctx->node = node;
+  return ctx;
+}
+
+// recupero delle tracce dal document
+xmlXPathObjectPtr getTracks(const xmlXPathContextPtr ctx) {
+  return evalXPath("//gpx:trk", ctx);  
+}
+
+// recupero dei segmenti di una traccia (il contesto deve essere posizionato sul nodo "trk")
+xmlXPathObjectPtr getTrackSegments(const xmlXPathContextPtr ctx) {
+  return evalXPath("gpx:trkseg", ctx);  
+}
+
+// recupero dei punti di un segmento (il contesto deve essere posizionato sul nodo "trkseg")
+xmlXPathObjectPtr getPoints(const xmlXPathContextPtr ctx) {
+  return evalXPath("gpx:trkpt", ctx);  
+}
+
+// valuta un'espressione XPath nel contesto dato, tenendo il conto delle valutazioni
+xmlXPathObjectPtr evalXPath(const char *expression, xmlXPathContextPtr ctx) {
+  _XPATH_EVALS_++;
+
+  STATS_BEGIN(xpathTimer, STAT_XPATH);
+  xmlXPathObjectPtr result = xmlXPathEvalExpression((xmlChar*)expression, ctx);
+  STATS_END(xpathTimer, (result != NULL && result->nodesetval != NULL) ? result->nodesetval->nodeNr : 0);
+
+  return result;
+}
+
+// restituisce il nome della traccia, dal nodo "name"
+void getTrackName(const xmlDocPtr doc, const xmlNodePtr node, char *trackName) {
+  xmlXPathContextPtr trackContext = createXPathContext(doc, node);
+  xmlXPathObjectPtr name = evalXPath("gpx:name", trackContext);
+  
+  strcpy(trackName, "Senza nome");
+  if (name->nodesetval && name->nodesetval->nodeNr > 0) {
+    char buffer[TRACK_NAME_SIZE];
+    const char *text = getNodeText(name->nodesetval->nodeTab[0], buffer, sizeof(buffer));
+    if (text != NULL) {
+      strncpy(trackName, text, TRACK_NAME_SIZE - 1);
+      trackName[TRACK_NAME_SIZE - 1] = '\0';
+    }
+  }
+
+  xmlXPathFreeObject(name);
+  xmlXPathFreeContext(trackContext);
+}
+
+// converte i dati di un nodo XML "trkpt" in una struct più facilmente manipolabile.
+// I figli del nodo sono visitati una sola volta, riconoscendo ele e time dal nome e dal namespace
+// (lo stesso puntatore xmlNs del trkpt): nessuna espressione XPath viene valutata per il singolo punto
+gpxPoint getPointData(const xmlNodePtr pointNode, sensorSample *sample) {
+  gpxPoint gp = {0};
+  char *end;
+
+  sample->present = 0;
+
+  // latitudine/longitudine: negli attributi "lat" e "lon" del trkpt, letti senza copiarne il valore
+  for (xmlAttrPtr attr = pointNode->properties; attr != NULL; attr = attr->next) {
+    if (attr->children == NULL || attr->children->content == NULL) continue;
+
+    if (xmlStrEqual(attr->name, (xmlChar*)"lat")) {
+      gp.lat = strtod((char*)attr->children->content, &end);
+    }
+    else if (xmlStrEqual(attr->name, (xmlChar*)"lon")) {
+      gp.lon = strtod((char*)attr->children->content, &end);
+    }
+  }
+
+  for (xmlNodePtr node = pointNode->children; node != NULL; node = node->next) {
+
+    // i sensori si trovano nelle estensioni del punto
+    if (node->type == XML_ELEMENT_NODE && node->ns == pointNode->ns && xmlStrEqual(node->name, (xmlChar*)"extensions")) {
+      readSensorNodes(node, sample);
+      continue;
+    }
+
+    // si considerano solo gli elementi GPX con un contenuto testuale
+    if (node->type != XML_ELEMENT_NODE || node->ns != pointNode->ns) continue;
+
+    char buffer[TRACK_NAME_SIZE];
+    const char *content = getNodeText(node, buffer, sizeof(buffer));
+    if (content == NULL) continue;
+
+    // quota del punto: nel campo "ele"
+    if (xmlStrEqual(node->name, (xmlChar*)"ele")) {
+      gp.elevation = strtod(content, &end);
+    }
+    // tempo: nel campo "time"
+    else if (xmlStrEqual(node->name, (xmlChar*)"time")) {
+      parseTimestamp(content, &(gp.time));
+    }
+  }
+
+  return gp;
+}
+
+// cerca i sensori tra i discendenti di un nodo "extensions" (di solito dentro un TrackPointExtension),
+// riconoscendoli dal nome locale qualunque sia il namespace
+void readSensorNodes(const xmlNodePtr node, sensorSample *sample) {
+
+  for (xmlNodePtr child = node->children; child != NULL; child = child->next) {
+    if (child->type != XML_ELEMENT_NODE) continue;
+
+    int channel = getSensorChannel((const char*) child->name, xmlStrlen(child->name));
+
+    if (channel < 0) {
+      readSensorNodes(child, sample);
+    }
+    else {
+      char buffer[TRACK_NAME_SIZE];
+      const char *text = getNodeText(child, buffer, sizeof(buffer));
+      if (text == NULL) continue;
+
+      char *end;
+      double value = strtod(text, &end);
+      if (end != text) setSensorValue(sample, channel, value);
+    }
+  }
+}
+
+// testo di un elemento: il contenuto dell'unico figlio di testo (o CDATA) senza copiarlo, altrimenti il testo di tutti
+// i figli, saltando commenti e istruzioni di elaborazione, ricomposto in "buffer" (al più size - 1 caratteri).
+// NULL se l'elemento non ha testo
+const char *getNodeText(const xmlNode *node, char *buffer, int size) {
+
+  const xmlNode *child = node->children;
+  if (child == NULL) return NULL;
+
+  if (child->next == NULL) {
+    return ((child->type == XML_TEXT_NODE || child->type == XML_CDATA_SECTION_NODE) && child->content != NULL) ? (const char*) child->content : NULL;
+  }
+
+  int length = 0;
+  int found = 0;
+
+  for (; child != NULL; child = child->next) {
+    if ((child->type != XML_TEXT_NODE && child->type != XML_CDATA_SECTION_NODE) || child->content == NULL) continue;
+
+    int copied = xmlStrlen(child->content);
+    if (copied > size - 1 - length) copied = size - 1 - length;
+    memcpy(buffer + length, child->content, copied);
+    length += copied;
+    found = 1;
+  }
+
+  buffer[length] = '\0';
+  return found ? buffer : NULL;
+}
+
+// dislivello tra due punti
+double getAscent(const gpxPoint *p1, const gpxPoint *p2) {
+  return (p1->elevation - p2->elevation);
+}
+
+// distanza tra due punti, applicando la formula dell'emisenoverso
+double getDistance(double lat1, double lon1, double lat2, double lon2) {
+
+  double latRad = (lat2 - lat1) * GRAD_TO_RAD;
+  double lonRad = (lon2 - lon1) * GRAD_TO_RAD;
+
+  double lat1Rad = lat1 * GRAD_TO_RAD;
+  double lat2Rad = lat2 * GRAD_TO_RAD;
+
+  double a = pow(sin(latRad / 2), 2.0) + pow(sin(lonRad / 2), 2.0) * cos(lat1Rad) * cos(lat2Rad);
+  double c = 2 * asin(sqrt(a));
+
+  return EARTH_RADIUS * c;
+}
+
+// prepara le coordinate (in radianti) di un array di punti in forma colonnare, calcolando una sola volta
+// il coseno della latitudine di ogni punto
+void initTrackCoordinates(trackCoordinates *c, const gpxPoint *pointSet, int size) {
+
+  c->size = size;
+  c->lat = malloc(sizeof(double) * (size + 1));
+  c->lon = malloc(sizeof(double) * (size + 1));
+  c->cosLat = malloc(sizeof(double) * (size + 1));
+
+  for (int i = 0; i < size; i++) {
+    c->lat[i] = pointSet[i].lat * GRAD_TO_RAD;
+    c->lon[i] = pointSet[i].lon * GRAD_TO_RAD;
+    c->cosLat[i] = cos(c->lat[i]);
+  }
+}
+
+// libera la memoria delle coordinate in forma colonnare
+void freeTrackCoordinates(trackCoordinates *c) {
+  free(c->lat);
+  free(c->lon);
+  free(c->cosLat);
+}
+
+// lunghezza di tutti i segmenti della traccia: distances[0] = 0, distances[i] = distanza tra i punti i-1 e i.
+// La funzione effettiva è quella del modello di --distance dell'elaborazione e (per l'emisenoverso) del processore
+void getSegmentDistances(const jobConfig *job, const trackCoordinates *c, double *distances) {
+
+  // le funzioni sono scelte una sola volta, anche se più thread elaborano file contemporaneamente: dipendono solo dal
+  // processore, mentre il modello è letto a ogni chiamata dalle impostazioni dell'elaborazione
+  static pthread_once_t selected = PTHREAD_ONCE_INIT;
+  pthread_once(&selected, initDistanceKernels);
+
+  _DISTANCE_KERNELS_[job->distance](c, distances);
+}
+
+// sceglie le funzioni usate da getSegmentDistances(), una per modello
+void initDistanceKernels(void) {
+  for (int m = 0; m < DISTANCE_MODES; m++) _DISTANCE_KERNELS_[m] = selectDistanceKernel((distanceMode) m);
+}
+
+// sceglie la funzione del modello richiesto; per l'emisenoverso la più veloce tra quelle supportate dal processore.
+// La scelta è fatta una volta per tutta la traccia, quindi nel ciclo sui punti non c'è nessun test sul modello
+distanceKernel selectDistanceKernel(distanceMode mode) {
+
+  if (mode == DISTANCE_WGS84) return getSegmentDistancesWgs84;
+
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+
+  if (mode == DISTANCE_FLAT) {
+    return __builtin_cpu_supports("avx2") ? getSegmentDistancesFlatAvx2 : getSegmentDistancesFlat;
+  }
+
+  if (__builtin_cpu_supports("avx2")) {
+    return getSegmentDistancesAvx2;
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return getSegmentDistancesSse2;
+  }
+#endif
+
+  if (mode == DISTANCE_FLAT) return getSegmentDistancesFlat;
+
+  return getSegmentDistancesScalar;
+}
+
+// formula dell'emisenoverso su coordinate in radianti, con i coseni delle latitudini già calcolati
+double getDistanceRad(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2) {
+
+  double sinLat = sin((lat2 - lat1) / 2);
+  double sinLon = sin((lon2 - lon1) / 2);
+
+  double a = sinLat * sinLat + sinLon * sinLon * cosLat1 * cosLat2;
+  double c = 2 * asin(sqrt(a));
+
+  return EARTH_RADIUS * c;
+}
+
+// versione scalare (usata anche quando il processore non ha istruzioni SIMD)
+void getSegmentDistancesScalar(const trackCoordinates *c, double *distances) {
+
+  if (c->size > 0) distances[0] = 0.0;
+
+  for (int i = 1; i < c->size; i++) {
+    distances[i] = getDistanceRad(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+// Nelle versioni vettoriali seno e arcoseno sono calcolati con i rispettivi sviluppi in serie, che per argomenti
+// fino a DISTANCE_POLY_LIMIT hanno un errore relativo inferiore a 1e-16. Se in un gruppo di segmenti anche uno solo
+// supera il limite (segmenti molto lunghi, o che attraversano l'antimeridiano) il gruppo è calcolato in modo scalare.
+
+// coefficienti di sin(x) = x (1 + S3 x^2 + S5 x^4 + ...)
+#define SIN_S3 (-1.0 / 6.0)
+#define SIN_S5 (1.0 / 120.0)
+#define SIN_S7 (-1.0 / 5040.0)
+#define SIN_S9 (1.0 / 362880.0)
+
+// coefficienti di asin(x) = x (1 + A3 x^2 + A5 x^4 + ...)
+#define ASIN_A3 (1.0 / 6.0)
+#define ASIN_A5 (3.0 / 40.0)
+#define ASIN_A7 (5.0 / 112.0)
+#define ASIN_A9 (35.0 / 1152.0)
+#define ASIN_A11 (63.0 / 2816.0)
+#define ASIN_A13 (231.0 / 13312.0)
+
+// versione SSE2: 2 segmenti alla volta
+void getSegmentDistancesSse2(const trackCoordinates *c, double *distances) {
+
+  const __m128d half = _mm_set1_pd(0.5);
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d limit = _mm_set1_pd(DISTANCE_POLY_LIMIT);
+  const __m128d signMask = _mm_set1_pd(-0.0);
+  const __m128d diameter = _mm_set1_pd(2 * EARTH_RADIUS);
+
+  if (c->size > 0) distances[0] = 0.0;
+
+  int i = 1;
+  for (; i + 1 < c->size; i += 2) {
+
+    __m128d x = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(c->lat + i), _mm_loadu_pd(c->lat + i - 1)), half);
+    __m128d y = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(c->lon + i), _mm_loadu_pd(c->lon + i - 1)), half);
+    __m128d cosProduct = _mm_mul_pd(_mm_loadu_pd(c->cosLat + i), _mm_loadu_pd(c->cosLat + i - 1));
+
+    __m128d outOfRange = _mm_or_pd(_mm_cmpgt_pd(_mm_andnot_pd(signMask, x), limit), _mm_cmpgt_pd(_mm_andnot_pd(signMask, y), limit));
+
+    // seno delle semi-differenze
+    __m128d z = _mm_mul_pd(x, x);
+    __m128d sinX = _mm_mul_pd(x, _mm_add_pd(one, _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(SIN_S3), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(SIN_S5), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(SIN_S7), _mm_mul_pd(z, _mm_set1_pd(SIN_S9))))))))));
+    z = _mm_mul_pd(y, y);
+    __m128d sinY = _mm_mul_pd(y, _mm_add_pd(one, _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(SIN_S3), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(SIN_S5), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(SIN_S7), _mm_mul_pd(z, _mm_set1_pd(SIN_S9))))))))));
+
+    __m128d a = _mm_add_pd(_mm_mul_pd(sinX, sinX), _mm_mul_pd(_mm_mul_pd(sinY, sinY), cosProduct));
+    __m128d s = _mm_sqrt_pd(a);
+
+    outOfRange = _mm_or_pd(outOfRange, _mm_cmpgt_pd(s, limit));
+
+    if (_mm_movemask_pd(outOfRange)) {
+      distances[i] = getDistanceRad(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+      distances[i+1] = getDistanceRad(c->lat[i], c->lon[i], c->cosLat[i], c->lat[i+1], c->lon[i+1], c->cosLat[i+1]);
+      continue;
+    }
+
+    // arcoseno
+    z = a;
+    __m128d asinS = _mm_mul_pd(s, _mm_add_pd(one, _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(ASIN_A3), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(ASIN_A5), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(ASIN_A7), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(ASIN_A9), _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(ASIN_A11), _mm_mul_pd(z, _mm_set1_pd(ASIN_A13))))))))))))));
+
+    _mm_storeu_pd(distances + i, _mm_mul_pd(diameter, asinS));
+  }
+
+  // eventuale ultimo segmento
+  for (; i < c->size; i++) {
+    distances[i] = getDistanceRad(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+  }
+}
+
+// versione AVX2: 4 segmenti alla volta (compilata per AVX2 anche se il resto del programma non lo è)
+__attribute__((target("avx2")))
+void getSegmentDistancesAvx2(const trackCoordinates *c, double *distances) {
+
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d limit = _mm256_set1_pd(DISTANCE_POLY_LIMIT);
+  const __m256d signMask = _mm256_set1_pd(-0.0);
+  const __m256d diameter = _mm256_set1_pd(2 * EARTH_RADIUS);
+
+  if (c->size > 0) distances[0] = 0.0;
+
+  int i = 1;
+  for (; i + 3 < c->size; i += 4) {
+
+    __m256d x = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(c->lat + i), _mm256_loadu_pd(c->lat + i - 1)), half);
+    __m256d y = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(c->lon + i), _mm256_loadu_pd(c->lon + i - 1)), half);
+    __m256d cosProduct = _mm256_mul_pd(_mm256_loadu_pd(c->cosLat + i), _mm256_loadu_pd(c->cosLat + i - 1));
+
+    __m256d outOfRange = _mm256_or_pd(_mm256_cmp_pd(_mm256_andnot_pd(signMask, x), limit, _CMP_GT_OQ), _mm256_cmp_pd(_mm256_andnot_pd(signMask, y), limit, _CMP_GT_OQ));
+
+    // seno delle semi-differenze
+    __m256d z = _mm256_mul_pd(x, x);
+    __m256d sinX = _mm256_mul_pd(x, _mm256_add_pd(one, _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(SIN_S3), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(SIN_S5), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(SIN_S7), _mm256_mul_pd(z, _mm256_set1_pd(SIN_S9))))))))));
+    z = _mm256_mul_pd(y, y);
+    __m256d sinY = _mm256_mul_pd(y, _mm256_add_pd(one, _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(SIN_S3), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(SIN_S5), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(SIN_S7), _mm256_mul_pd(z, _mm256_set1_pd(SIN_S9))))))))));
+
+    __m256d a = _mm256_add_pd(_mm256_mul_pd(sinX, sinX), _mm256_mul_pd(_mm256_mul_pd(sinY, sinY), cosProduct));
+    __m256d s = _mm256_sqrt_pd(a);
+
+    outOfRange = _mm256_or_pd(outOfRange, _mm256_cmp_pd(s, limit, _CMP_GT_OQ));
+
+    if (_mm256_movemask_pd(outOfRange)) {
+      for (int j = i; j < i + 4; j++) {
+        distances[j] = getDistanceRad(c->lat[j-1], c->lon[j-1], c->cosLat[j-1], c->lat[j], c->lon[j], c->cosLat[j]);
+      }
+      continue;
+    }
+
+    // arcoseno
+    z = a;
+    __m256d asinS = _mm256_mul_pd(s, _mm256_add_pd(one, _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(ASIN_A3), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(ASIN_A5), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(ASIN_A7), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(ASIN_A9), _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(ASIN_A11), _mm256_mul_pd(z, _mm256_set1_pd(ASIN_A13))))))))))))));
+
+    _mm256_storeu_pd(distances + i, _mm256_mul_pd(diameter, asinS));
+  }
+
+  // segmenti rimasti
+  for (; i < c->size; i++) {
+    distances[i] = getDistanceRad(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+  }
+}
+
+#endif
+
+// seno e coseno della latitudine ridotta (sull'ellissoide WGS-84) di un punto, dalla latitudine in radianti e dal suo
+// coseno: tan(U) = (1 - f) tan(lat), senza passare dalla tangente (che ai poli non è definita)
+void getReducedLatitude(double lat, double cosLat, double *sinU, double *cosU) {
+
+  double y = (1 - WGS84_F) * sin(lat);
+  double r = sqrt(y * y + cosLat * cosLat);
+
+  *sinU = y / r;
+  *cosU = cosLat / r;
+}
+
+// distanza geodetica sull'ellissoide WGS-84 (formula inversa di Vincenty) tra due punti, dalle loro latitudini ridotte e
+// dalla differenza di longitudine (in radianti). Restituisce NAN se l'iterazione non converge, cosa che succede solo per
+// punti quasi agli antipodi
+double getDistanceVincenty(double sinU1, double cosU1, double sinU2, double cosU2, double lonDelta) {
+
+  double lambda = lonDelta;
+
+  for (int i = 0; i < VINCENTY_MAX_ITERATIONS; i++) {
+
+    double sinLambda = sin(lambda);
+    double cosLambda = cos(lambda);
+
+    double x = cosU2 * sinLambda;
+    double y = cosU1 * sinU2 - sinU1 * cosU2 * cosLambda;
+    double sinSigma = sqrt(x * x + y * y);
+
+    // punti coincidenti
+    if (sinSigma == 0) return 0.0;
+
+    double cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+    double sigma = atan2(sinSigma, cosSigma);
+
+    double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+    double cos2Alpha = 1 - sinAlpha * sinAlpha;
+
+    // sull'equatore cos2Alpha = 0 e il termine non conta
+    double cos2SigmaM = (cos2Alpha != 0) ? cosSigma - 2 * sinU1 * sinU2 / cos2Alpha : 0.0;
+
+    double C = WGS84_F / 16 * cos2Alpha * (4 + WGS84_F * (4 - 3 * cos2Alpha));
+    double previous = lambda;
+
+    lambda = lonDelta + (1 - C) * WGS84_F * sinAlpha *
+             (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+
+    if (fabs(lambda - previous) < VINCENTY_TOLERANCE) {
+      double u2 = cos2Alpha * (WGS84_A * WGS84_A - WGS84_B * WGS84_B) / (WGS84_B * WGS84_B);
+      double A = 1 + u2 / 16384 * (4096 + u2 * (-768 + u2 * (320 - 175 * u2)));
+      double B = u2 / 1024 * (256 + u2 * (-128 + u2 * (74 - 47 * u2)));
+      double deltaSigma = B * sinSigma * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM) -
+                          B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) * (-3 + 4 * cos2SigmaM * cos2SigmaM)));
+
+      return WGS84_B * A * (sigma - deltaSigma);
+    }
+  }
+
+  return NAN;
+}
+
+// distanze sull'ellissoide WGS-84: la latitudine ridotta di ogni punto è calcolata una sola volta e passa al segmento
+// successivo. I punti consecutivi di una traccia non sono mai agli antipodi, ma se l'iterazione non converge il segmento
+// è misurato con l'emisenoverso
+void getSegmentDistancesWgs84(const trackCoordinates *c, double *distances) {
+
+  if (c->size <= 0) return;
+
+  distances[0] = 0.0;
+
+  double sinU1, cosU1;
+  getReducedLatitude(c->lat[0], c->cosLat[0], &sinU1, &cosU1);
+
+  for (int i = 1; i < c->size; i++) {
+
+    double sinU2, cosU2;
+    getReducedLatitude(c->lat[i], c->cosLat[i], &sinU2, &cosU2);
+
+    double distance = getDistanceVincenty(sinU1, cosU1, sinU2, cosU2, remainder(c->lon[i] - c->lon[i-1], 360 * GRAD_TO_RAD));
+    if (isnan(distance)) distance = getDistanceRad(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+
+    distances[i] = distance;
+    sinU1 = sinU2;
+    cosU1 = cosU2;
+  }
+}
+
+// distanze nel piano tangente all'ellissoide WGS-84 alla latitudine media del segmento: la differenza di latitudine è
+// scalata dal raggio di curvatura del meridiano (M), quella di longitudine dal raggio del parallelo (N cos lat). Il coseno
+// della latitudine media è la media dei coseni dei due punti, quindi non servono funzioni trigonometriche. L'errore
+// rispetto all'ellissoide cresce con il quadrato della lunghezza del segmento (vedi --bench=geodesic): trascurabile per
+// i pochi metri tra due punti registrati ogni secondo, non per i salti di centinaia di km
+void getSegmentDistancesFlat(const trackCoordinates *c, double *distances) {
+
+  if (c->size > 0) distances[0] = 0.0;
+
+  for (int i = 1; i < c->size; i++) {
+    distances[i] = getDistanceFlat(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+  }
+}
+
+// distanza tra due punti nel piano tangente all'ellissoide (coordinate in radianti, coseni delle latitudini già calcolati)
+double getDistanceFlat(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2) {
+
+  double cosLat = (cosLat1 + cosLat2) * 0.5;
+  double w = 1 - WGS84_E2 * (1 - cosLat * cosLat);
+  double n = WGS84_A / sqrt(w);
+  double m = n * (1 - WGS84_E2) / w;
+
+  // differenza di longitudine riportata in [-pi, pi] senza salti condizionati (le longitudini sono in [-pi, pi])
+  double lonDelta = lon2 - lon1;
+  lonDelta -= ((lonDelta > 180 * GRAD_TO_RAD) - (lonDelta < -180 * GRAD_TO_RAD)) * (360 * GRAD_TO_RAD);
+
+  double x = n * cosLat * lonDelta;
+  double y = m * (lat2 - lat1);
+
+  return sqrt(x * x + y * y);
+}
+
+#ifdef HAVE_X86_SIMD
+
+// piano tangente, quattro segmenti alla volta con AVX2: la correzione della differenza di longitudine è fatta con
+// le maschere dei confronti
+__attribute__((target("avx2")))
+void getSegmentDistancesFlatAvx2(const trackCoordinates *c, double *distances) {
+
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d e2 = _mm256_set1_pd(WGS84_E2);
+  const __m256d semiMajor = _mm256_set1_pd(WGS84_A);
+  const __m256d meridian = _mm256_set1_pd(1 - WGS84_E2);
+  const __m256d pi = _mm256_set1_pd(180 * GRAD_TO_RAD);
+  const __m256d minusPi = _mm256_set1_pd(-180 * GRAD_TO_RAD);
+  const __m256d twoPi = _mm256_set1_pd(360 * GRAD_TO_RAD);
+
+  if (c->size > 0) distances[0] = 0.0;
+
+  int i = 1;
+  for (; i + 3 < c->size; i += 4) {
+
+    __m256d cosLat = _mm256_mul_pd(_mm256_add_pd(_mm256_loadu_pd(c->cosLat + i - 1), _mm256_loadu_pd(c->cosLat + i)), half);
+    __m256d w = _mm256_sub_pd(one, _mm256_mul_pd(e2, _mm256_sub_pd(one, _mm256_mul_pd(cosLat, cosLat))));
+    __m256d n = _mm256_div_pd(semiMajor, _mm256_sqrt_pd(w));
+    __m256d m = _mm256_div_pd(_mm256_mul_pd(n, meridian), w);
+
+    __m256d lonDelta = _mm256_sub_pd(_mm256_loadu_pd(c->lon + i), _mm256_loadu_pd(c->lon + i - 1));
+    lonDelta = _mm256_sub_pd(lonDelta, _mm256_and_pd(_mm256_cmp_pd(lonDelta, pi, _CMP_GT_OQ), twoPi));
+    lonDelta = _mm256_add_pd(lonDelta, _mm256_and_pd(_mm256_cmp_pd(lonDelta, minusPi, _CMP_LT_OQ), twoPi));
+
+    __m256d x = _mm256_mul_pd(_mm256_mul_pd(n, cosLat), lonDelta);
+    __m256d y = _mm256_mul_pd(m, _mm256_sub_pd(_mm256_loadu_pd(c->lat + i), _mm256_loadu_pd(c->lat + i - 1)));
+
+    _mm256_storeu_pd(distances + i, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y))));
+  }
+
+  // segmenti rimasti
+  for (; i < c->size; i++) {
+    distances[i] = getDistanceFlat(c->lat[i-1], c->lon[i-1], c->cosLat[i-1], c->lat[i], c->lon[i], c->cosLat[i]);
+  }
+}
+
+#endif
+
+// crea una struct tm a partire da un numero di secondi
+struct tm seconds2tm(double timeInSeconds) {
+  unsigned int hours = (int) (timeInSeconds / 3600.0);
+  int minutes = (int) ((timeInSeconds - (3600 * hours)) / 60.0);
+  int seconds = (int) (timeInSeconds - (3600 * hours) - (60 * minutes));
+
+  struct tm result = {0};
+
+  result.tm_sec = seconds;
+  result.tm_min = minutes;
+  result.tm_hour = hours;
+
+  return result;
+}
+
+// converte un istante GPX (ISO 8601, "2018-06-12T16:34:57.000Z") in millisecondi dal 1970-01-01T00:00:00Z.
+// Il formato è fisso, quindi si leggono direttamente le cifre senza passare da strptime()/mktime();
+// sono ammessi i decimali dei secondi (ne vengono considerati al massimo 3) e un fuso orario "Z", "+hh:mm" o "-hh:mm".
+// Restituisce 0 se il testo non è nel formato atteso (in tal caso "time" non viene modificato)
+int parseTimestamp(const char *text, int64_t *time) {
+
+  // posizione delle cifre di anno, mese, giorno, ore, minuti e secondi in "YYYY-MM-DDTHH:MM:SS"
+  static const int fieldStart[] = { 0, 5, 8, 11, 14, 17 };
+  static const int fieldLength[] = { 4, 2, 2, 2, 2, 2 };
+  static const char separators[] = "--T::";
+  int fields[6];
+
+  for (int f = 0; f < 6; f++) {
+    int value = 0;
+    for (int i = fieldStart[f]; i < fieldStart[f] + fieldLength[f]; i++) {
+      if (text[i] < '0' || text[i] > '9') return 0;
+      value = value * 10 + (text[i] - '0');
+    }
+    fields[f] = value;
+
+    if (f < 5 && text[fieldStart[f] + fieldLength[f]] != separators[f]) return 0;
+  }
+
+  const char *p = text + 19;
+
+  // frazioni di secondo
+  int milliseconds = 0;
+  if (*p == '.') {
+    int digits = 0;
+    for (p++; *p >= '0' && *p <= '9'; p++, digits++) {
+      if (digits < 3) milliseconds = milliseconds * 10 + (*p - '0');
+    }
+    for (; digits < 3; digits++) milliseconds *= 10;
+  }
+
+  // fuso orario: l'istante viene riportato in UTC
+  int offsetMinutes = 0;
+  if (*p == '+' || *p == '-') {
+    int sign = (*p == '+') ? 1 : -1;
+    p++;
+    if (p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9') return 0;
+    offsetMinutes = ((p[0] - '0') * 10 + (p[1] - '0')) * 60;
+    p += 2;
+    if (*p == ':') p++;
+    if (p[0] >= '0' && p[0] <= '9' && p[1] >= '0' && p[1] <= '9') {
+      offsetMinutes += (p[0] - '0') * 10 + (p[1] - '0');
+    }
+    offsetMinutes *= sign;
+  }
+
+  int64_t days = daysFromCivil(fields[0], fields[1], fields[2]);
+  int64_t seconds = days * 86400 + fields[3] * 3600 + fields[4] * 60 + fields[5] - offsetMinutes * 60;
+
+  *time = seconds * 1000 + milliseconds;
+  return 1;
+}
+
+// scrive un istante (ms dal 1970-01-01T00:00:00Z) nel formato GPX "2018-06-12T16:34:57.000Z"; buffer di almeno 25 caratteri
+void formatTimestamp(int64_t time, char *buffer) {
+
+  int64_t seconds = time / 1000;
+  int milliseconds = (int)(time % 1000);
+  if (milliseconds < 0) {
+    milliseconds += 1000;
+    seconds--;
+  }
+
+  int64_t days = seconds / 86400;
+  int secondOfDay = (int)(seconds % 86400);
+  if (secondOfDay < 0) {
+    secondOfDay += 86400;
+    days--;
+  }
+
+  int year, month, day;
+  civilFromDays(days, &year, &month, &day);
+
+  sprintf(buffer, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", year, month, day, secondOfDay / 3600, (secondOfDay / 60) % 60, secondOfDay % 60, milliseconds);
+}
+
+// numero di giorni dal 1970-01-01 di una data del calendario gregoriano
+// (algoritmo "days_from_civil" di H. Hinnant, http://howardhinnant.github.io/date_algorithms.html)
+int64_t daysFromCivil(int year, int month, int day) {
+  year -= (month <= 2);
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int yearOfEra = year - era * 400;
+  int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+// data del calendario gregoriano a partire dal numero di giorni dal 1970-01-01 (inversa di daysFromCivil)
+void civilFromDays(int64_t days, int *year, int *month, int *day) {
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int dayOfEra = (int)(days - era * 146097);
+  int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  int mp = (5 * dayOfYear + 2) / 153;
+
+  *day = dayOfYear - (153 * mp + 2) / 5 + 1;
+  *month = mp + (mp < 10 ? 3 : -9);
+  *year = (int)(yearOfEra + era * 400) + (*month <= 2);
+}
+
+// calcola la velocità media in Km/h data una distanza in Km ed un tempo in secondi
+double getAvgSpeed(double distance, double timeInSeconds) {
+  return ((distance / timeInSeconds) * 3.6);
+}
+
+// stampa una struct gpxPoint
+void printPoint(const jobConfig *job, const gpxPoint *p, int pointNumber) {
+  
+  char formattedTime[32];
+  formatTimestamp(p->time, formattedTime);
+  fprintf(getMessageStream(job), "Punto %d\tquota: %.2lf\t%.2f\t%.2f\t%s\n", pointNumber, p->elevation, p->lat, p->lon, formattedTime);
+}
+
+// stampa risultati
+void printResults(const jobConfig *job, const char *filename, const metrics *r) {
+
+  // si fa qui solo per esigenze di formattazione (in result infatti ci sono solo dati "grezzi", non formattati)
+  struct tm totalTime = seconds2tm((r->totalTime));
+  fprintf(job->out, "[ Elaborazione file <%s> ]\n\n", filename);
+
+  fprintf(job->out, "[ Traccia <%s> ]\n\n", r->name);
+  fprintf(job->out, "* Distanza (Km):\t\t%8.2lf\n", r->distance / 1000.0);
+  fprintf(job->out, "* Tempo impiegato (h:m:s):\t%02d:%02d:%02d\n", totalTime.tm_hour, totalTime.tm_min, totalTime.tm_sec);
+  fprintf(job->out, "* Velocità media (Km/h):\t%8.2lf\n\n", r->avgspeed);
+  fprintf(job->out, "* Dislivello in salita (m):\t%8.2lf\n", r->ascent);
+  fprintf(job->out, "* Dislivello in discesa (m):\t%8.2lf\n\n", r->descent);
+  fprintf(job->out, "* Quota massima (m):\t\t%8.2lf\n", r->maxElevation);
+  fprintf(job->out, "* Quota minima (m):\t\t%8.2lf\n", r->minElevation);
+  fprintf(job->out, "\n");
+
+  printSensorResults(job, r);
+}
 
-#define __USE_XOPEN // Per strptime, altrimenti la definizione non viene trovata
-#include <time.h>
+// metriche dei sensori, solo per i canali presenti nella traccia
+void printSensorResults(const jobConfig *job, const metrics *r) {
 
-// libxml2
-#include <libxml/parser.h>
-#include <libxml/tree.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
-
-// namespace che identifica i GPX
-#define GPX_NAMESPACE_STR "http://www.topografix.com/GPX/1/1"
-
-// raggio terrestre (in m) come implementato sui GPS
-#define EARTH_RADIUS 6.37813 * 1000 * 1000
-
-// fattore di conversione tra gradi e radianti (pi/180)
-#define GRAD_TO_RAD (3.1415926536 / 180)
-
-// carattere usato per rappresentare il grafico altimetrico
-#define ALTIGRAPH_FILL_CHAR '*'
-
-// dimensioni di default della matrice usata per il grafico altimetrico
-#define DEFAULT_ALTIGRAPH_ROWS 30
-#define DEFAULT_ALTIGRAPH_COLS 100
-
-
-// tipi custom: Risultati finali
-typedef struct {
-  char name[50];
-  double distance;
-  double ascent;
-  double descent;
-  double avgspeed;
-  double totalTime;
-  double minElevation;
-  double maxElevation;
-} metrics;
-
-// Rappresentazione di un punto GPX
-typedef struct {
-  double lat;
-  double lon;
-  double elevation;
-  struct tm time;
-} gpxPoint;
-
-// unità di distanza e di altezza per la stampa del grafico altimetrico
-typedef struct {
-  double height;
-  double distance;
-} altigraphUnits;
-
-// dimensioni del grafico altimetrico
-typedef struct {
-  int rows;
-  int cols;
-} altigraphSize;
-
-
-// global variable per attivare la modalità di debugging
-int _DEBUG_ = 0;
-
-// global variable con le dimensioni della matrice
-altigraphSize _ALTIGRAPH_SIZE_;
-
-// prototipi delle funzioni
-int fileExists(const char *filename);
-int processFile(const char *filename);
-
-void getResults(gpxPoint *pointSet, int size, metrics *r);
-void printResults(const char *filename, const metrics *r);
-void printPoint(const gpxPoint *p, int pointNumber);
-void printAltiGraph(const metrics *r, const gpxPoint *pointSet, int numPoints);
-void fillAltiGraphMatrix(int rows, int cols, char matrix[rows][cols], const altigraphUnits *units, const double *avgElevation, int minElevation);
-void printAltiGraphMatrix(int rows, int cols, const char matrix[rows][cols], const metrics *results, const altigraphUnits *units);
-
-struct tm seconds2tm(double timeInSeconds);
-
-gpxPoint getPointData(const xmlDocPtr doc, const xmlNodePtr pointNode);
-double getAscent(const gpxPoint *p1, const gpxPoint *p2);
-double getDistance(double lat1, double lon1, double lat2, double lon2);
-double getAvgSpeed(double distance, double timeInSeconds);
-void getAvgElevation(const gpxPoint *pointSet, int size, const altigraphUnits *units, double *avgElevation, int avgElevationSize);
-
-void getTrackName(const xmlDocPtr doc, const xmlNodePtr node, char *trackName);
-xmlXPathContextPtr createXPathContext(xmlDocPtr doc, xmlNodePtr node);
-xmlXPathObjectPtr getTrackSegments(const xmlXPathContextPtr ctx);
-xmlXPathObjectPtr getPoints(const xmlXPathContextPtr ctx);
+  const sensorMetrics *m = &(r->sensors);
 
-// main
-int main(int argc, char *argv[]) {
+  if (m->count[CHANNEL_HR] > 0) {
+    fprintf(job->out, "* FC media (bpm):\t\t%8.0lf\n", m->sum[CHANNEL_HR] / m->count[CHANNEL_HR]);
+    fprintf(job->out, "* FC massima (bpm):\t\t%8.0lf\n", m->max[CHANNEL_HR]);
+  }
 
-  const char *filename = argv[1];
-  
-  // per attivare il debug
-  _DEBUG_ = ((argc > 4) ? atoi(argv[4]) : 0);
-  _ALTIGRAPH_SIZE_.rows = ((argc > 3) ? abs(atoi(argv[3])) : DEFAULT_ALTIGRAPH_ROWS);
-  _ALTIGRAPH_SIZE_.cols = ((argc > 2) ? abs(atoi(argv[2])) : DEFAULT_ALTIGRAPH_COLS);
+  if (m->count[CHANNEL_CAD] > 0) {
+    fprintf(job->out, "* Cadenza media (rpm):\t\t%8.0lf\n", m->sum[CHANNEL_CAD] / m->count[CHANNEL_CAD]);
+  }
 
-  printf("\n[ C GPS Reader v1.0 - by gabriele.bernuzzi@studenti.unimi.it ]\n");
+  if (m->count[CHANNEL_POWER] > 0) {
+    fprintf(job->out, "* Potenza media (W):\t\t%8.0lf\n", m->sum[CHANNEL_POWER] / m->count[CHANNEL_POWER]);
+    fprintf(job->out, "* Potenza massima (W):\t\t%8.0lf\n", m->max[CHANNEL_POWER]);
+  }
 
-  // validazione argomenti
-  if (argc < 2 || !fileExists(filename)) {
-    printf("Uso: gpsreader [file] [width] [height] [debug]\n\t\n\t\n[file]\n  nome del file GPX da elaborare\n\t\n[width]\n  larghezza (in caratteri) del grafico altimetrico\n\t\n[height]\n  altezza (in caratteri) del grafico altimetrico\n\t\n[debug]\n  0 = debug disattivo; 1 = debug attivo\n\n");
-    return 1;
+  if (m->count[CHANNEL_ATEMP] > 0) {
+    fprintf(job->out, "* Temperatura minima (°C):\t%8.1lf\n", m->min[CHANNEL_ATEMP]);
+    fprintf(job->out, "* Temperatura massima (°C):\t%8.1lf\n", m->max[CHANNEL_ATEMP]);
   }
 
-  if (_DEBUG_) { printf("\n\t[Debug mode ON]\n"); }
-    
-  return processFile(filename);
-}
+  if (m->count[CHANNEL_HR] > 0) {
+    fprintf(job->out, "\n");
+    printHrZones(job, m->hrZoneTime);
+  }
 
-// processing del file XML
-int processFile(const char *filename) {
+  if (m->count[CHANNEL_HR] + m->count[CHANNEL_CAD] + m->count[CHANNEL_POWER] + m->count[CHANNEL_ATEMP] > 0) {
+    fprintf(job->out, "\n");
+  }
+}
 
-  // Inizializzazione parser libxml
-  xmlInitParser();
+// tempo (ms) in ciascuna zona cardiaca, con una barra proporzionale alla frazione del tempo totale
+void printHrZones(const jobConfig *job, const int64_t *zoneTime) {
 
-  // parsing file XML
-  xmlDocPtr xmlDoc = xmlParseFile(filename);
+  int64_t zoneTotal = 0;
+  for (int z = 0; z < HR_ZONES; z++) zoneTotal += zoneTime[z];
 
-  // Creazione di un "contesto" nell'ambito del documento XML nel quale sarà valutata una certa espressione XPath
-  // Questo specifico contesto racchiude tutto il documento (verrà usato infatti per cercare le tracce)
-  xmlXPathContextPtr docContext = xmlXPathNewContext(xmlDoc);
+  fprintf(job->out, "* Tempo nelle zone cardiache (FC massima %d bpm):\n", job->hrMax);
 
-  // namespace per identificare il contenuto come aderente al formato GPX
-  xmlXPathRegisterNs(docContext, (xmlChar*)"gpx", (xmlChar*) GPX_NAMESPACE_STR);
+  for (int z = 0; z < HR_ZONES; z++) {
+    struct tm time = seconds2tm(zoneTime[z] / 1000.0);
+    int from = (int) round(job->hrMax * (z + 5) / 10.0);
+    int to = (int) round(job->hrMax * (z + 6) / 10.0);
 
-  // Ricerca dei segmenti della traccia: sono nel nodo /gpx/trk/trkseg
-  xmlXPathObjectPtr trackSegments = getTrackSegments(docContext);
-  if(trackSegments == NULL || xmlXPathNodeSetIsEmpty(trackSegments->nodesetval)){
-    printf("Non ho trovato tracce nel file \"%s\"\n", filename);
-    return 1;
-  }
+    // barra proporzionale alla frazione del tempo passata nella zona
+    int bar = (zoneTotal > 0) ? (int)(zoneTime[z] * 40 / zoneTotal) : 0;
+    char bars[41];
+    memset(bars, ALTIGRAPH_FILL_CHAR, bar);
+    bars[bar] = '\0';
 
-  if (_DEBUG_) { printf("Numero segmenti traccia: %d\n",trackSegments->nodesetval->nodeNr); }
+    if (z == 0) fprintf(job->out, "  Z1 (< %3d bpm):\t", to);
+    else if (z == HR_ZONES - 1) fprintf(job->out, "  Z%d (>= %3d bpm):\t", z + 1, from);
+    else fprintf(job->out, "  Z%d (%3d-%3d bpm):\t", z + 1, from, to);
 
-  // loop sulle tracce (nodi "trk")
-  xmlNodeSetPtr trackNodes = trackSegments->nodesetval;
+    fprintf(job->out, "%02d:%02d:%02d %5.1lf%% %s\n", time.tm_hour, time.tm_min, time.tm_sec,
+            (zoneTotal > 0) ? 100.0 * zoneTime[z] / zoneTotal : 0.0, bars);
+  }
+}
 
-  for (int n = 0; n < trackNodes->nodeNr; n++) {
+// analisi a finestre di un segmento: migliori prestazioni (le finestre più lunghe del segmento non compaiono), salite
+// migliori sulle distanze e parziali per Km (con la distanza progressiva alla fine di ciascuno)
+void printEfforts(const jobConfig *job, const segmentEfforts *e) {
 
-    // contenitore risultati in output
-    metrics results = {0};
-    
-    if (_DEBUG_) { printf("Segmento %d\n", n); }
+  char name[32];
+  int found = 0;
 
-    xmlNodePtr node = trackNodes->nodeTab[n];
+  for (int w = 0; w < job->numEfforts; w++) {
+    const effortResult *r = &(e->best[w]);
+    if (!r->found) continue;
 
-    // Se non è un nodo XML (XML_ELEMENT_NODE è un elemento dell'enum xmlElementType), si passa al prossimo
-    if(trackNodes->nodeTab[n]->type != XML_ELEMENT_NODE) continue;
+    if (!found++) fprintf(job->out, "[ Migliori prestazioni ]\n\n");
 
-    // nell'ambito di questa traccia devo cercare i punti che la compongono; serve quindi creare un altro contesto per valutare 
-    // l'espressione XPath di ricerca
-    xmlXPathContextPtr trackContext = createXPathContext(xmlDoc, trackNodes->nodeTab[n]);
+    struct tm time = seconds2tm(r->time);
+    getEffortName(&(job->efforts[w]), name, sizeof(name));
 
-    // nome della traccia (si trova nel nodo "name")
-    getTrackName(xmlDoc, trackNodes->nodeTab[n], results.name);
+    if (job->efforts[w].type == EFFORT_DISTANCE) {
+      fprintf(job->out, "* %-12s    %02d:%02d:%02d  %7.2lf Km/h  dal Km %7.2lf\n", name, time.tm_hour, time.tm_min, time.tm_sec, getAvgSpeed(r->distance, r->time), r->startDistance / 1000.0);
+    } else {
+      fprintf(job->out, "* %-12s %8.2lf Km  %7.2lf Km/h  dal Km %7.2lf\n", name, r->distance / 1000.0, getAvgSpeed(r->distance, r->time), r->startDistance / 1000.0);
+    }
+  }
 
-    // recupero dei punti della traccia
-    xmlXPathObjectPtr points = getPoints(trackContext);
+  if (found) fprintf(job->out, "\n");
+  found = 0;
 
-    int numPoints = points->nodesetval->nodeNr;
+  for (int w = 0; w < job->numEfforts; w++) {
+    const effortResult *r = &(e->climb[w]);
+    if (!r->found || r->gain <= 0) continue;
 
-    // Costruisco un array per contenere i dati di tutti i punti, in modo da non doverli più leggere da XML
-    gpxPoint *allPoints = malloc(sizeof(gpxPoint) * numPoints);
-    
-    for (int p = 0; p < numPoints; p++) {
-      allPoints[p] = getPointData(xmlDoc, points->nodesetval->nodeTab[p]);      
-    }
+    if (!found++) fprintf(job->out, "[ Salite migliori ]\n\n");
 
-    getResults(allPoints, numPoints, &results);
-    
-    // free
-    xmlXPathFreeObject(points);
-    xmlXPathFreeContext(trackContext);
-    
-    // stampa dei risultati finali
-    printResults(filename, &results);
+    getEffortName(&(job->efforts[w]), name, sizeof(name));
+    fprintf(job->out, "* %-12s %+9.1lf m  %7.1lf %%     dal Km %7.2lf\n", name, r->gain, 100.0 * r->gain / r->distance, r->startDistance / 1000.0);
+  }
 
-    // stampa grafico altimetrico
-    printAltiGraph(&results, allPoints, numPoints);
-  
-    free(allPoints);
-  } // for n
-  
-  // free
-  xmlFreeDoc(xmlDoc);
-  xmlCleanupParser();
+  if (found) fprintf(job->out, "\n");
 
-  return 0;
-}
+  if (e->numSplits > 1) {
+    fprintf(job->out, "[ Parziali per Km ]\n\n");
+    fprintf(job->out, "      Km     Tempo     Km/h  Dislivello (m)\n");
 
-// dato un array di punti, calcola le metriche da inserire nei risultati finali
-void getResults(gpxPoint *pointSet, int size, metrics *r) {  
+    double distance = 0.0;
 
-  // variabili di comodo
-  gpxPoint currPoint = {0};
-  gpxPoint prevPoint = {0};
+    for (int i = 0; i < e->numSplits; i++) {
+      const effortSplit *split = &(e->splits[i]);
+      struct tm time = seconds2tm(split->time);
+      distance += split->distance;
+      fprintf(job->out, "  %6.2lf  %02d:%02d:%02d  %7.2lf  %+8.1lf\n", distance / 1000.0, time.tm_hour, time.tm_min, time.tm_sec, getAvgSpeed(split->distance, split->time), split->elevation);
+    }
 
-  // loop sull'array dei punti
-  for (int p = 0; p < size; p++) {
-    
-    // struct con i dati del punto corrente
-    currPoint = pointSet[p];
+    fprintf(job->out, "\n");
+  }
+}
 
-    if (_DEBUG_) { printPoint(&currPoint, p); }
+// stampa i totali di una traccia composta da più segmenti
+void printTrackTotal(const jobConfig *job, const char *filename, const metrics *r, int track, int numSegments) {
 
-    // se siamo al primo elemento, il punto "precedente" è il punto stesso;
-    if (p == 0) {
-      prevPoint = currPoint;
+  STATS_BEGIN(outputTimer, STAT_OUTPUT);
 
-      // impostazione di minima e massima altezza a partire dal primo punto, così si ha un termine di paragone
-      r->minElevation = currPoint.elevation;
-      r->maxElevation = currPoint.elevation;
-    }
+  if (job->format != FORMAT_TEXT) {
+    writeRecord(job, filename, RECORD_TRACK, r, track, numSegments, NULL, NULL);
+  }
+  else {
+    fprintf(job->out, "[ Totale traccia: %d segmenti ]\n", numSegments);
+    printResults(job, filename, r);
+  }
 
-    // ascesa (o discesa)
-    double ascent = getAscent(&currPoint, &prevPoint);
+  STATS_END(outputTimer, 0);
+}
 
-    // dislivello positivo (salita) o negativo (discesa)
-    (ascent > 0) ? (r->ascent += ascent) : (r->descent += fabs(ascent));
-    
-    // distanza dal punto precedente
-    r->distance += fabs(getDistance(prevPoint.lat, prevPoint.lon, currPoint.lat, currPoint.lon)); 
+// stampa risultati e grafici di un segmento (o il suo record JSON/CSV); i grafici e le serie sono ricavati dai punti
+// conservati nell'analisi o, in streaming, dal profilo altimetrico (solo il grafico altimetrico lungo la distanza)
+void printSegment(const jobConfig *job, const char *filename, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationProfile *profile) {
 
-    // tempo rispetto al punto precedente
-    r->totalTime += difftime(mktime(&(currPoint.time)), mktime(&(prevPoint.time)));
+  STATS_BEGIN(outputTimer, STAT_OUTPUT);
 
-    // quota minima/massima
-    if (currPoint.elevation < r->minElevation) {
-      r->minElevation = currPoint.elevation;
+  if (job->format != FORMAT_TEXT) {
+    writeRecord(job, filename, RECORD_SEGMENT, r, track, segment, analysis, profile);
+  }
+  else {
+    printResults(job, filename, r);
+
+    if (analysis != NULL && job->numEfforts > 0) {
+      segmentEfforts efforts;
+      getSegmentEfforts(job, analysis, &efforts);
+      printEfforts(job, &efforts);
+      freeSegmentEfforts(&efforts);
     }
 
-    if (currPoint.elevation > r->maxElevation) {
-      r->maxElevation = currPoint.elevation;
+    if (analysis != NULL) {
+      printTrackCharts(job, r, analysis);
     }
+    else if ((job->charts & SERIES_ELEVATION) && job->chartAxis == AXIS_DISTANCE) {
+      printProfileAltiGraph(job, r, profile);
+    }
+  }
 
-    // il punto appena elaborato diventa il "punto precedente"
-    prevPoint = currPoint;
-  
-  } // for p
+  STATS_END(outputTimer, r->numPoints);
+}
 
-  // Calcolo della velocità media
-  r->avgspeed = getAvgSpeed(r->distance, r->totalTime);
+// destinazione dei messaggi (errori, debug): con l'output JSON/CSV lo standard error, per non renderlo illeggibile
+FILE *getMessageStream(const jobConfig *job) {
+  if (job->format == FORMAT_TEXT) return job->out;
+  return (job->messages != NULL) ? job->messages : stderr;
 }
 
-// dato un array di punti traccia, e un'unità di distanza calcola la quota media per ciascuna unità
-void getAvgElevation(const gpxPoint *pointSet, int numPoints, const altigraphUnits *units, double *avgElevation, int avgElevationSize) {
+// con --near: punto del segmento più vicino alle coordinate richieste, sua distanza e distanza progressiva della
+// proiezione delle coordinate sulla traccia (solo nel formato testo)
+void printNearestPoint(const jobConfig *job, const gpxPoint *points, int numPoints, const trackAnalysis *analysis) {
+
+  if (job->format != FORMAT_TEXT || numPoints == 0) return;
 
-  // variabili di comodo
-  gpxPoint currPoint = {0};
-  gpxPoint prevPoint = {0};
+  // le distanze progressive sono quelle dei punti solo se l'analisi li ha tutti
+  const double *distance = (analysis != NULL && analysis->numPoints == numPoints) ? analysis->distance : NULL;
 
-  double distance = 0.0;
-  double cd = 0.0;
-  double elevation = 0.0;
+  spatialIndex index;
+  if (!buildSpatialIndex(&index, points, numPoints, distance)) {
+    fprintf(getMessageStream(job), "Memoria insufficiente per l'indice dei punti\n");
+    return;
+  }
 
-  // indice per aggiungere elementi ad avgElevation
-  int i = 0;
+  double pointDistance, offset;
+  int nearest = findNearestPoint(&index, job->nearLat, job->nearLon, &pointDistance);
+  double along = getDistanceAlongTrack(&index, job->nearLat, job->nearLon, &offset);
 
-  // contatore punti parziali (viene resettato ogni volta che si raggiunge l'unità di distanza)
-  int pc = 0;
+  fprintf(job->out, "[ Punto più vicino a %.6lf, %.6lf ]\n\n", job->nearLat, job->nearLon);
+  fprintf(job->out, "* Punto n.:\t\t\t%8d\n", nearest + 1);
+  fprintf(job->out, "* Coordinate:\t\t\t%.6lf, %.6lf\n", points[nearest].lat, points[nearest].lon);
+  fprintf(job->out, "* Distanza dal punto (m):\t%8.1lf\n", pointDistance);
 
-  // flag per stabilire se calcolare la quota media
-  int calcAvg = 0;
+  if (!isnan(along)) {
+    fprintf(job->out, "* Distanza lungo la traccia (Km):%8.3lf\n", along / 1000.0);
+    fprintf(job->out, "* Distanza dalla traccia (m):\t%8.1lf\n", offset);
+  }
 
-  // loop sull'array dei punti
-  for (int p = 0; p < numPoints; p++, pc++) {
+  fprintf(job->out, "\n");
+  freeSpatialIndex(&index);
+}
 
-    // struct con i dati del punto corrente
-    currPoint = pointSet[p];
+// indice spaziale dei punti di un segmento (le distanze progressive, se non sono NULL, devono restare valide)
+int buildSpatialIndex(spatialIndex *index, const gpxPoint *points, int numPoints, const double *distance) {
 
-    // se siamo al primo elemento, il punto "precedente" è il punto stesso;
-    if (p == 0) {
-      prevPoint = currPoint;
+  double *lat = malloc(sizeof(double) * (numPoints + 1));
+  double *lon = malloc(sizeof(double) * (numPoints + 1));
+  int ret = 0;
+
+  if (lat != NULL && lon != NULL) {
+    for (int i = 0; i < numPoints; i++) {
+      lat[i] = points[i].lat;
+      lon[i] = points[i].lon;
     }
+    ret = initSpatialIndex(index, lat, lon, distance, numPoints);
+  }
+
+  free(lat);
+  free(lon);
+  return ret;
+}
 
-    // distanza dal punto precedente (in km)
-    distance += fabs(getDistance(prevPoint.lat, prevPoint.lon, currPoint.lat, currPoint.lon));
+// inizio dell'output JSON/CSV: apertura dell'array JSON o intestazione delle colonne CSV
+void printOutputBegin(const jobConfig *job, FILE *out) {
 
-    // calcolo della quota media se ho superato l'unità di distanza, oppure sono all'ultimo punto
-    calcAvg = (distance < units->distance && (p < numPoints-1)) ? 0 : 1;
+  if (job->format == FORMAT_JSON) {
+    fputs("[\n", out);
+  }
+  else if (job->format == FORMAT_CSV) {
+    fputs("record,file,track,track_index,segment,segments,points,distance_m,time_s,avg_speed_kmh,ascent_m,descent_m,"
+          "max_elevation_m,min_elevation_m,hr_avg_bpm,hr_max_bpm,cadence_avg_rpm,power_avg_w,power_max_w,temp_min_c,temp_max_c,"
+          "hr_z1_s,hr_z2_s,hr_z3_s,hr_z4_s,hr_z5_s,index,elevation_m,hr_bpm\n", out);
+  }
+}
+
+// fine dell'output JSON/CSV: chiusura dell'array JSON
+void printOutputEnd(const jobConfig *job, FILE *out) {
+  if (job->format == FORMAT_JSON) fputs("\n]\n", out);
+}
 
-    elevation += currPoint.elevation;
+// record JSON/CSV di un segmento o del totale di una traccia (per il quale "segment" è il numero di segmenti).
+// Il record è composto nel buffer del thread e scritto con una sola fwrite(); con --series vi si aggiungono il profilo
+// altimetrico (una quota per colonna, come nel grafico) e, se i punti sono stati conservati, le loro serie
+void writeRecord(const jobConfig *job, const char *filename, recordType type, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationProfile *profile) {
 
-    if (calcAvg) {
-      
-      if (_DEBUG_) { printf("Punto: %d, Distanza: %lf, Unita di distanza %d, quota media %lf; ", p, distance, i, elevation/pc); }
+  textBuffer *b = &_RECORD_BUFFER_;
+  if (b->data == NULL) initTextBuffer(b, 4096);
 
-      avgElevation[i++] = elevation / (double)pc;
-      
-      // reset contando anche eventuali "sforamenti" rispetto all'unità di distanza
-      distance -= units->distance;
+  // profilo altimetrico, ricavato come per il grafico (modalità di --downsample)
+  elevationSeries series;
+  altigraphUnits units = { 0 };
+  int hasProfile = (job->exportSeries && type == RECORD_SEGMENT && r->numPoints > 0 && (analysis != NULL || profile != NULL));
 
-      if (_DEBUG_) { printf("Scarto accumulato %lf\n\n ", distance); }
+  if (hasProfile) {
+    getAltiGraphUnits(job, r, &units);
+    initElevationSeries(&series, job);
 
-      // reset contatori
-      pc = 0;
-      elevation = 0;
+    if (analysis != NULL) {
+      getElevationSeries(job, analysis, &units, &series);
+    } else {
+      getProfileElevationSeries(job, profile, &units, &series);
     }
+  }
 
-    prevPoint = currPoint;
+  const trackAnalysis *points = (job->exportSeries && type == RECORD_SEGMENT) ? analysis : NULL;
 
-  } // for p
-  
-  // stampo l'array avgElevation
-  if (_DEBUG_) { for (int j = 0; j < avgElevationSize; j++) { printf("\navgElevation[%d]: %lf", j, avgElevation[j]); } }
+  // analisi a finestre (non nel CSV, che ha una riga per record)
+  segmentEfforts efforts;
+  int hasEfforts = (job->format != FORMAT_CSV && type == RECORD_SEGMENT && analysis != NULL && job->numEfforts > 0);
+  if (hasEfforts) getSegmentEfforts(job, analysis, &efforts);
 
-}
+  if (job->format == FORMAT_CSV) {
+    appendCsvRecord(b, filename, type, r, track, segment, points, hasProfile ? &series : NULL, units.distance);
+  }
+  else {
+    if (job->format == FORMAT_JSON && _FILE_RECORDS_ > 0) appendText(b, ",\n", 2);
 
-// Verifica se esiste il file passato in ingresso
-// il qualificatore "const" impedisce la modifica della variabile passata per reference nell'argomento della funzione
-int fileExists(const char *filename) {
-  FILE *fp = fopen(filename, "r");
-  if (fp!=NULL) {
-    fclose(fp);
+    appendJsonRecord(b, job, filename, type, r, track, segment, points, hasProfile ? &series : NULL, units.distance, hasEfforts ? &efforts : NULL);
+
+    if (job->format == FORMAT_NDJSON) appendChar(b, '\n');
   }
-  return (fp!=NULL);
-}
 
-// funzione di utilità: crea un contesto nell'ambito del documento XML nel quale sarà valutata una certa espressione XPath
-// a partire da un certo nodo
-xmlXPathContextPtr createXPathContext(xmlDocPtr doc, xmlNodePtr node) {
-  xmlXPathContextPtr ctx = xmlXPathNewContext(doc);
-  // namespace per identificare il contenuto come GPX
-  xmlXPathRegisterNs(ctx, (xmlChar*)"gpx", (xmlChar*) GPX_NAMESPACE_STR);
-  ctx->node = node;
-  return ctx;
-}
+  flushTextBuffer(b, job->out);
+  _FILE_RECORDS_++;
 
-// recupero delle tracce/segmenti dal document
-xmlXPathObjectPtr getTrackSegments(const xmlXPathContextPtr ctx) {
-  return xmlXPathEvalExpression((xmlChar*)"//gpx:trk/gpx:trkseg", ctx);  
+  if (hasProfile) freeElevationSeries(&series);
+  if (hasEfforts) freeSegmentEfforts(&efforts);
 }
 
-// recupero dei punti di una traccia
-xmlXPathObjectPtr getPoints(const xmlXPathContextPtr ctx) {
-  return xmlXPathEvalExpression((xmlChar*)"//gpx:trkpt", ctx);  
-}
+// oggetto JSON di un record (su una sola riga): i sensori compaiono solo se presenti, i valori non definiti sono null
+void appendJsonRecord(textBuffer *b, const jobConfig *job, const char *filename, recordType type, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationSeries *profile, double profileStep, const segmentEfforts *efforts) {
+
+  const sensorMetrics *m = &(r->sensors);
+
+  appendString(b, (type == RECORD_SEGMENT) ? "{\"type\":\"segment\"" : "{\"type\":\"track\"");
+  appendJsonField(b, "file");
+  appendJsonString(b, filename);
+  appendJsonField(b, "track");
+  appendJsonString(b, r->name);
+  appendJsonField(b, "track_index");
+  appendInt(b, track);
+  appendJsonField(b, (type == RECORD_SEGMENT) ? "segment" : "segments");
+  appendInt(b, segment);
+  appendJsonField(b, "points");
+  appendInt(b, r->numPoints);
+  appendJsonField(b, "distance_m");
+  appendJsonNumber(b, r->distance);
+  appendJsonField(b, "time_s");
+  appendJsonNumber(b, r->totalTime);
+  appendJsonField(b, "avg_speed_kmh");
+  appendJsonNumber(b, r->avgspeed);
+  appendJsonField(b, "ascent_m");
+  appendJsonNumber(b, r->ascent);
+  appendJsonField(b, "descent_m");
+  appendJsonNumber(b, r->descent);
+  appendJsonField(b, "max_elevation_m");
+  appendJsonNumber(b, r->maxElevation);
+  appendJsonField(b, "min_elevation_m");
+  appendJsonNumber(b, r->minElevation);
+
+  if (m->count[CHANNEL_HR] > 0) {
+    appendJsonField(b, "hr_avg_bpm");
+    appendJsonNumber(b, getSensorAverage(m, CHANNEL_HR));
+    appendJsonField(b, "hr_max_bpm");
+    appendJsonNumber(b, m->max[CHANNEL_HR]);
+
+    double zones[HR_ZONES];
+    for (int z = 0; z < HR_ZONES; z++) zones[z] = m->hrZoneTime[z] / 1000.0;
+    appendJsonArray(b, "hr_zones_s", zones, HR_ZONES);
+  }
 
-// restituisce il nome della traccia, dal nodo "name"
-void getTrackName(const xmlDocPtr doc, const xmlNodePtr node, char *trackName) {
-  xmlXPathContextPtr trackContext = createXPathContext(doc, node);
-  xmlXPathObjectPtr name = xmlXPathEvalExpression((xmlChar*)"//gpx:name/text()", trackContext);
-  
-  strcpy(trackName, "Senza nome");
-  if (name->nodesetval) {
-    strcpy(trackName, name->nodesetval->nodeTab[0]->content);
+  if (m->count[CHANNEL_CAD] > 0) {
+    appendJsonField(b, "cadence_avg_rpm");
+    appendJsonNumber(b, getSensorAverage(m, CHANNEL_CAD));
   }
 
-  xmlXPathFreeObject(name);
-  xmlXPathFreeContext(trackContext);
+  if (m->count[CHANNEL_POWER] > 0) {
+    appendJsonField(b, "power_avg_w");
+    appendJsonNumber(b, getSensorAverage(m, CHANNEL_POWER));
+    appendJsonField(b, "power_max_w");
+    appendJsonNumber(b, m->max[CHANNEL_POWER]);
+  }
+
+  if (m->count[CHANNEL_ATEMP] > 0) {
+    appendJsonField(b, "temp_min_c");
+    appendJsonNumber(b, m->min[CHANNEL_ATEMP]);
+    appendJsonField(b, "temp_max_c");
+    appendJsonNumber(b, m->max[CHANNEL_ATEMP]);
+  }
+
+  // profilo: passo delle colonne e quota di ciascuna (con M4 la massima, e la minima in "min_elevation_m")
+  if (profile != NULL) {
+    appendJsonField(b, "profile");
+    appendString(b, "{\"step_m\":");
+    appendJsonNumber(b, profileStep);
+    appendJsonArray(b, "elevation_m", profile->elevation, profile->cols);
+    if (profile->low != NULL) appendJsonArray(b, "min_elevation_m", profile->low, profile->cols);
+    appendChar(b, '}');
+  }
+
+  if (efforts != NULL) appendJsonEfforts(b, job, efforts);
+
+  // serie dei punti, per colonne: distanza progressiva, tempo dal primo punto, quota e (se rilevata) frequenza cardiaca
+  if (analysis != NULL) {
+    int n = analysis->numPoints;
+
+    appendJsonField(b, "series");
+    appendString(b, "{\"distance_m\":");
+    appendJsonValues(b, analysis->distance, n);
+
+    appendString(b, ",\"time_s\":[");
+    for (int i = 0; i < n; i++) {
+      if (i > 0) appendChar(b, ',');
+      appendJsonNumber(b, (analysis->time[i] - analysis->time[0]) / 1000.0);
+    }
+    appendChar(b, ']');
+
+    appendJsonArray(b, "elevation_m", analysis->elevation, n);
+    if (m->count[CHANNEL_HR] > 0) appendJsonArray(b, "hr_bpm", analysis->heartRate, n);
+    appendChar(b, '}');
+  }
+
+  appendChar(b, '}');
 }
 
-// converte i dati di un nodo XML "trkpt" in una struct più facilmente manipolabile
-gpxPoint getPointData(const xmlDocPtr doc, const xmlNodePtr pointNode) {
-  gpxPoint gp;
-  char *end;
-  struct tm time;
-    
-  // quota del punto: nel campo "ele"
-  xmlXPathContextPtr eleContext = createXPathContext(doc, pointNode);
-  xmlXPathObjectPtr elevation = xmlXPathEvalExpression((xmlChar*)"gpx:ele/text()", eleContext);
+// campi JSON dell'analisi a finestre: "efforts" ha un oggetto per finestra, nell'ordine di --efforts, con la distanza
+// ("distance_m") o la durata ("duration_s") richiesta; "climbs" uno per finestra di distanza; i valori delle finestre
+// più lunghe del segmento sono null
+void appendJsonEfforts(textBuffer *b, const jobConfig *job, const segmentEfforts *e) {
+
+  appendJsonField(b, "efforts");
+  appendChar(b, '[');
+
+  for (int w = 0; w < job->numEfforts; w++) {
+    const effortResult *r = &(e->best[w]);
+
+    if (w > 0) appendChar(b, ',');
+
+    if (job->efforts[w].type == EFFORT_DISTANCE) {
+      appendString(b, "{\"distance_m\":");
+      appendJsonNumber(b, job->efforts[w].length);
+      appendJsonField(b, "time_s");
+      appendJsonNumber(b, r->found ? r->time : NAN);
+    } else {
+      appendString(b, "{\"duration_s\":");
+      appendJsonNumber(b, job->efforts[w].length);
+      appendJsonField(b, "distance_m");
+      appendJsonNumber(b, r->found ? r->distance : NAN);
+    }
+
+    appendJsonField(b, "speed_kmh");
+    appendJsonNumber(b, r->found ? getAvgSpeed(r->distance, r->time) : NAN);
+    appendJsonField(b, "start_m");
+    appendJsonNumber(b, r->found ? r->startDistance : NAN);
+    appendChar(b, '}');
+  }
 
-  gp.elevation = strtod(elevation->nodesetval->nodeTab[0]->content, &end);
+  appendChar(b, ']');
+  appendJsonField(b, "climbs");
+  appendChar(b, '[');
 
-  // free
-  if (elevation) xmlXPathFreeObject(elevation);
-  xmlXPathFreeContext(eleContext);
+  int first = 1;
 
-  // latitudine/longitudine: negli attributi "lat" e "lon" del trkpt
-  if (xmlHasProp(pointNode, (xmlChar*)"lat") && xmlHasProp(pointNode, (xmlChar*)"lon")) {
-    xmlChar *lat = xmlGetProp(pointNode, (xmlChar*)"lat");
-    gp.lat = strtod((char*)lat, &end);
+  for (int w = 0; w < job->numEfforts; w++) {
+    const effortResult *r = &(e->climb[w]);
+    if (job->efforts[w].type != EFFORT_DISTANCE) continue;
 
-    xmlChar *lon = xmlGetProp(pointNode, (xmlChar*)"lon");
-    gp.lon = strtod((char*)lon, &end);
+    if (!first) appendChar(b, ',');
+    first = 0;
+
+    appendString(b, "{\"distance_m\":");
+    appendJsonNumber(b, job->efforts[w].length);
+    appendJsonField(b, "gain_m");
+    appendJsonNumber(b, r->found ? r->gain : NAN);
+    appendJsonField(b, "start_m");
+    appendJsonNumber(b, r->found ? r->startDistance : NAN);
+    appendChar(b, '}');
   }
 
-  // tempo: nel campo "time"
-  xmlXPathContextPtr timeContext = createXPathContext(doc, pointNode);
-  xmlXPathObjectPtr timeResult = xmlXPathEvalExpression((xmlChar*)"gpx:time/text()", timeContext);
+  appendChar(b, ']');
 
-  // inizializza a zero tutta la chiave "time", altrimenti si possono verificare errori di "segmentation fault (core dumped)"
-  memset(&(gp.time), 0, sizeof(struct tm));
-  strptime((char*)timeResult->nodesetval->nodeTab[0]->content, "%Y-%m-%dT%H:%M:%SZ", &(gp.time));
+  // parziali per Km, per colonne come le serie dei punti
+  appendJsonField(b, "splits");
+  appendChar(b, '{');
 
-  // free
-  if (timeResult) xmlXPathFreeObject(timeResult);
-  xmlXPathFreeContext(timeContext);
+  for (int c = 0; c < 3; c++) {
+    static const char *names[] = { "\"distance_m\":[", ",\"time_s\":[", ",\"elevation_m\":[" };
+    appendString(b, names[c]);
 
-  return gp;
-}
+    for (int i = 0; i < e->numSplits; i++) {
+      const effortSplit *split = &(e->splits[i]);
+      if (i > 0) appendChar(b, ',');
+      appendJsonNumber(b, (c == 0) ? split->distance : (c == 1) ? split->time : split->elevation);
+    }
 
-// dislivello tra due punti
-double getAscent(const gpxPoint *p1, const gpxPoint *p2) {
-  return (p1->elevation - p2->elevation);
+    appendChar(b, ']');
+  }
+
+  appendChar(b, '}');
 }
 
-// distanza tra due punti, applicando la formula dell'emisenoverso
-double getDistance(double lat1, double lon1, double lat2, double lon2) {
+// riga CSV di un record, seguita (con --series) dalle righe del profilo ("profile") e dei punti ("point"), che usano
+// le colonne index, distance_m, time_s, elevation_m, min_elevation_m e hr_bpm; i valori non definiti restano vuoti
+void appendCsvRecord(textBuffer *b, const char *filename, recordType type, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationSeries *profile, double profileStep) {
+
+  const sensorMetrics *m = &(r->sensors);
+
+  appendString(b, (type == RECORD_SEGMENT) ? "segment," : "track,");
+  appendCsvString(b, filename);
+  appendChar(b, ',');
+  appendCsvString(b, r->name);
+  appendChar(b, ',');
+  appendInt(b, track);
+  appendChar(b, ',');
+  if (type == RECORD_SEGMENT) appendInt(b, segment);
+  appendChar(b, ',');
+  if (type == RECORD_TRACK) appendInt(b, segment);
+  appendChar(b, ',');
+  appendInt(b, r->numPoints);
+
+  double values[] = {
+    r->distance, r->totalTime, r->avgspeed, r->ascent, r->descent, r->maxElevation, r->minElevation,
+    getSensorAverage(m, CHANNEL_HR), (m->count[CHANNEL_HR] > 0) ? m->max[CHANNEL_HR] : NAN,
+    getSensorAverage(m, CHANNEL_CAD),
+    getSensorAverage(m, CHANNEL_POWER), (m->count[CHANNEL_POWER] > 0) ? m->max[CHANNEL_POWER] : NAN,
+    (m->count[CHANNEL_ATEMP] > 0) ? m->min[CHANNEL_ATEMP] : NAN, (m->count[CHANNEL_ATEMP] > 0) ? m->max[CHANNEL_ATEMP] : NAN
+  };
+
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    appendChar(b, ',');
+    appendCsvNumber(b, values[i]);
+  }
 
-  double latRad = (lat2 - lat1) * GRAD_TO_RAD;
-  double lonRad = (lon2 - lon1) * GRAD_TO_RAD;
+  for (int z = 0; z < HR_ZONES; z++) {
+    appendChar(b, ',');
+    appendCsvNumber(b, (m->count[CHANNEL_HR] > 0) ? m->hrZoneTime[z] / 1000.0 : NAN);
+  }
 
-  double lat1Rad = lat1 * GRAD_TO_RAD;
-  double lat2Rad = lat2 * GRAD_TO_RAD;
+  appendString(b, ",,,\n");
+
+  // prefisso comune delle righe delle serie: record, file, traccia, indici (le colonne delle metriche restano vuote)
+  for (int pass = 0; pass < 2; pass++) {
+    int n = (pass == 0) ? ((profile != NULL) ? profile->cols : 0) : ((analysis != NULL) ? analysis->numPoints : 0);
+
+    for (int i = 0; i < n; i++) {
+      appendString(b, (pass == 0) ? "profile," : "point,");
+      appendCsvString(b, filename);
+      appendChar(b, ',');
+      appendCsvString(b, r->name);
+      appendChar(b, ',');
+      appendInt(b, track);
+      appendChar(b, ',');
+      appendInt(b, segment);
+      appendString(b, ",,,");
+
+      if (pass == 0) {
+        // distance_m: inizio della colonna; min_elevation_m: con M4, la quota minima della colonna
+        appendCsvNumber(b, i * profileStep);
+        appendString(b, ",,,,,,");
+        appendCsvNumber(b, (profile->low != NULL) ? profile->low[i] : NAN);
+        appendString(b, ",,,,,,,,,,,,,");
+        appendInt(b, i);
+        appendChar(b, ',');
+        appendCsvNumber(b, profile->elevation[i]);
+        appendString(b, ",\n");
+      }
+      else {
+        appendCsvNumber(b, analysis->distance[i]);
+        appendChar(b, ',');
+        appendCsvNumber(b, (analysis->time[i] - analysis->time[0]) / 1000.0);
+        appendString(b, ",,,,,,,,,,,,,,,,,,");
+        appendInt(b, i);
+        appendChar(b, ',');
+        appendCsvNumber(b, analysis->elevation[i]);
+        appendChar(b, ',');
+        appendCsvNumber(b, analysis->heartRate[i]);
+        appendChar(b, '\n');
+      }
+    }
+  }
+}
 
-  double a = pow(sin(latRad / 2), 2.0) + pow(sin(lonRad / 2), 2.0) * cos(lat1Rad) * cos(lat2Rad);
-  double c = 2 * asin(sqrt(a));
+// nome di un campo JSON, preceduto dalla virgola che lo separa dal campo precedente
+void appendJsonField(textBuffer *b, const char *name) {
+  appendText(b, ",\"", 2);
+  appendString(b, name);
+  appendText(b, "\":", 2);
+}
 
-  return EARTH_RADIUS * c;
+// numero JSON: NaN e infiniti (ad es. la velocità media di un segmento senza tempo) diventano null
+void appendJsonNumber(textBuffer *b, double value) {
+  if (isfinite(value)) appendDouble(b, value);
+  else appendText(b, "null", 4);
 }
 
-// crea una struct tm a partire da un numero di secondi
-struct tm seconds2tm(double timeInSeconds) {
-  unsigned int hours = (int) (timeInSeconds / 3600.0);
-  int minutes = (int) ((timeInSeconds - (3600 * hours)) / 60.0);
-  int seconds = (int) (timeInSeconds - (3600 * hours) - (60 * minutes));
+// array JSON di numeri
+void appendJsonValues(textBuffer *b, const double *values, int size) {
 
-  struct tm result = {0};
+  appendChar(b, '[');
 
-  result.tm_sec = seconds;
-  result.tm_min = minutes;
-  result.tm_hour = hours;
+  for (int i = 0; i < size; i++) {
+    if (i > 0) appendChar(b, ',');
+    appendJsonNumber(b, values[i]);
+  }
 
-  return result;
+  appendChar(b, ']');
 }
 
-// calcola la velocità media in Km/h data una distanza in Km ed un tempo in secondi
-double getAvgSpeed(double distance, double timeInSeconds) {
-  return ((distance / timeInSeconds) * 3.6);
+// campo JSON con un array di numeri
+void appendJsonArray(textBuffer *b, const char *name, const double *values, int size) {
+  appendJsonField(b, name);
+  appendJsonValues(b, values, size);
 }
 
-// stampa una struct gpxPoint
-void printPoint(const gpxPoint *p, int pointNumber) {
-  
-  char formattedTime[80];
-  strftime(formattedTime, sizeof(formattedTime), "%Y-%m-%d %H:%M:%s", &(p->time));
-  printf("Punto %d\tquota: %.2lf\t%.2f\t%.2f\t%s\n", pointNumber, p->elevation, p->lat, p->lon, formattedTime);
+// numero CSV: NaN e infiniti lasciano il campo vuoto
+void appendCsvNumber(textBuffer *b, double value) {
+  if (isfinite(value)) appendDouble(b, value);
 }
 
-// stampa risultati
-void printResults(const char *filename, const metrics *r) {
+// media di un canale dei sensori (NAN se il canale non è presente)
+double getSensorAverage(const sensorMetrics *m, int channel) {
+  return (m->count[channel] > 0) ? m->sum[channel] / m->count[channel] : NAN;
+}
 
-  // si fa qui solo per esigenze di formattazione (in result infatti ci sono solo dati "grezzi", non formattati)
-  struct tm totalTime = seconds2tm((r->totalTime));
-  printf("[ Elaborazione file <%s> ]\n\n", filename);
-
-  printf("[ Traccia <%s> ]\n\n", r->name);
-  printf("* Distanza (Km):\t\t%8.2lf\n", r->distance / 1000.0);
-  printf("* Tempo impiegato (h:m:s):\t%02d:%02d:%02d\n", totalTime.tm_hour, totalTime.tm_min, totalTime.tm_sec);
-  printf("* Velocità media (Km/h):\t%8.2lf\n\n", r->avgspeed);
-  printf("* Dislivello in salita (m):\t%8.2lf\n", r->ascent);
-  printf("* Dislivello in discesa (m):\t%8.2lf\n\n", r->descent);
-  printf("* Quota massima (m):\t\t%8.2lf\n", r->maxElevation);
-  printf("* Quota minima (m):\t\t%8.2lf\n", r->minElevation);
-  printf("\n");
-  
+// libera il buffer dei record del thread
+void releaseRecordBuffer(void) {
+  if (_RECORD_BUFFER_.data != NULL) freeTextBuffer(&_RECORD_BUFFER_);
 }
 
 // grafico altimetrico ascii usando una matrice con caratteri di riempimento
 // l'idea è per ogni "unità di distanza" calcolare l'altezza media, 
 // e riempire tanti quadretti in altezza quante sono le "unità di altezza" dell'altezza media
-void printAltiGraph(const metrics *r, const gpxPoint *pointSet, int numPoints) {
-  
-  // dimensioni della matrice
-  int cols = _ALTIGRAPH_SIZE_.cols;
-  int rows = _ALTIGRAPH_SIZE_.rows;
+void printAltiGraph(const jobConfig *job, const metrics *r, const trackAnalysis *analysis) {
+
+  altigraphUnits units;
+  getAltiGraphUnits(job, r, &units);
+
+  elevationSeries series;
+  initElevationSeries(&series, job);
+  getElevationSeries(job, analysis, &units, &series);
+
+  drawAltiGraph(job, r, &units, &series);
+  freeElevationSeries(&series);
+}
 
-  // matrice r * c
-  char matrix[rows][cols];
+// grafico altimetrico a partire dal profilo accumulato in streaming (i punti non sono più disponibili)
+void printProfileAltiGraph(const jobConfig *job, const metrics *r, const elevationProfile *profile) {
 
   altigraphUnits units;
+  getAltiGraphUnits(job, r, &units);
+
+  elevationSeries series;
+  initElevationSeries(&series, job);
+  getProfileElevationSeries(job, profile, &units, &series);
+
+  drawAltiGraph(job, r, &units, &series);
+  freeElevationSeries(&series);
+}
+
+// unità di distanza e di altezza di ogni cella del grafico
+void getAltiGraphUnits(const jobConfig *job, const metrics *r, altigraphUnits *units) {
 
   // ogni cella, a quanti m di quota corrisponde? (quota max - min): quota max = 40 : x => delta * 40/quota max
-  units.height = (r->maxElevation - r->minElevation) / (double)rows;
+  units->height = (r->maxElevation - r->minElevation) / (double)job->altigraphSize.rows;
   // ogni cella, a quanti m di distanza corrisponde? (distanza totale in m/ scala)
-  units.distance = (r->distance) / (double)cols;
+  units->distance = (r->distance) / (double)job->altigraphSize.cols;
 
-  if (_DEBUG_) { printf ("Distance Unit (m): %lf Height unit (m): %lf\n", units.distance, units.height); }
+  if (job->debug) { fprintf(getMessageStream(job), "Distance Unit (m): %lf Height unit (m): %lf\n", units->distance, units->height); }
+}
+
+// stampa del grafico altimetrico, date le quote di ogni unità di distanza
+void drawAltiGraph(const jobConfig *job, const metrics *r, const altigraphUnits *units, const elevationSeries *series) {
 
-  double avgElevation[cols];
-  getAvgElevation(pointSet, numPoints, &units, avgElevation, cols);
+  chart c;
+  initChart(&c, "Grafico altimetrico", "Altezza (m)", "Distanza (Km)", job->altigraphSize.rows, job->altigraphSize.cols);
 
-  fillAltiGraphMatrix(rows, cols, matrix, &units, avgElevation, r->minElevation);
+  c.yMin = r->minElevation;
+  c.yMax = r->maxElevation;
+  c.xUnit = units->distance;
+  c.xLabelScale = 1000.0;
 
-  printAltiGraphMatrix(rows, cols, matrix, r, &units);
+  double *lowMarks = malloc(sizeof(double) * series->cols);
+  addElevationChartSeries(&c, series, lowMarks);
+  printChart(job->out, &c);
+  free(lowMarks);
 }
 
-// riempie la matrice inserendo un numero appropriato di caratteri di riempimento a seconda della quota media di ogni unità di distanza
-void fillAltiGraphMatrix(int rows, int cols, char matrix[rows][cols], const altigraphUnits *units, const double *avgElevation, int minElevation) {
-  
-  int numFillChars[cols];
+// aggiunge al grafico le quote delle colonne (area piena); con l'inviluppo M4 la quota minima di una colonna è segnata
+// con ALTIGRAPH_LOW_CHAR, se cade in una cella più bassa della massima. "lowMarks" è lo spazio (cols valori) per questa serie
+void addElevationChartSeries(chart *c, const elevationSeries *series, double *lowMarks) {
+
+  addChartSeries(c, series->elevation, ALTIGRAPH_FILL_CHAR, CHART_AREA);
 
-  // calcolo di quanti caratteri di riempimento per ciascuna colonna (dipendono dalla quota media); si arrotonda all'intero superiore
-  for (int i = 0; i < cols; i++) {
-    numFillChars[i] = ceil((avgElevation[i] - minElevation) / units->height);    
+  if (series->low == NULL || lowMarks == NULL) return;
+
+  for (int col = 0; col < series->cols; col++) {
+    int low = getChartHeight(c, series->low[col]);
+    lowMarks[col] = (low > 0 && low < getChartHeight(c, series->elevation[col])) ? series->low[col] : NAN;
   }
 
-  // loop sulle righe (a partire dall'ultima)
-  for (int r = 0; r < rows; r++) {
-    for (int c = 0; c < cols; c++) {
-      matrix[r][c]=' ';
-      if (r >= rows - numFillChars[c]) {
-        matrix[r][c] = ALTIGRAPH_FILL_CHAR;
-      }
-    } // for c   
-  } // for r
+  addChartSeries(c, lowMarks, ALTIGRAPH_LOW_CHAR, CHART_LINE);
+}
 
+// prepara lo spazio per le quote di tutte le colonne del grafico
+void initElevationSeries(elevationSeries *series, const jobConfig *job) {
+  series->cols = job->altigraphSize.cols;
+  series->elevation = malloc(sizeof(double) * series->cols);
+  series->low = (job->downsample == DOWNSAMPLE_M4) ? malloc(sizeof(double) * series->cols) : NULL;
 }
 
-// stampa il grafico altimetrico della traccia
-void printAltiGraphMatrix(int rows, int cols, const char matrix[rows][cols], const metrics *results, const altigraphUnits *units) {
-      
-  // specifica ogni quante colonne stampare il valore della distanza progressiva
-  int xLabelSpacing = 5;
-  
-  // quanti caratteri occupa (al massimo) un'etichetta dell'asse y (le quote) ? 4 per i numeri + le quadre che li contengono + lo spazio che stacca le etichette delle altezze dalla prima colonna
-  int yLabelLength = 7;
+// quote delle colonne a partire dai punti conservati nell'analisi; con la media si usano le somme progressive delle quote
+void getElevationSeries(const jobConfig *job, const trackAnalysis *analysis, const altigraphUnits *units, elevationSeries *series) {
+
+  STATS_BEGIN(profileTimer, STAT_PROFILE);
+
+  if (job->downsample == DOWNSAMPLE_AVG) {
+    getAvgElevation(job, analysis, units, series->elevation, series->cols);
+  } else {
+    downsampleElevation(job, analysis->distance, analysis->elevation, NULL, NULL, analysis->numPoints, units->distance, series);
+  }
 
-  // qual è la posizione dell'inizio dell'ultima etichetta di distanza?
-  int xMax = (cols + xLabelSpacing - (cols % xLabelSpacing));
+  STATS_END(profileTimer, analysis->numPoints);
+}
 
-  // stringa di comodo (contiene [yLabelLength] spazi, utile per gli allineamenti nella stampa delle etichette dei valori dell'asse x )
-  char line[yLabelLength]; 
-  for (int i = 0; i < yLabelLength; i++) line[i] = ' ';
+// quote delle colonne a partire dal profilo accumulato in streaming: i contenitori non vuoti fanno da punti
+// (al centro del contenitore, con la quota media), con minimo e massimo per l'inviluppo M4
+void getProfileElevationSeries(const jobConfig *job, const elevationProfile *profile, const altigraphUnits *units, elevationSeries *series) {
 
-  // stampa titoli e grafico
-  printf("[ Grafico altimetrico %d x %d]\n\n", _ALTIGRAPH_SIZE_.cols, _ALTIGRAPH_SIZE_.rows);
-  printf("Altezza (m)\n");
+  // i "punti" di questa fase sono i contenitori del profilo
+  STATS_BEGIN(profileTimer, STAT_PROFILE);
 
-  // stampa dati per riga (etichette + valori)
-  for (int r = 0; r < rows; r++) {
+  if (job->downsample == DOWNSAMPLE_AVG) {
+    getProfileAvgElevation(job, profile, units, series->elevation, series->cols);
+    STATS_END(profileTimer, profile->numBins);
+    return;
+  }
 
-    // per ogni riga si stampa l'altitudine
-    printf("\n[%4.0lf] ", results->maxElevation - (r * units->height));
+  int numBins = profile->numBins;
+  double *x = malloc(sizeof(double) * (numBins + 1));
+  double *y = malloc(sizeof(double) * (numBins + 1));
+  double *low = malloc(sizeof(double) * (numBins + 1));
+  double *high = malloc(sizeof(double) * (numBins + 1));
+  int size = 0;
+
+  for (int b = 0; b < numBins; b++) {
+    if (profile->count[b] == 0) continue;
+
+    x[size] = (b + 0.5) * profile->binDistance;
+    y[size] = profile->elevation[b] / profile->count[b];
+    low[size] = profile->minElevation[b];
+    high[size] = profile->maxElevation[b];
+    size++;
+  }
 
-    for (int c = 0; c < cols; c++) {
-      printf("%c", matrix[r][c]);
-    } // for c
-  } // for r
+  downsampleElevation(job, x, y, low, high, size, units->distance, series);
 
-  printf("\n%s", line);
-  
-  // stampa barre per unità di distanza
-  for (int c = 0; c < xMax; c++) {
-    printf((c % xLabelSpacing == 0) ? "|" : " ");
+  free(x);
+  free(y);
+  free(low);
+  free(high);
+
+  STATS_END(profileTimer, numBins);
+}
+
+// riduzione dei punti (x, quota) alle colonne: inviluppo M4, LTTB o media. Costo lineare nei punti, memoria
+// aggiuntiva proporzionale alle sole colonne. "low" e "high" (opzionali) sono la quota minima e massima di ogni punto
+void downsampleElevation(const jobConfig *job, const double *x, const double *y, const double *low, const double *high, int size, double xUnit, elevationSeries *series) {
+
+  if (job->downsample == DOWNSAMPLE_M4) {
+    getChartEnvelope(x, y, low, high, size, xUnit, NULL, NULL, series->low, series->elevation, series->cols);
+  } else if (job->downsample == DOWNSAMPLE_LTTB) {
+    getChartLttb(x, y, size, xUnit, series->elevation, series->cols);
+  } else {
+    getChartColumns(x, y, NULL, size, xUnit, series->elevation, series->cols);
   }
-  
-  printf("\n%s", line);
-
-  // stampa distanze progressive
-  double xlabel = 0.0;
-  for (int c = 0; c < xMax; c++) {
-
-    if (c % xLabelSpacing == 0) {      
-      xlabel = (double)c * units->distance / 1000.0;
-      // printf con %-*.*: il "-" allinea a sinistra; gli *.* permettono di specificare tramite variabili la lunghezza massima e il numero di decimali
-      printf("%-*.*lf", xLabelSpacing, 1, xlabel);
-    } 
-   
-  }
-  // stampa legenda asse x
-  printf("\t Distanza (Km)\n");
-}
\ No newline at end of file
+
+  if (job->debug) { for (int j = 0; j < series->cols; j++) { fprintf(getMessageStream(job), "\nelevation[%d]: %lf", j, series->elevation[j]); } }
+}
+
+// libera le quote delle colonne
+void freeElevationSeries(elevationSeries *series) {
+  free(series->elevation);
+  free(series->low);
+}
+
+// grafici di un segmento richiesti con --chart: il grafico altimetrico lungo la distanza usa le somme progressive
+// delle quote, gli altri le serie ricavate punto per punto dall'analisi
+void printTrackCharts(const jobConfig *job, const metrics *r, const trackAnalysis *analysis) {
+
+  if (job->charts & SERIES_ELEVATION) {
+    if (job->chartAxis == AXIS_DISTANCE) {
+      printAltiGraph(job, r, analysis);
+    } else {
+      printSeriesChart(job, r, analysis, SERIES_ELEVATION);
+    }
+  }
+
+  if (job->charts & SERIES_SPEED) printSeriesChart(job, r, analysis, SERIES_SPEED);
+  if (job->charts & SERIES_HR) printSeriesChart(job, r, analysis, SERIES_HR);
+  if (job->charts & SERIES_GRADE) printSeriesChart(job, r, analysis, SERIES_GRADE);
+}
+
+// grafico di una serie lungo la distanza o il tempo. Il valore di ogni colonna è la media dei valori dei suoi punti:
+// la velocità è pesata con il tempo e la pendenza con la distanza di ciascun punto dal precedente, così una colonna
+// vale (distanza / tempo) o (dislivello / distanza) dell'intervallo che rappresenta
+void printSeriesChart(const jobConfig *job, const metrics *r, const trackAnalysis *analysis, int series) {
+
+  int n = analysis->numPoints;
+  int cols = job->altigraphSize.cols;
+
+  const char *title = "Grafico altimetrico";
+  const char *yLabel = "Altezza (m)";
+
+  if (series == SERIES_SPEED) { title = "Grafico velocità"; yLabel = "Velocità (Km/h)"; }
+  else if (series == SERIES_HR) { title = "Grafico frequenza cardiaca"; yLabel = "FC (bpm)"; }
+  else if (series == SERIES_GRADE) { title = "Grafico pendenza"; yLabel = "Pendenza (%)"; }
+
+  if (n == 0 || cols < 1) return;
+
+  double *x = malloc(sizeof(double) * n);
+  double *y = malloc(sizeof(double) * n);
+  double *weight = malloc(sizeof(double) * n);
+  double *columns = malloc(sizeof(double) * cols);
+  double xSpan = 0.0;
+
+  for (int i = 0; i < n; i++) {
+
+    x[i] = (job->chartAxis == AXIS_TIME) ? (analysis->time[i] - analysis->time[0]) / 1000.0 : analysis->distance[i];
+    if (x[i] > xSpan) xSpan = x[i];
+
+    double distance = (i > 0) ? analysis->distance[i] - analysis->distance[i - 1] : 0.0;
+    double seconds = (i > 0) ? (analysis->time[i] - analysis->time[i - 1]) / 1000.0 : 0.0;
+
+    y[i] = NAN;
+    weight[i] = 1.0;
+
+    if (series == SERIES_ELEVATION) {
+      y[i] = analysis->elevation[i];
+    }
+    else if (series == SERIES_HR) {
+      y[i] = analysis->heartRate[i];
+    }
+    else if (series == SERIES_SPEED && seconds > 0) {
+      y[i] = distance / seconds * 3.6;
+      weight[i] = seconds;
+    }
+    else if (series == SERIES_GRADE && distance > 0) {
+      y[i] = (analysis->elevation[i] - analysis->elevation[i - 1]) / distance * 100.0;
+      weight[i] = distance;
+    }
+  }
+
+  // la quota segue la riduzione scelta con --downsample, come nel grafico lungo la distanza
+  elevationSeries elevation;
+  initElevationSeries(&elevation, job);
+
+  if (series == SERIES_ELEVATION) {
+    downsampleElevation(job, x, y, NULL, NULL, n, xSpan / cols, &elevation);
+    memcpy(columns, elevation.elevation, sizeof(double) * cols);
+  } else {
+    getChartColumns(x, y, weight, n, xSpan / cols, columns, cols);
+  }
+
+  chart c;
+  initChart(&c, title, yLabel, (job->chartAxis == AXIS_TIME) ? "Tempo (min)" : "Distanza (Km)", job->altigraphSize.rows, cols);
+
+  c.xUnit = xSpan / cols;
+  c.xLabelScale = (job->chartAxis == AXIS_TIME) ? 60.0 : 1000.0;
+
+  if (series == SERIES_ELEVATION) {
+    c.yMin = r->minElevation;
+    c.yMax = r->maxElevation;
+  } else {
+    getChartRange(columns, cols, &(c.yMin), &(c.yMax));
+  }
+
+  fprintf(job->out, "\n");
+
+  if (isnan(c.yMin)) {
+    fprintf(job->out, "[ %s: nessun dato ]\n", title);
+  } else if (series == SERIES_ELEVATION) {
+    double *lowMarks = malloc(sizeof(double) * cols);
+    addElevationChartSeries(&c, &elevation, lowMarks);
+    printChart(job->out, &c);
+    free(lowMarks);
+  } else {
+    addChartSeries(&c, columns, ALTIGRAPH_FILL_CHAR, CHART_AREA);
+    printChart(job->out, &c);
+  }
+
+  freeElevationSeries(&elevation);
+  free(x);
+  free(y);
+  free(weight);
+  free(columns);
+}
+
+// secondi trascorsi da "start" (CLOCK_MONOTONIC)
+double getElapsedSeconds(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
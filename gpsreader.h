@@ -0,0 +1,766 @@
+// GPSReader: tipi, impostazioni e funzioni del lettore GPX comuni a tutti i moduli (cache, indice, server, benchmark)
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef GPSREADER_H
+#define GPSREADER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// istruzioni SIMD (SSE2/AVX2) per il calcolo vettoriale delle distanze
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+// strumentazione di --stats (timer e contatori delle fasi): si esclude dalla compilazione con -DNO_STATS
+#ifndef NO_STATS
+#define HAVE_STATS
+#endif
+
+// libxml2
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+#include <libxml/xmlreader.h>
+
+// moduli: grafici ASCII, buffer di testo dei record JSON/CSV, indice spaziale, analisi a finestre
+#include "chart.h"
+#include "textbuf.h"
+#include "spatial.h"
+#include "efforts.h"
+
+// namespace che identifica i GPX
+#define GPX_NAMESPACE_STR "http://www.topografix.com/GPX/1/1"
+
+// raggio terrestre (in m) come implementato sui GPS
+#define EARTH_RADIUS 6.37813 * 1000 * 1000
+
+// fattore di conversione tra gradi e radianti (pi/180)
+#define GRAD_TO_RAD (3.1415926536 / 180)
+
+// ellissoide WGS-84: semiasse maggiore (m), schiacciamento, semiasse minore ed eccentricità al quadrato
+#define WGS84_A 6378137.0
+#define WGS84_F (1 / 298.257223563)
+#define WGS84_B (WGS84_A * (1 - WGS84_F))
+#define WGS84_E2 (WGS84_F * (2 - WGS84_F))
+
+// formula inversa di Vincenty: iterazioni massime e tolleranza (rad) sulla differenza di longitudine ausiliaria
+#define VINCENTY_MAX_ITERATIONS 100
+#define VINCENTY_TOLERANCE 1e-12
+
+// i polinomi usati nel calcolo vettoriale delle distanze valgono per semi-differenze di coordinate (e per il seno
+// dell'angolo al centro) fino a questo valore, cioè per segmenti fino a circa 1200 km; oltre si usa il calcolo scalare
+#define DISTANCE_POLY_LIMIT 0.1
+
+// numero dei modelli della Terra di --distance (distanceMode)
+#define DISTANCE_MODES 3
+
+// numero di punti elaborati insieme dall'accumulatore (le distanze sono calcolate per blocchi)
+#define ACCUMULATOR_BLOCK 256
+
+// carattere usato per rappresentare il grafico altimetrico
+#define ALTIGRAPH_FILL_CHAR '*'
+
+// carattere che segna, nel grafico altimetrico con --downsample=m4, la quota minima di una colonna
+#define ALTIGRAPH_LOW_CHAR '.'
+
+// dimensioni di default della matrice usata per il grafico altimetrico
+#define DEFAULT_ALTIGRAPH_ROWS 30
+#define DEFAULT_ALTIGRAPH_COLS 100
+
+// grafici che si possono stampare (--chart) e asse x dei grafici (--chart-x)
+#define SERIES_ELEVATION 0x1
+#define SERIES_SPEED 0x2
+#define SERIES_HR 0x4
+#define SERIES_GRADE 0x8
+#define AXIS_DISTANCE 0
+#define AXIS_TIME 1
+
+// numero di "contenitori" di distanza del profilo altimetrico accumulato in streaming
+#define PROFILE_BINS 1024
+
+// ampiezza iniziale (in m) di un contenitore del profilo altimetrico; raddoppia ogni volta che la traccia non ci sta più
+#define PROFILE_BIN_DISTANCE 1.0
+
+// canali dei sensori letti dalle estensioni dei punti (TrackPointExtension di Garmin e simili)
+#define SENSOR_CHANNELS 4
+#define CHANNEL_HR 0
+#define CHANNEL_CAD 1
+#define CHANNEL_ATEMP 2
+#define CHANNEL_POWER 3
+
+// filtro delle quote per il calcolo del dislivello: finestra della mediana mobile (di default e massima),
+// rumore della misura (m^2) e del modello (m^2 per m percorso) del filtro di Kalman
+#define DEFAULT_SMOOTH_WINDOW 5
+#define SMOOTH_MAX_WINDOW 63
+#define KALMAN_MEASUREMENT_NOISE 4.0
+#define KALMAN_PROCESS_NOISE 0.1
+
+// zone di frequenza cardiaca: limiti inferiori (in frazione della FC massima) delle zone dalla seconda in poi
+#define HR_ZONES 5
+#define DEFAULT_HR_MAX 190
+
+// lunghezza massima del nome di una traccia
+#define TRACK_NAME_SIZE 50
+
+// lunghezza massima del testo di un nodo "ele" o "time" letto in streaming
+#define STREAM_TEXT_SIZE 64
+
+// lettura parallela: dimensione minima di un blocco (byte) e scostamento relativo massimo ammesso tra le metriche
+// calcolate a blocchi e quelle calcolate in sequenza (le somme sono eseguite in un ordine diverso)
+#define PARALLEL_MIN_CHUNK_SIZE (64 * 1024)
+#define PARALLEL_EPSILON 1e-9
+#define PARALLEL_CHUNK_FOOTER "</gpx>\n"
+
+// arena di memoria: dimensione dei blocchi, allineamento delle allocazioni e origine di un blocco di memoria
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGN(size) (((size) + 15) & ~(size_t) 15)
+#define ARENA_ORIGIN_HEAP 0
+#define ARENA_ORIGIN_ARENA 1
+
+// analisi a finestre (--efforts): numero massimo di finestre, finestre predefinite e distanza (m) dei parziali
+#define EFFORTS_MAX 16
+#define DEFAULT_EFFORTS "1km,5km,10km,5min,20min"
+#define EFFORT_SPLIT_DISTANCE 1000.0
+
+// modalità --follow: intervallo predefinito (s) tra due controlli del file e byte letti al massimo in una volta
+#define FOLLOW_INTERVAL 1.0
+#define FOLLOW_CHUNK_SIZE (4 * 1024 * 1024)
+
+// metriche dei sensori: per ogni canale numero di valori, somma, minimo e massimo;
+// tempo (in ms) trascorso in ciascuna zona di frequenza cardiaca
+typedef struct {
+  int count[SENSOR_CHANNELS];
+  double sum[SENSOR_CHANNELS];
+  double min[SENSOR_CHANNELS];
+  double max[SENSOR_CHANNELS];
+  int64_t hrZoneTime[HR_ZONES];
+} sensorMetrics;
+
+// tipi custom: Risultati finali
+typedef struct {
+  char name[TRACK_NAME_SIZE];
+  double distance;
+  double ascent;
+  double descent;
+  double avgspeed;
+  double totalTime;
+  double minElevation;
+  double maxElevation;
+  int numPoints;
+  sensorMetrics sensors;
+} metrics;
+
+// Rappresentazione di un punto GPX
+typedef struct {
+  double lat;
+  double lon;
+  double elevation;
+  int64_t time;     // istante del punto, in millisecondi dal 1970-01-01T00:00:00Z
+} gpxPoint;
+
+// valori dei sensori di un punto: il bit c di "present" indica se il canale c è valorizzato
+typedef struct {
+  unsigned present;
+  float value[SENSOR_CHANNELS];
+} sensorSample;
+
+// valori dei sensori di un array di punti, per colonne: ogni canale ha un bitmap di presenza (un bit per punto)
+// e un array di valori, allocati solo al primo valore del canale (una traccia senza sensori non occupa memoria)
+typedef struct {
+  int capacity;
+  uint64_t *present[SENSOR_CHANNELS];
+  float *values[SENSOR_CHANNELS];
+} sensorStore;
+
+// unità di distanza e di altezza per la stampa del grafico altimetrico
+typedef struct {
+  double height;
+  double distance;
+} altigraphUnits;
+
+// dimensioni del grafico altimetrico
+typedef struct {
+  int rows;
+  int cols;
+} altigraphSize;
+
+// modalità di lettura del file GPX
+typedef enum {
+  PARSER_STREAM,  // xmlTextReader: i punti vengono elaborati man mano che sono letti
+  PARSER_DOM,     // xmlParseFile: l'intero documento viene caricato in memoria
+  PARSER_PARALLEL, // i punti di ogni segmento sono divisi in blocchi, letti ed elaborati su più thread
+  PARSER_MMAP      // file mappato in memoria e letto con un tokenizer minimo, senza libxml2
+} parserMode;
+
+// riduzione dei punti di una traccia alle colonne del grafico altimetrico
+typedef enum {
+  DOWNSAMPLE_AVG,   // quota media dei punti della colonna
+  DOWNSAMPLE_M4,    // inviluppo esatto: quota massima (e minima) dei punti della colonna
+  DOWNSAMPLE_LTTB   // Largest-Triangle-Three-Buckets: la quota di un punto scelto in ogni colonna
+} downsampleMode;
+
+// livellamento delle quote prima del calcolo del dislivello
+typedef enum {
+  SMOOTH_NONE,
+  SMOOTH_MEDIAN,    // mediana mobile degli ultimi N campioni
+  SMOOTH_KALMAN     // filtro di Kalman a una dimensione (quota costante più rumore proporzionale alla distanza)
+} smoothingMode;
+
+// fasi dell'elaborazione misurate da --stats
+typedef enum {
+  STAT_PARSE,       // lettura del documento (in streaming, con mmap e in parallelo anche l'estrazione dei punti)
+  STAT_XPATH,       // valutazione delle espressioni XPath
+  STAT_POINTS,      // estrazione dei dati dei punti dai nodi del DOM (getPointData)
+  STAT_METRICS,     // metriche dei punti (getResults, accumulatore)
+  STAT_PROFILE,     // quote delle colonne del grafico altimetrico (getAvgElevation, M4, LTTB)
+  STAT_OUTPUT,      // stampa dei risultati e dei grafici, record JSON/CSV
+  STAT_OTHER,       // tutto il resto (solo la memoria: il tempo è la differenza con il totale)
+  STATS_STAGES
+} statsStage;
+
+// tempi e contatori di una fase; il tempo è al netto delle fasi annidate (ad es. l'output durante la lettura in streaming)
+typedef struct {
+  long calls;
+  uint64_t ticks;
+  long points;
+  long bytes;           // memoria richiesta tramite arenaMalloc() e simili (anche da libxml2)
+} statsEntry;
+
+// timer di una fase in corso: i timer annidati formano una pila, per togliere il loro tempo a quello della fase esterna
+typedef struct statsTimer {
+  statsStage stage;
+  uint64_t start;
+  uint64_t nested;      // tempo delle fasi annidate
+  struct statsTimer *parent;
+} statsTimer;
+
+// formato dell'output
+typedef enum {
+  FORMAT_TEXT,      // testo per la lettura, con i grafici (default)
+  FORMAT_JSON,      // array JSON di record
+  FORMAT_CSV,       // un record per riga, con intestazione
+  FORMAT_NDJSON     // un oggetto JSON per riga
+} outputFormat;
+
+// tipo di record dell'output JSON/CSV
+typedef enum {
+  RECORD_SEGMENT,
+  RECORD_TRACK      // totale di una traccia con più segmenti
+} recordType;
+
+// modello della Terra usato per le distanze (--distance)
+typedef enum {
+  DISTANCE_HAVERSINE,   // sfera con il raggio EARTH_RADIUS, formula dell'emisenoverso (default)
+  DISTANCE_WGS84,       // ellissoide WGS-84, formula inversa di Vincenty
+  DISTANCE_FLAT         // piano tangente all'ellissoide alla latitudine media del segmento (equirettangolare)
+} distanceMode;
+
+// impostazioni di un'elaborazione (un file) e destinazione del suo output: ogni file elaborato, anche in parallelo
+// nella modalità batch, ha le proprie
+typedef struct {
+  int debug;                  // 0 = debug disattivo; 1 = debug attivo
+  altigraphSize altigraphSize;
+  parserMode parserMode;
+  int parseThreads;           // thread per la lettura parallela (0 = tanti quanti i core)
+  int cache;                  // 1 = usa (e scrive) la cache binaria accanto al file GPX
+  int arena;                  // 1 = la memoria dell'elaborazione viene dall'arena del thread, azzerata a fine file
+  int hrMax;                  // frequenza cardiaca massima (bpm), per le zone
+  distanceMode distance;      // modello della Terra per le distanze (--distance)
+  int charts;                 // grafici da stampare (SERIES_ELEVATION | SERIES_SPEED | ...)
+  int chartAxis;              // AXIS_DISTANCE o AXIS_TIME
+  downsampleMode downsample;  // riduzione dei punti alle colonne del grafico altimetrico
+  smoothingMode smoothing;    // filtro delle quote per il dislivello: livellamento...
+  int smoothWindow;           // ...finestra della mediana mobile (campioni)
+  double hysteresis;          // ...soglia (m) dell'isteresi, 0 = nessuna
+  double resampleDistance;    // ...passo (m) del ricampionamento, 0 = nessuno
+  outputFormat format;        // formato dell'output
+  int exportSeries;           // JSON/CSV: 1 = anche profilo altimetrico e serie dei punti di ogni segmento
+  int nearPoint;              // 1 = per ogni segmento, il punto più vicino a (nearLat, nearLon)
+  double nearLat;
+  double nearLon;
+  int numEfforts;             // finestre dell'analisi di ogni segmento (--efforts), 0 = nessuna
+  effortWindow efforts[EFFORTS_MAX];
+  struct activityIndex *index; // se non NULL le tracce dei file non vengono stampate ma aggiunte all'indice delle attività
+  FILE *out;                  // stdout, oppure un buffer in memoria nella modalità batch
+  FILE *messages;             // se non NULL, messaggi ed errori dei formati diversi dal testo (risposte di --serve)
+} jobConfig;
+
+// profilo altimetrico a memoria costante: quota sommata (con minimo e massimo) per contenitori di distanza di ampiezza fissa.
+// Quando la traccia supera PROFILE_BINS contenitori, questi vengono fusi a coppie e l'ampiezza raddoppia
+typedef struct {
+  double binDistance;
+  int numBins;
+  double elevation[PROFILE_BINS];
+  double minElevation[PROFILE_BINS];
+  double maxElevation[PROFILE_BINS];
+  int count[PROFILE_BINS];
+} elevationProfile;
+
+// quote del grafico altimetrico, una per colonna, ricavate dai punti con la modalità di --downsample;
+// con M4 "elevation" è la quota massima e "low" la minima di ogni colonna, altrimenti "low" è NULL
+typedef struct {
+  int cols;
+  double *elevation;
+  double *low;
+} elevationSeries;
+
+// coordinate di una traccia in forma colonnare (structure of arrays), in radianti, con il coseno della latitudine
+// già calcolato per ogni punto: è l'ingresso delle funzioni che calcolano le distanze di tutti i segmenti in un colpo solo
+typedef struct {
+  int size;
+  double *lat;
+  double *lon;
+  double *cosLat;
+} trackCoordinates;
+
+// analisi di una traccia conservata in memoria: per ogni punto la distanza progressiva (calcolata una sola volta),
+// la quota e la somma progressiva delle quote. Da questi array si ricava con una ricerca binaria la quota media
+// di qualunque intervallo di distanza, quindi il profilo altimetrico per qualunque larghezza del grafico
+typedef struct {
+  int numPoints;
+  int capacity;
+  double *distance;       // distanza progressiva (m) del punto i dal primo punto
+  double *elevation;      // quota (m) del punto i
+  double *elevationSum;   // elevationSum[i] = somma delle quote dei punti 0..i-1 (numPoints + 1 elementi)
+  int64_t *time;          // istante (ms) del punto i
+  double *heartRate;      // frequenza cardiaca del punto i (NAN se non rilevata)
+} trackAnalysis;
+
+// risultati dell'analisi a finestre di un segmento, nell'ordine delle finestre di --efforts: migliore prestazione di ogni
+// finestra, salita migliore di ogni finestra di distanza e parziali per Km
+typedef struct {
+  effortResult best[EFFORTS_MAX];
+  effortResult climb[EFFORTS_MAX];
+  effortSplit *splits;
+  int numSplits;
+} segmentEfforts;
+
+// funzione che calcola la lunghezza di tutti i segmenti di una traccia (distances[i] = distanza tra i punti i-1 e i)
+typedef void (*distanceKernel)(const trackCoordinates *c, double *distances);
+
+// filtro delle quote per il dislivello: i punti (distanza progressiva, quota) attraversano in una sola passata
+// ricampionamento a distanza fissa, livellamento (mediana mobile o Kalman) e isteresi; la memoria è quella della finestra
+typedef struct {
+  const jobConfig *job;
+  int numPoints;
+  double prevDistance;           // ultimo punto ricevuto (per interpolare i campioni del ricampionamento)
+  double prevElevation;
+  double nextDistance;           // distanza del prossimo campione
+  int emitted;                   // 1 se l'ultimo punto è già stato passato come campione
+  double window[SMOOTH_MAX_WINDOW];
+  int windowSize;
+  int windowPos;
+  double kalmanElevation;
+  double kalmanVariance;
+  double kalmanDistance;
+  int numSamples;
+  double reference;              // quota dell'ultimo campione conteggiato (isteresi)
+  double ascent;
+  double descent;
+} elevationFilter;
+
+// accumulatore delle metriche: riceve i punti uno alla volta, sia dall'array costruito dal DOM
+// sia direttamente dal parser in streaming. I punti vengono messi da parte e elaborati a blocchi,
+// in modo da calcolare le distanze con le funzioni vettoriali
+typedef struct {
+  const jobConfig *job;
+  metrics *results;
+  elevationProfile *profile; // opzionale: NULL se il profilo non serve
+  trackAnalysis *analysis;   // opzionale: NULL se le distanze progressive non vanno conservate
+  gpxPoint firstPoint;       // primo punto elaborato (serve a unire i risultati di blocchi letti in parallelo)
+  sensorSample firstSample;  // sensori del primo punto
+  gpxPoint prevPoint;
+  int64_t elapsedTime;       // tempo trascorso (in ms), sommato senza errori di arrotondamento
+  elevationFilter filter;    // usato solo se è attivo un filtro delle quote
+  int numPoints;
+  int blockSize;
+  gpxPoint block[ACCUMULATOR_BLOCK];
+  sensorSample sensorBlock[ACCUMULATOR_BLOCK];
+  double lat[ACCUMULATOR_BLOCK + 1];
+  double lon[ACCUMULATOR_BLOCK + 1];
+  double cosLat[ACCUMULATOR_BLOCK + 1];
+  double distances[ACCUMULATOR_BLOCK + 1];
+} trackAccumulator;
+
+// blocco di memoria di un'arena
+typedef struct arenaBlock {
+  struct arenaBlock *next;
+  size_t size;
+  size_t used;
+  size_t reserved;          // porta l'inizio dei dati a un multiplo di 16 byte
+  char data[];
+} arenaBlock;
+
+// arena di memoria (una per thread): le allocazioni avanzano in blocchi da ARENA_BLOCK_SIZE, e vengono
+// recuperate tutte insieme alla fine di ogni file
+typedef struct {
+  int active;
+  arenaBlock *blocks;
+  arenaBlock *current;      // blocco da cui si sta allocando
+  arenaBlock *large;        // blocchi dedicati alle richieste grandi
+} memoryArena;
+
+// intestazione di ogni blocco restituito da arenaMalloc(): dimensione richiesta e origine (heap o arena)
+typedef struct {
+  size_t size;
+  size_t origin;
+} allocationHeader;
+
+// elenco dei file da elaborare in modalità batch
+typedef struct {
+  int size;
+  int capacity;
+  char **files;
+} fileList;
+
+// risultato dell'elaborazione di un file in modalità batch: l'output è raccolto in memoria
+typedef struct {
+  char *output;
+  size_t outputSize;
+  long records;     // record JSON/CSV scritti
+  int ret;
+  int done;
+} batchResult;
+
+// coda dei file del batch, condivisa tra i thread del pool
+typedef struct {
+  const jobConfig *config;    // impostazioni comuni: ogni thread ne fa una copia
+  const fileList *files;
+  batchResult *results;
+  int next;                   // indice del prossimo file da elaborare
+  pthread_mutex_t mutex;
+  pthread_cond_t completed;   // segnalata ogni volta che un file è stato elaborato
+} batchQueue;
+
+// stato del parser in streaming
+typedef struct {
+  const jobConfig *job;
+  const char *filename;
+  int inTrack;
+  int inSegment;
+  int inPoint;
+  int numSegments;
+  int trackSegments;                // segmenti della traccia corrente
+  const xmlChar *field;             // elemento di cui si sta leggendo il testo (ele, time, name), NULL se nessuno
+  char text[STREAM_TEXT_SIZE];
+  int textLength;
+  char trackName[TRACK_NAME_SIZE];
+  gpxPoint point;
+  sensorSample sample;              // sensori del punto corrente
+  int sensorChannel;                // canale di cui si sta leggendo il valore, -1 se nessuno
+  metrics results;
+  metrics total;                    // totali della traccia corrente
+  elevationProfile profile;
+  trackAccumulator acc;
+  trackAnalysis analysis;           // con --efforts i punti del segmento corrente (capacity 0 = non conservati)
+  int numTracks;
+  long numPoints;                   // punti letti, in tutti i segmenti
+  struct trackCache *cache;         // se non NULL i segmenti e i loro punti sono raccolti qui invece di essere stampati
+} streamState;
+
+// stato della modalità --follow: lo stato del parser (con gli accumulatori del segmento in corso) resta in memoria tra
+// un aggiornamento e l'altro, e del file si leggono solo i byte successivi all'ultimo punto completo
+typedef struct {
+  streamState *st;
+  int fd;
+  off_t consumed;                   // byte già passati al parser: fino alla fine dell'ultimo punto completo
+  off_t size;                       // dimensione del file all'ultima lettura
+  char *buffer;                     // byte del file da "consumed" in poi
+  size_t bufferSize;
+} followState;
+
+// blocco di punti di un segmento, letto ed elaborato da un thread nella lettura parallela. Il parser riceve il prologo
+// del documento (fino al tag di apertura <gpx ...>, con le dichiarazioni dei namespace), i byte del blocco e la chiusura </gpx>
+typedef struct {
+  const jobConfig *job;
+  const char *header;
+  size_t headerSize;
+  const char *data;          // solo elementi trkpt completi
+  size_t dataSize;
+  size_t position;           // byte già passati al parser
+  metrics results;           // metriche parziali, calcolate a partire dal primo punto del blocco
+  int64_t elapsedTime;
+  gpxPoint firstPoint;
+  sensorSample firstSample;
+  gpxPoint lastPoint;
+  trackAnalysis analysis;    // distanze progressive a partire dal primo punto del blocco
+  int ret;
+} parseChunk;
+
+// tipo di un tag letto dal tokenizer della modalità mmap
+typedef enum {
+  GPX_TAG_OPEN,   // <nome ...>
+  GPX_TAG_CLOSE,  // </nome>
+  GPX_TAG_EMPTY   // <nome ... />
+} gpxTagType;
+
+// tag letto dal tokenizer: nome locale (senza prefisso) e attributi puntano direttamente ai byte del file mappato
+typedef struct {
+  gpxTagType type;
+  const char *name;
+  int nameLength;
+  const char *attributes;       // dalla fine del nome...
+  const char *attributesEnd;    // ...al '>' che chiude il tag
+} gpxTag;
+
+// contatore delle espressioni XPath valutate (usato in modalità debug); uno per thread
+extern _Thread_local long _XPATH_EVALS_;
+
+// funzioni usate per il calcolo delle distanze, una per modello della Terra, scelte alla prima chiamata di getSegmentDistances()
+extern distanceKernel _DISTANCE_KERNELS_[DISTANCE_MODES];
+
+// arena di memoria del thread, attiva durante l'elaborazione di un file con --arena
+extern _Thread_local memoryArena _ARENA_;
+
+// contatori delle richieste di memoria passate da arenaMalloc() e simili, e delle chiamate effettive a malloc()
+extern long _ALLOCATIONS_;
+extern long _SYSTEM_ALLOCATIONS_;
+
+// global variable: 1 = --stats, misura tempi e contatori delle fasi
+extern int _STATS_;
+
+// tempi e contatori delle fasi del thread, sommati a _STATS_TOTAL_ alla fine del thread, e timer della fase in corso
+extern _Thread_local statsEntry _THREAD_STATS_[STATS_STAGES];
+extern _Thread_local statsTimer *_STATS_TIMER_;
+
+// tempi e contatori di tutti i thread; inizio della misura (tick e tempo, per convertire i tick in ns)
+extern statsEntry _STATS_TOTAL_[STATS_STAGES];
+extern pthread_mutex_t _STATS_MUTEX_;
+extern uint64_t _STATS_START_TICKS_;
+extern struct timespec _STATS_START_TIME_;
+
+// buffer in cui sono composti i record JSON/CSV, riutilizzato per tutti i record del thread
+extern _Thread_local textBuffer _RECORD_BUFFER_;
+
+// record JSON/CSV scritti dal thread per il file in elaborazione
+extern _Thread_local long _FILE_RECORDS_;
+
+// global variable con la cartella o l'elenco dei file da elaborare in modalità batch (NULL = un solo file)
+extern const char *_BATCH_;
+
+// global variable con il numero di thread della modalità batch (0 = tanti quanti i core)
+extern int _THREADS_;
+
+// global variable con l'intervallo (s) tra due controlli del file nella modalità --follow (0 = modalità non attiva)
+extern double _FOLLOW_;
+
+// global variable con i secondi senza nuovi dati dopo i quali --follow termina (0 = solo con Ctrl+C)
+extern double _FOLLOW_IDLE_;
+
+// global variable impostata da SIGINT/SIGTERM per terminare --follow
+extern volatile sig_atomic_t _FOLLOW_STOP_;
+
+// timer delle fasi: senza --stats costano un solo confronto, con -DNO_STATS nulla
+#ifdef HAVE_STATS
+#define STATS_BEGIN(timer, stage) statsTimer timer; if (_STATS_) beginStatsTimer(&timer, stage)
+#define STATS_END(timer, points) if (_STATS_) endStatsTimer(&timer, points)
+#define STATS_BYTES(size) if (_STATS_) addStatsBytes(size)
+#else
+#define STATS_BEGIN(timer, stage) do {} while (0)
+#define STATS_END(timer, points) do {} while (0)
+#define STATS_BYTES(size) do {} while (0)
+#endif
+
+// prototipi delle funzioni
+int fileExists(const char *filename);
+int processFile(const jobConfig *job, const char *filename);
+int processFileDom(const jobConfig *job, const char *filename);
+int processFileStream(const jobConfig *job, const char *filename);
+int processFileParallel(const jobConfig *job, const char *filename);
+int processFileMmap(const jobConfig *job, const char *filename);
+int processGpxBuffer(const jobConfig *job, const char *filename, const char *data, size_t size);
+int processFileFollow(const jobConfig *job, const char *filename);
+int parseOption(const char *option, jobConfig *config);
+
+int processBatch(const jobConfig *config, const char *source, int numThreads);
+int runBatch(const jobConfig *config, const fileList *files, int numThreads, FILE *out, long *records);
+void *batchWorker(void *arg);
+int getBatchFiles(const char *source, fileList *list);
+void addFile(fileList *list, char *path);
+void freeFileList(fileList *list);
+int compareFileNames(const void *a, const void *b);
+int getNumCores(void);
+double getElapsedSeconds(const struct timespec *start);
+
+void processStreamNode(xmlTextReaderPtr reader, streamState *st);
+void readStreamPointAttributes(xmlTextReaderPtr reader, gpxPoint *p);
+void beginStreamTrack(streamState *st);
+void beginStreamSegment(streamState *st);
+void endStreamSegment(streamState *st);
+void endStreamTrack(streamState *st);
+void addStreamPoint(streamState *st);
+void freeStreamState(streamState *st);
+
+int parseGpxBuffer(streamState *st, const char *data, const char *end);
+const char *findLastPointEnd(const char *data, const char *end);
+
+int initFollow(followState *f, const jobConfig *job, const char *filename);
+int updateFollow(followState *f);
+int finishFollow(followState *f);
+void freeFollow(followState *f);
+ssize_t readFollow(followState *f, size_t length);
+void printFollowUpdate(followState *f, int newPoints, double elapsed);
+void stopFollow(int signum);
+int nextGpxTag(const char **cursor, const char *end, gpxTag *tag);
+int isGpxTag(const gpxTag *tag, const char *name);
+int skipGpxElement(const char **cursor, const char *end);
+const char *getGpxAttribute(const gpxTag *tag, const char *name);
+void copyGpxText(char *dest, int size, const char *text, const char *textEnd);
+int decodeCharReference(const char **text, const char *textEnd, char *utf8);
+int getGpxText(const char *cursor, const char *end, char *buffer, int size, const char **text, const char **textEnd);
+double parseGpxNumber(const char *p, const char *end);
+
+char *readFileContents(const char *filename, size_t *size);
+const char *findElement(const char *from, const char *to, const char *name);
+void getChunkTrackName(const char *from, const char *to, char *trackName);
+int analyzeSegmentChunks(const jobConfig *job, const char *header, size_t headerSize, const char *from, const char *to, int numChunks, metrics *r, trackAnalysis *analysis);
+void *parseChunkWorker(void *arg);
+int readChunkInput(void *context, char *buffer, int len);
+void mergeChunkResults(const jobConfig *job, metrics *r, trackAnalysis *analysis, const parseChunk *chunk, int64_t *elapsedTime, gpxPoint *lastPoint);
+
+void *arenaMalloc(size_t size);
+void *arenaCalloc(size_t count, size_t size);
+void *arenaRealloc(void *ptr, size_t size);
+void arenaFree(void *ptr);
+char *arenaStrdup(const char *str);
+void *arenaBump(memoryArena *arena, size_t size);
+void resetArena(void);
+void releaseArena(void);
+void startStats(void);
+uint64_t getStatsTicks(void);
+void beginStatsTimer(statsTimer *timer, statsStage stage);
+void endStatsTimer(statsTimer *timer, long points);
+void addStatsBytes(size_t size);
+void mergeThreadStats(void);
+void printStats(const jobConfig *job);
+
+void initAccumulator(trackAccumulator *acc, const jobConfig *job, metrics *r, elevationProfile *profile, trackAnalysis *analysis);
+void accumulatePoint(trackAccumulator *acc, const gpxPoint *p, const sensorSample *sample);
+void flushAccumulator(trackAccumulator *acc);
+void addPointResults(trackAccumulator *acc, const gpxPoint *p, const sensorSample *sample, double distance);
+void finalizeAccumulator(trackAccumulator *acc);
+void getLiveResults(trackAccumulator *acc, metrics *live);
+void mergeResults(metrics *total, const metrics *segment);
+
+int isElevationFilterActive(const jobConfig *job);
+void initElevationFilter(elevationFilter *f, const jobConfig *job);
+void addFilterPoint(elevationFilter *f, double distance, double elevation);
+void addFilterSample(elevationFilter *f, double distance, double elevation);
+double getSmoothedElevation(elevationFilter *f, double distance, double elevation);
+void finalizeElevationFilter(elevationFilter *f);
+void filterAnalysisElevation(const jobConfig *job, const trackAnalysis *analysis, metrics *r);
+uint64_t getMetricsSettingsHash(const jobConfig *job);
+
+int getSensorChannel(const char *name, int length);
+void setSensorValue(sensorSample *sample, int channel, double value);
+void addSensorResults(sensorMetrics *m, const sensorSample *sample, int64_t interval, int hrMax);
+void addHeartRateZoneTime(sensorMetrics *m, const sensorSample *sample, int64_t interval, int hrMax);
+int getHeartRateZone(double hr, int hrMax);
+void mergeSensorMetrics(sensorMetrics *total, const sensorMetrics *part);
+void initSensorStore(sensorStore *store, int capacity);
+void storeSensorSample(sensorStore *store, int index, const sensorSample *sample);
+void loadSensorSample(const sensorStore *store, int index, sensorSample *sample);
+void freeSensorStore(sensorStore *store);
+void readSensorNodes(const xmlNodePtr node, sensorSample *sample);
+const char *getNodeText(const xmlNode *node, char *buffer, int size);
+int parseGpxSensors(const char **cursor, const char *end, sensorSample *sample);
+void printSensorResults(const jobConfig *job, const metrics *r);
+void printHrZones(const jobConfig *job, const int64_t *zoneTime);
+
+void initProfile(elevationProfile *profile);
+void addProfilePoint(elevationProfile *profile, double distance, double elevation);
+void getProfileAvgElevation(const jobConfig *job, const elevationProfile *profile, const altigraphUnits *units, double *avgElevation, int avgElevationSize);
+void fillEmptyColumns(double *avgElevation, const int *count, int avgElevationSize);
+
+void initTrackAnalysis(trackAnalysis *a, int capacity);
+void addAnalysisPoint(trackAnalysis *a, double distance, double elevation, int64_t time, double heartRate);
+void freeTrackAnalysis(trackAnalysis *a);
+int findDistanceIndex(const trackAnalysis *a, double distance);
+
+int parseEffortList(const char *list, jobConfig *config);
+void getSegmentEfforts(const jobConfig *job, const trackAnalysis *analysis, segmentEfforts *e);
+void freeSegmentEfforts(segmentEfforts *e);
+void getEffortName(const effortWindow *w, char *name, int size);
+void printEfforts(const jobConfig *job, const segmentEfforts *e);
+void appendJsonEfforts(textBuffer *b, const jobConfig *job, const segmentEfforts *e);
+
+void getResults(const jobConfig *job, const gpxPoint *pointSet, const sensorStore *sensors, int size, metrics *r, trackAnalysis *analysis);
+void printResults(const jobConfig *job, const char *filename, const metrics *r);
+void printTrackTotal(const jobConfig *job, const char *filename, const metrics *r, int track, int numSegments);
+void printNearestPoint(const jobConfig *job, const gpxPoint *points, int numPoints, const trackAnalysis *analysis);
+int buildSpatialIndex(spatialIndex *index, const gpxPoint *points, int numPoints, const double *distance);
+void printSegment(const jobConfig *job, const char *filename, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationProfile *profile);
+FILE *getMessageStream(const jobConfig *job);
+void printOutputBegin(const jobConfig *job, FILE *out);
+void printOutputEnd(const jobConfig *job, FILE *out);
+void writeRecord(const jobConfig *job, const char *filename, recordType type, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationProfile *profile);
+void appendJsonRecord(textBuffer *b, const jobConfig *job, const char *filename, recordType type, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationSeries *profile, double profileStep, const segmentEfforts *efforts);
+void appendCsvRecord(textBuffer *b, const char *filename, recordType type, const metrics *r, int track, int segment, const trackAnalysis *analysis, const elevationSeries *profile, double profileStep);
+void appendJsonField(textBuffer *b, const char *name);
+void appendJsonNumber(textBuffer *b, double value);
+void appendJsonValues(textBuffer *b, const double *values, int size);
+void appendJsonArray(textBuffer *b, const char *name, const double *values, int size);
+void appendCsvNumber(textBuffer *b, double value);
+double getSensorAverage(const sensorMetrics *m, int channel);
+void releaseRecordBuffer(void);
+void printPoint(const jobConfig *job, const gpxPoint *p, int pointNumber);
+void printAltiGraph(const jobConfig *job, const metrics *r, const trackAnalysis *analysis);
+void printProfileAltiGraph(const jobConfig *job, const metrics *r, const elevationProfile *profile);
+void getAltiGraphUnits(const jobConfig *job, const metrics *r, altigraphUnits *units);
+void drawAltiGraph(const jobConfig *job, const metrics *r, const altigraphUnits *units, const elevationSeries *series);
+void addElevationChartSeries(chart *c, const elevationSeries *series, double *lowMarks);
+void initElevationSeries(elevationSeries *series, const jobConfig *job);
+void getElevationSeries(const jobConfig *job, const trackAnalysis *analysis, const altigraphUnits *units, elevationSeries *series);
+void getProfileElevationSeries(const jobConfig *job, const elevationProfile *profile, const altigraphUnits *units, elevationSeries *series);
+void downsampleElevation(const jobConfig *job, const double *x, const double *y, const double *low, const double *high, int size, double xUnit, elevationSeries *series);
+void freeElevationSeries(elevationSeries *series);
+void printTrackCharts(const jobConfig *job, const metrics *r, const trackAnalysis *analysis);
+void printSeriesChart(const jobConfig *job, const metrics *r, const trackAnalysis *analysis, int series);
+int parseChartList(const char *list);
+
+struct tm seconds2tm(double timeInSeconds);
+int parseTimestamp(const char *text, int64_t *time);
+void formatTimestamp(int64_t time, char *buffer);
+int64_t daysFromCivil(int year, int month, int day);
+void civilFromDays(int64_t days, int *year, int *month, int *day);
+
+gpxPoint getPointData(const xmlNodePtr pointNode, sensorSample *sample);
+double getAscent(const gpxPoint *p1, const gpxPoint *p2);
+double getDistance(double lat1, double lon1, double lat2, double lon2);
+void initTrackCoordinates(trackCoordinates *c, const gpxPoint *pointSet, int size);
+void freeTrackCoordinates(trackCoordinates *c);
+void getSegmentDistances(const jobConfig *job, const trackCoordinates *c, double *distances);
+distanceKernel selectDistanceKernel(distanceMode mode);
+void initDistanceKernels(void);
+double getDistanceRad(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2);
+void getSegmentDistancesScalar(const trackCoordinates *c, double *distances);
+#ifdef HAVE_X86_SIMD
+void getSegmentDistancesSse2(const trackCoordinates *c, double *distances);
+void getSegmentDistancesAvx2(const trackCoordinates *c, double *distances);
+#endif
+void getReducedLatitude(double lat, double cosLat, double *sinU, double *cosU);
+double getDistanceVincenty(double sinU1, double cosU1, double sinU2, double cosU2, double lonDelta);
+void getSegmentDistancesWgs84(const trackCoordinates *c, double *distances);
+void getSegmentDistancesFlat(const trackCoordinates *c, double *distances);
+double getDistanceFlat(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2);
+#ifdef HAVE_X86_SIMD
+void getSegmentDistancesFlatAvx2(const trackCoordinates *c, double *distances);
+#endif
+double getAvgSpeed(double distance, double timeInSeconds);
+void getAvgElevation(const jobConfig *job, const trackAnalysis *analysis, const altigraphUnits *units, double *avgElevation, int avgElevationSize);
+
+void getTrackName(const xmlDocPtr doc, const xmlNodePtr node, char *trackName);
+xmlXPathContextPtr createXPathContext(xmlDocPtr doc, xmlNodePtr node);
+xmlXPathObjectPtr getTracks(const xmlXPathContextPtr ctx);
+xmlXPathObjectPtr getTrackSegments(const xmlXPathContextPtr ctx);
+xmlXPathObjectPtr getPoints(const xmlXPathContextPtr ctx);
+xmlXPathObjectPtr evalXPath(const char *expression, xmlXPathContextPtr ctx);
+
+#endif
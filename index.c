@@ -0,0 +1,664 @@
+// GPSReader: indice delle attività di un atleta (--index): totali settimanali, migliori tempi e distribuzioni,
+// aggiornati senza rileggere i file già indicizzati
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "cache.h"
+#include "index.h"
+
+// global variable con il file dell'indice delle attività (NULL = nessun indice)
+const char *_INDEX_ = NULL;
+
+// --index: le tracce del file diventano attività dell'indice (una per traccia). Il file è letto come per la cache (con
+// --cache anche dalla cache binaria); l'indice viene aggiornato solo per le attività nuove o modificate
+int indexFile(const jobConfig *job, const char *filename) {
+
+  trackCache cache = {0};
+  uint64_t hash;
+
+  int ret = readTrackCache(job, filename, &cache, &hash);
+
+  if (ret != 0) {
+    freeTrackCache(&cache);
+    return ret;
+  }
+
+  // le metriche dipendono anche dal filtro delle quote, e le zone cardiache dalla FC massima
+  hash ^= getMetricsSettingsHash(job);
+
+  activityRecord *activities;
+  int numActivities = getTrackActivities(job, filename, &cache, hash, &activities);
+  freeTrackCache(&cache);
+
+  const char *status[] = { "invariata", "aggiunta", "aggiornata" };
+
+  for (int i = 0; i < numActivities; i++) {
+    pthread_mutex_lock(&(job->index->mutex));
+    int added = addActivity(job->index, &(activities[i]));
+    pthread_mutex_unlock(&(job->index->mutex));
+
+    if (added < 0) {
+      fprintf(getMessageStream(job), "Errore nella scrittura dell'indice delle attività\n");
+      ret = 1;
+      break;
+    }
+
+    if (job->format == FORMAT_TEXT) {
+      fprintf(job->out, "[ Indice: <%s> traccia %d <%s> %s ]\n", filename, activities[i].track, activities[i].name, status[added]);
+    }
+  }
+
+  free(activities);
+  return ret;
+}
+
+// attività (una per traccia) di un file letto con readTrackCache(): metriche della traccia, distanza per fascia di quota
+// e migliori tempi, calcolati dai punti di ciascun segmento. Restituisce il numero di attività, in *activities (da liberare)
+int getTrackActivities(const jobConfig *job, const char *filename, const trackCache *cache, uint64_t hash, activityRecord **activities) {
+
+  const double distances[] = INDEX_BEST_EFFORT_DISTANCES;
+
+  // una traccia ha almeno un segmento
+  activityRecord *list = calloc(cache->numSegments > 0 ? cache->numSegments : 1, sizeof(activityRecord));
+  int count = 0;
+
+  // la chiave è il percorso assoluto: lo stesso file indicato in modi diversi resta la stessa attività
+  char *path = realpath(filename, NULL);
+  const char *key = (path != NULL) ? path : filename;
+  size_t keyLength = strlen(key);
+
+  metrics total = {0};
+
+  for (int s = 0; s < cache->numSegments; s++) {
+
+    const cachedSegment *segment = &(cache->segments[s]);
+
+    // primo segmento di una traccia: una nuova attività
+    if (s == 0 || cache->segments[s - 1].track != segment->track) {
+      activityRecord *a = &(list[count++]);
+      a->key = getContentHash(key, keyLength) ^ ((uint64_t) (segment->track + 1) * 0x9e3779b97f4a7c15ULL);
+      a->hash = hash;
+      a->track = segment->track;
+      strncpy(a->file, (keyLength < INDEX_FILE_SIZE) ? key : key + keyLength - (INDEX_FILE_SIZE - 1), INDEX_FILE_SIZE - 1);
+      strcpy(a->name, segment->results.name);
+      memset(&total, 0, sizeof(metrics));
+    }
+
+    activityRecord *a = &(list[count - 1]);
+
+    if (a->start == 0 && segment->numPoints > 0) a->start = segment->points[0].time;
+
+    trackAnalysis analysis;
+    initTrackAnalysis(&analysis, segment->numPoints);
+    metrics results = {0};
+    getResults(job, segment->points, NULL, segment->numPoints, &results, &analysis);
+
+    // distanza percorsa in ogni fascia di quota (quella della quota media del tratto)
+    for (int i = 1; i < analysis.numPoints; i++) {
+      int band = (int) floor((analysis.elevation[i - 1] + analysis.elevation[i]) / 2.0 / INDEX_ELEVATION_BAND);
+      if (band < 0) band = 0;
+      if (band >= INDEX_ELEVATION_BANDS) band = INDEX_ELEVATION_BANDS - 1;
+      a->elevationDistance[band] += analysis.distance[i] - analysis.distance[i - 1];
+    }
+
+    // migliori tempi: i segmenti sono interruzioni della registrazione, quindi si cercano all'interno di ciascuno
+    effortTrack track = { analysis.numPoints, analysis.distance, analysis.time, NULL };
+
+    for (int b = 0; b < INDEX_BEST_EFFORTS; b++) {
+      effortResult best;
+      findDistanceEffort(&track, distances[b], &best, NULL);
+      if (best.found && (a->bestTime[b] == 0 || best.time < a->bestTime[b])) a->bestTime[b] = best.time;
+    }
+
+    freeTrackAnalysis(&analysis);
+    mergeResults(&total, &(segment->results));
+
+    // ultimo segmento della traccia: le metriche sono quelle del totale; una traccia senza punti non è un'attività
+    if ((s == cache->numSegments - 1 || cache->segments[s + 1].track != segment->track) && total.numPoints == 0) {
+      memset(a, 0, sizeof(activityRecord));
+      count--;
+    }
+    else if (s == cache->numSegments - 1 || cache->segments[s + 1].track != segment->track) {
+      a->week = (a->start != 0) ? getIsoWeek(a->start) : 0;
+      a->distance = total.distance;
+      a->time = total.totalTime;
+      a->ascent = total.ascent;
+      a->descent = total.descent;
+      a->maxElevation = total.maxElevation;
+      a->minElevation = total.minElevation;
+      memcpy(a->hrZoneTime, total.sensors.hrZoneTime, sizeof(a->hrZoneTime));
+    }
+  }
+
+  free(path);
+
+  *activities = list;
+  return count;
+}
+
+// settimana ISO 8601 (anno * 100 + settimana) di un istante in ms: la settimana inizia il lunedì e appartiene all'anno
+// del suo giovedì
+int getIsoWeek(int64_t time) {
+
+  time_t t = time / 1000;
+  struct tm day;
+  gmtime_r(&t, &day);
+
+  t += (time_t) (3 - (day.tm_wday + 6) % 7) * 86400;
+  gmtime_r(&t, &day);
+
+  return (day.tm_year + 1900) * 100 + day.tm_yday / 7 + 1;
+}
+
+// apre (o crea) il file dell'indice e ne legge gli elementi; il file resta bloccato fino a closeActivityIndex(), così
+// due elaborazioni non possono aggiornarlo insieme. Restituisce 0 se il file non si può usare
+int openActivityIndex(activityIndex *index, const char *path) {
+
+  memset(index, 0, sizeof(activityIndex));
+
+  index->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (index->fd < 0) return 0;
+
+  struct stat info;
+
+  if (flock(index->fd, LOCK_EX) != 0 || fstat(index->fd, &info) != 0) {
+    close(index->fd);
+    return 0;
+  }
+
+  indexHeader *h = &(index->header);
+
+  if (info.st_size == 0) {
+    memcpy(h->magic, INDEX_MAGIC, 4);
+    h->version = INDEX_VERSION;
+    h->slotSize = sizeof(indexSlot);
+    for (int b = 0; b < INDEX_BEST_EFFORTS; b++) h->bestSlot[b] = -1;
+
+    if (!writeIndexHeader(index)) {
+      close(index->fd);
+      return 0;
+    }
+  }
+  else {
+    int valid = (pread(index->fd, h, sizeof(indexHeader), 0) == sizeof(indexHeader) && memcmp(h->magic, INDEX_MAGIC, 4) == 0 &&
+                 h->version == INDEX_VERSION && h->slotSize == sizeof(indexSlot) &&
+                 (uint64_t) info.st_size == sizeof(indexHeader) + (uint64_t) h->numSlots * sizeof(indexSlot));
+
+    if (valid) {
+      index->capacity = h->numSlots;
+      index->slots = malloc(sizeof(indexSlot) * (h->numSlots > 0 ? h->numSlots : 1));
+      size_t size = sizeof(indexSlot) * h->numSlots;
+      valid = (index->slots != NULL && pread(index->fd, index->slots, size, sizeof(indexHeader)) == (ssize_t) size);
+    }
+
+    if (!valid) {
+      free(index->slots);
+      close(index->fd);
+      return 0;
+    }
+  }
+
+  if (!resizeIndexLookup(index, 64) || !isValidActivityIndex(index)) {
+    free(index->slots);
+    free(index->lookup);
+    close(index->fd);
+    return 0;
+  }
+
+  pthread_mutex_init(&(index->mutex), NULL);
+  return 1;
+}
+
+// controlla gli elementi di un indice letto dal file, prima di usarli: ogni elemento è un'attività o una settimana, le
+// attività sono quante dice l'intestazione e ciascuna ha la sua settimana, e i migliori tempi indicano attività
+int isValidActivityIndex(const activityIndex *index) {
+
+  const indexHeader *h = &(index->header);
+  uint32_t numActivities = 0;
+
+  for (int i = 0; i < (int) h->numSlots; i++) {
+    const indexSlot *slot = &(index->slots[i]);
+
+    if (slot->type == INDEX_SLOT_ACTIVITY) {
+      if (findIndexSlot(index, INDEX_SLOT_WEEK, slot->activity.week) < 0) return 0;
+      numActivities++;
+    }
+    else if (slot->type != INDEX_SLOT_WEEK) return 0;
+  }
+
+  if (numActivities != h->numActivities) return 0;
+
+  for (int b = 0; b < INDEX_BEST_EFFORTS; b++) {
+    if (h->bestSlot[b] == -1) continue;
+    if (h->bestSlot[b] < 0 || h->bestSlot[b] >= (int32_t) h->numSlots || index->slots[h->bestSlot[b]].type != INDEX_SLOT_ACTIVITY) return 0;
+  }
+
+  return 1;
+}
+
+// chiude il file dell'indice (e lo sblocca)
+void closeActivityIndex(activityIndex *index) {
+  pthread_mutex_destroy(&(index->mutex));
+  close(index->fd);
+  free(index->slots);
+  free(index->lookup);
+}
+
+// aggiunge un'attività all'indice, o la sostituisce se la stessa traccia dello stesso file è già presente ma il file (o
+// le impostazioni) sono cambiati: si tolgono i suoi vecchi valori da totali e settimana e si aggiungono i nuovi. Sul file
+// si riscrivono solo l'attività, le settimane coinvolte e l'intestazione. La memoria per i nuovi elementi (attività e
+// settimana) è riservata prima di cambiare l'indice, che se manca resta com'era.
+// Restituisce 0 se l'attività era già presente e invariata, 1 se è stata aggiunta, 2 se è stata aggiornata, -1 in caso di errore
+int addActivity(activityIndex *index, const activityRecord *a) {
+
+  int slot = findIndexSlot(index, INDEX_SLOT_ACTIVITY, a->key);
+  int existing = (slot >= 0);
+  int oldWeek = -1;
+
+  if (existing && index->slots[slot].activity.hash == a->hash) return 0;
+
+  if (!reserveIndexSlots(index, 2)) return -1;
+
+  if (existing) {
+    oldWeek = findIndexSlot(index, INDEX_SLOT_WEEK, index->slots[slot].activity.week);
+    if (!addActivityTotals(index, &(index->slots[slot].activity), -1.0)) return -1;
+  }
+  else {
+    slot = appendIndexSlot(index, INDEX_SLOT_ACTIVITY, a->key);
+    if (slot < 0) return -1;
+    index->header.numActivities++;
+  }
+
+  int week = findIndexSlot(index, INDEX_SLOT_WEEK, a->week);
+
+  if (week < 0) {
+    week = appendIndexSlot(index, INDEX_SLOT_WEEK, a->week);
+    if (week < 0) return -1;
+  }
+
+  index->slots[slot].activity = *a;
+  if (!addActivityTotals(index, a, 1.0)) return -1;
+  updateBestEfforts(index, slot);
+
+  int ok = writeIndexSlot(index, slot) && writeIndexSlot(index, week) && (oldWeek < 0 || oldWeek == week || writeIndexSlot(index, oldWeek)) && writeIndexHeader(index);
+
+  return !ok ? -1 : existing ? 2 : 1;
+}
+
+// somma (sign = 1) o toglie (sign = -1) i valori di un'attività ai totali e alle distribuzioni dell'indice e alla sua
+// settimana. Restituisce 0, senza cambiare nulla, se la settimana non è nell'indice
+int addActivityTotals(activityIndex *index, const activityRecord *a, double sign) {
+
+  int week = findIndexSlot(index, INDEX_SLOT_WEEK, a->week);
+  if (week < 0) return 0;
+
+  indexHeader *h = &(index->header);
+  h->distance += sign * a->distance;
+  h->time += sign * a->time;
+  h->ascent += sign * a->ascent;
+  h->descent += sign * a->descent;
+
+  for (int z = 0; z < HR_ZONES; z++) h->hrZoneTime[z] += (int64_t) sign * a->hrZoneTime[z];
+  for (int e = 0; e < INDEX_ELEVATION_BANDS; e++) h->elevationDistance[e] += sign * a->elevationDistance[e];
+
+  weekBucket *w = &(index->slots[week].week);
+  w->activities += (int) sign;
+  w->distance += sign * a->distance;
+  w->time += sign * a->time;
+  w->ascent += sign * a->ascent;
+  w->descent += sign * a->descent;
+
+  // una settimana rimasta vuota riparte da zero, senza i residui degli arrotondamenti
+  if (w->activities == 0) {
+    int32_t number = w->week;
+    memset(w, 0, sizeof(weekBucket));
+    w->week = number;
+  }
+
+  return 1;
+}
+
+// migliori tempi dopo aver scritto l'attività "slot": se la migliora basta confrontarla con il migliore attuale; se
+// era lei il migliore e ora è peggiorata, il migliore va cercato tra le attività (in memoria, senza rileggere i file)
+void updateBestEfforts(activityIndex *index, int slot) {
+
+  indexHeader *h = &(index->header);
+  const activityRecord *a = &(index->slots[slot].activity);
+
+  for (int b = 0; b < INDEX_BEST_EFFORTS; b++) {
+
+    if (a->bestTime[b] > 0 && (h->bestSlot[b] < 0 || a->bestTime[b] < h->bestTime[b])) {
+      h->bestSlot[b] = slot;
+      h->bestTime[b] = a->bestTime[b];
+      continue;
+    }
+
+    if (h->bestSlot[b] != slot) continue;
+
+    h->bestSlot[b] = -1;
+    h->bestTime[b] = 0.0;
+
+    for (int i = 0; i < (int) h->numSlots; i++) {
+      const indexSlot *other = &(index->slots[i]);
+      if (other->type != INDEX_SLOT_ACTIVITY || other->activity.bestTime[b] <= 0) continue;
+
+      if (h->bestSlot[b] < 0 || other->activity.bestTime[b] < h->bestTime[b]) {
+        h->bestSlot[b] = i;
+        h->bestTime[b] = other->activity.bestTime[b];
+      }
+    }
+  }
+}
+
+// posizione dell'elemento di un tipo con una chiave (l'attività con quella chiave, la settimana con quel numero),
+// -1 se non c'è
+int findIndexSlot(const activityIndex *index, int type, uint64_t key) {
+
+  for (int i = getIndexLookupStart(type, key, index->lookupSize); index->lookup[i] >= 0; i = (i + 1) & (index->lookupSize - 1)) {
+    const indexSlot *slot = &(index->slots[index->lookup[i]]);
+    if (slot->type == (uint32_t) type && getIndexSlotKey(slot) == key) return index->lookup[i];
+  }
+
+  return -1;
+}
+
+// prima posizione in cui cercare un elemento nella tabella hash
+int getIndexLookupStart(int type, uint64_t key, int size) {
+  uint64_t hash = (key ^ (uint64_t) type) * 0x9e3779b97f4a7c15ULL;
+  return (int) (hash >> 32) & (size - 1);
+}
+
+// chiave di un elemento: quella dell'attività o il numero della settimana
+uint64_t getIndexSlotKey(const indexSlot *slot) {
+  return (slot->type == INDEX_SLOT_ACTIVITY) ? slot->activity.key : (uint64_t) slot->week.week;
+}
+
+// nuovo elemento vuoto in fondo all'indice (in memoria), con la sua chiave; restituisce la sua posizione, -1 se manca la memoria
+int appendIndexSlot(activityIndex *index, int type, uint64_t key) {
+
+  indexHeader *h = &(index->header);
+
+  if (!reserveIndexSlots(index, 1)) return -1;
+
+  indexSlot *slot = &(index->slots[h->numSlots]);
+  memset(slot, 0, sizeof(indexSlot));
+  slot->type = type;
+
+  if (type == INDEX_SLOT_ACTIVITY) slot->activity.key = key;
+  else slot->week.week = (int32_t) key;
+
+  int i = getIndexLookupStart(type, key, index->lookupSize);
+  while (index->lookup[i] >= 0) i = (i + 1) & (index->lookupSize - 1);
+  index->lookup[i] = h->numSlots;
+
+  return h->numSlots++;
+}
+
+// memoria per altri "count" elementi, nell'array e nella tabella hash; restituisce 0 se manca (l'indice resta com'era)
+int reserveIndexSlots(activityIndex *index, int count) {
+
+  int needed = (int) index->header.numSlots + count;
+
+  if (needed > index->capacity) {
+    int capacity = (index->capacity > 0) ? index->capacity : 64;
+    while (capacity < needed) capacity *= 2;
+
+    indexSlot *slots = realloc(index->slots, sizeof(indexSlot) * capacity);
+    if (slots == NULL) return 0;
+    index->slots = slots;
+    index->capacity = capacity;
+  }
+
+  if (2 * needed > index->lookupSize && !resizeIndexLookup(index, index->lookupSize * 2)) return 0;
+
+  return 1;
+}
+
+// ricostruisce la tabella hash con "size" posizioni (potenza di 2), raddoppiandola finché non è grande almeno il doppio
+// degli elementi. Restituisce 0 se manca la memoria
+int resizeIndexLookup(activityIndex *index, int size) {
+
+  while (size < 2 * (int) index->header.numSlots) size *= 2;
+
+  int *lookup = malloc(sizeof(int) * size);
+  if (lookup == NULL) return 0;
+
+  free(index->lookup);
+  index->lookup = lookup;
+  index->lookupSize = size;
+
+  for (int i = 0; i < size; i++) lookup[i] = -1;
+
+  for (int s = 0; s < (int) index->header.numSlots; s++) {
+    const indexSlot *slot = &(index->slots[s]);
+    int i = getIndexLookupStart(slot->type, getIndexSlotKey(slot), size);
+    while (lookup[i] >= 0) i = (i + 1) & (size - 1);
+    lookup[i] = s;
+  }
+
+  return 1;
+}
+
+// scrive un elemento al suo posto nel file dell'indice
+int writeIndexSlot(const activityIndex *index, int slot) {
+  off_t offset = sizeof(indexHeader) + (off_t) slot * sizeof(indexSlot);
+  return pwrite(index->fd, &(index->slots[slot]), sizeof(indexSlot), offset) == sizeof(indexSlot);
+}
+
+// scrive l'intestazione del file dell'indice
+int writeIndexHeader(const activityIndex *index) {
+  return pwrite(index->fd, &(index->header), sizeof(indexHeader), 0) == sizeof(indexHeader);
+}
+
+// ordinamento delle settimane (per qsort())
+int compareIndexWeeks(const void *a, const void *b) {
+  const weekBucket *x = *(const weekBucket * const *) a;
+  const weekBucket *y = *(const weekBucket * const *) b;
+  return (x->week > y->week) - (x->week < y->week);
+}
+
+// riepilogo dell'indice: totali, settimane, migliori tempi e distribuzioni della distanza per quota e del tempo per
+// zona cardiaca. Con --format=json|ndjson un unico oggetto JSON
+void printIndexReport(const jobConfig *job, const activityIndex *index, const char *path) {
+
+  const indexHeader *h = &(index->header);
+
+  // settimane con almeno un'attività, in ordine
+  const weekBucket **weeks = malloc(sizeof(weekBucket*) * (h->numSlots > 0 ? h->numSlots : 1));
+  int numWeeks = 0;
+
+  for (int i = 0; i < (int) h->numSlots; i++) {
+    if (index->slots[i].type == INDEX_SLOT_WEEK && index->slots[i].week.activities > 0) weeks[numWeeks++] = &(index->slots[i].week);
+  }
+
+  qsort(weeks, numWeeks, sizeof(weekBucket*), compareIndexWeeks);
+
+  if (job->format != FORMAT_TEXT) {
+    textBuffer *b = &_RECORD_BUFFER_;
+    if (b->data == NULL) initTextBuffer(b, 4096);
+
+    appendJsonIndex(b, index, weeks, numWeeks);
+    appendChar(b, '\n');
+    flushTextBuffer(b, job->out);
+
+    free(weeks);
+    return;
+  }
+
+  struct tm totalTime = seconds2tm(h->time);
+
+  fprintf(job->out, "\n[ Indice delle attività <%s>: %u attività ]\n\n", path, h->numActivities);
+  fprintf(job->out, "* Distanza (Km):\t\t%8.2lf\n", h->distance / 1000.0);
+  fprintf(job->out, "* Tempo (h:m:s):\t\t%02d:%02d:%02d\n", totalTime.tm_hour, totalTime.tm_min, totalTime.tm_sec);
+  fprintf(job->out, "* Dislivello in salita (m):\t%8.0lf\n", h->ascent);
+  fprintf(job->out, "* Dislivello in discesa (m):\t%8.0lf\n\n", h->descent);
+
+  if (numWeeks > 0) {
+    fprintf(job->out, "[ Settimane ]\n\n");
+    fprintf(job->out, "%-12s %9s %14s %12s %12s\n", "settimana", "attività", "distanza (Km)", "salita (m)", "tempo (h:m)");
+
+    for (int w = 0; w < numWeeks; w++) {
+      char name[16];
+      if (weeks[w]->week == 0) strcpy(name, "senza data");
+      else sprintf(name, "%04d-W%02d", weeks[w]->week / 100, weeks[w]->week % 100);
+
+      struct tm time = seconds2tm(weeks[w]->time);
+      fprintf(job->out, "%-12s %8d %14.2lf %12.0lf %9d:%02d\n", name, weeks[w]->activities, weeks[w]->distance / 1000.0, weeks[w]->ascent, time.tm_hour, time.tm_min);
+    }
+
+    fprintf(job->out, "\n");
+  }
+
+  const double distances[] = INDEX_BEST_EFFORT_DISTANCES;
+  const char *names[] = INDEX_BEST_EFFORT_NAMES;
+
+  fprintf(job->out, "[ Migliori tempi ]\n\n");
+
+  for (int b = 0; b < INDEX_BEST_EFFORTS; b++) {
+    if (h->bestSlot[b] < 0) continue;
+
+    const activityRecord *a = &(index->slots[h->bestSlot[b]].activity);
+    struct tm time = seconds2tm(h->bestTime[b]);
+
+    time_t start = a->start / 1000;
+    struct tm day;
+    gmtime_r(&start, &day);
+
+    fprintf(job->out, "* %-16s %02d:%02d:%02d %6.2lf Km/h  %02d/%02d/%04d  %s\n", names[b], time.tm_hour, time.tm_min, time.tm_sec,
+            getAvgSpeed(distances[b], h->bestTime[b]), day.tm_mday, day.tm_mon + 1, day.tm_year + 1900, a->name);
+  }
+
+  // distribuzione della distanza per quota, dalla fascia più bassa alla più alta percorsa
+  double totalDistance = 0.0;
+  int lowest = -1, highest = -1;
+
+  for (int e = 0; e < INDEX_ELEVATION_BANDS; e++) {
+    if (h->elevationDistance[e] < 0.5) continue;
+    if (lowest < 0) lowest = e;
+    highest = e;
+    totalDistance += h->elevationDistance[e];
+  }
+
+  if (lowest >= 0) {
+    fprintf(job->out, "\n* Distanza per fascia di quota:\n");
+
+    for (int e = lowest; e <= highest; e++) {
+      int bar = (int) (h->elevationDistance[e] * 40 / totalDistance);
+      char bars[41];
+      memset(bars, ALTIGRAPH_FILL_CHAR, bar);
+      bars[bar] = '\0';
+
+      fprintf(job->out, "  %4d-%4d m:\t%8.2lf Km %5.1lf%% %s\n", e * INDEX_ELEVATION_BAND, (e + 1) * INDEX_ELEVATION_BAND,
+              h->elevationDistance[e] / 1000.0, 100.0 * h->elevationDistance[e] / totalDistance, bars);
+    }
+  }
+
+  int64_t zoneTotal = 0;
+  for (int z = 0; z < HR_ZONES; z++) zoneTotal += h->hrZoneTime[z];
+
+  if (zoneTotal > 0) {
+    fprintf(job->out, "\n");
+    printHrZones(job, h->hrZoneTime);
+  }
+
+  fprintf(job->out, "\n");
+  free(weeks);
+}
+
+// oggetto JSON del riepilogo dell'indice (su una sola riga)
+void appendJsonIndex(textBuffer *b, const activityIndex *index, const weekBucket **weeks, int numWeeks) {
+
+  const indexHeader *h = &(index->header);
+  const double distances[] = INDEX_BEST_EFFORT_DISTANCES;
+
+  appendString(b, "{\"type\":\"index\"");
+  appendJsonField(b, "activities");
+  appendInt(b, h->numActivities);
+  appendJsonField(b, "distance_m");
+  appendJsonNumber(b, h->distance);
+  appendJsonField(b, "time_s");
+  appendJsonNumber(b, h->time);
+  appendJsonField(b, "ascent_m");
+  appendJsonNumber(b, h->ascent);
+  appendJsonField(b, "descent_m");
+  appendJsonNumber(b, h->descent);
+
+  // settimane: "week" è null per le attività senza tempi
+  appendJsonField(b, "weeks");
+  appendChar(b, '[');
+
+  for (int w = 0; w < numWeeks; w++) {
+    if (w > 0) appendChar(b, ',');
+
+    appendString(b, "{\"week\":");
+    if (weeks[w]->week == 0) {
+      appendString(b, "null");
+    } else {
+      char name[16];
+      sprintf(name, "%04d-W%02d", weeks[w]->week / 100, weeks[w]->week % 100);
+      appendJsonString(b, name);
+    }
+
+    appendJsonField(b, "activities");
+    appendInt(b, weeks[w]->activities);
+    appendJsonField(b, "distance_m");
+    appendJsonNumber(b, weeks[w]->distance);
+    appendJsonField(b, "time_s");
+    appendJsonNumber(b, weeks[w]->time);
+    appendJsonField(b, "ascent_m");
+    appendJsonNumber(b, weeks[w]->ascent);
+    appendJsonField(b, "descent_m");
+    appendJsonNumber(b, weeks[w]->descent);
+    appendChar(b, '}');
+  }
+
+  appendChar(b, ']');
+
+  // migliori tempi, con il file e la traccia che li hanno ottenuti
+  appendJsonField(b, "best_efforts");
+  appendChar(b, '[');
+
+  int first = 1;
+
+  for (int e = 0; e < INDEX_BEST_EFFORTS; e++) {
+    if (h->bestSlot[e] < 0) continue;
+
+    const activityRecord *a = &(index->slots[h->bestSlot[e]].activity);
+
+    if (!first) appendChar(b, ',');
+    first = 0;
+
+    appendString(b, "{\"distance_m\":");
+    appendJsonNumber(b, distances[e]);
+    appendJsonField(b, "time_s");
+    appendJsonNumber(b, h->bestTime[e]);
+    appendJsonField(b, "file");
+    appendJsonString(b, a->file);
+    appendJsonField(b, "track");
+    appendJsonString(b, a->name);
+    appendJsonField(b, "start");
+    appendInt(b, a->start / 1000);
+    appendChar(b, '}');
+  }
+
+  appendChar(b, ']');
+
+  appendJsonField(b, "elevation_band_m");
+  appendInt(b, INDEX_ELEVATION_BAND);
+  appendJsonArray(b, "elevation_distance_m", h->elevationDistance, INDEX_ELEVATION_BANDS);
+
+  double zones[HR_ZONES];
+  for (int z = 0; z < HR_ZONES; z++) zones[z] = h->hrZoneTime[z] / 1000.0;
+  appendJsonArray(b, "hr_zones_s", zones, HR_ZONES);
+
+  appendChar(b, '}');
+}
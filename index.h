@@ -0,0 +1,119 @@
+// GPSReader: indice delle attività di un atleta (--index): totali settimanali, migliori tempi e distribuzioni,
+// aggiornati senza rileggere i file già indicizzati
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "gpsreader.h"
+#include "cache.h"
+
+// indice delle attività (--index): identificativo e versione del formato, caratteri conservati del nome del file,
+// tipi di elemento, fasce di quota (m) della distribuzione e distanze (m) dei migliori tempi
+#define INDEX_MAGIC "GPSI"
+#define INDEX_VERSION 1
+#define INDEX_FILE_SIZE 128
+#define INDEX_SLOT_ACTIVITY 1
+#define INDEX_SLOT_WEEK 2
+#define INDEX_ELEVATION_BAND 100
+#define INDEX_ELEVATION_BANDS 40
+#define INDEX_BEST_EFFORTS 5
+#define INDEX_BEST_EFFORT_DISTANCES { 1000.0, 5000.0, 10000.0, 21097.5, 42195.0 }
+#define INDEX_BEST_EFFORT_NAMES { "1 Km", "5 Km", "10 Km", "Mezza maratona", "Maratona" }
+
+// attività dell'indice (una traccia di un file GPX): le metriche della traccia e quanto serve per aggiornare settimane,
+// migliori tempi e distribuzioni senza rileggere il file. Scritta nel file dell'indice così com'è in memoria
+typedef struct {
+  uint64_t key;                                     // hash del percorso del file e del numero della traccia
+  uint64_t hash;                                    // hash del contenuto del file e delle impostazioni che cambiano le metriche
+  int64_t start;                                    // istante del primo punto (ms), 0 se la traccia non ha tempi
+  int32_t week;                                     // settimana ISO (anno * 100 + settimana), 0 se la traccia non ha tempi
+  int32_t track;
+  char file[INDEX_FILE_SIZE];                       // ultimi caratteri del percorso del file
+  char name[TRACK_NAME_SIZE];
+  double distance;
+  double time;
+  double ascent;
+  double descent;
+  double maxElevation;
+  double minElevation;
+  int64_t hrZoneTime[HR_ZONES];                     // ms in ogni zona cardiaca
+  double elevationDistance[INDEX_ELEVATION_BANDS];  // m percorsi in ogni fascia di quota
+  double bestTime[INDEX_BEST_EFFORTS];              // s per ciascuna distanza, 0 se la traccia è più corta o senza tempi
+} activityRecord;
+
+// totali di una settimana dell'indice
+typedef struct {
+  int32_t week;
+  int32_t activities;
+  double distance;
+  double time;
+  double ascent;
+  double descent;
+} weekBucket;
+
+// elemento del file dell'indice: un'attività o una settimana. Gli elementi hanno tutti la stessa dimensione, così
+// ciascuno può essere riscritto al suo posto
+typedef struct {
+  uint32_t type;                                    // INDEX_SLOT_ACTIVITY o INDEX_SLOT_WEEK
+  uint32_t unused;
+  union {
+    activityRecord activity;
+    weekBucket week;
+  };
+} indexSlot;
+
+// intestazione del file dell'indice, seguita dagli elementi: totali, distribuzioni e migliori tempi di tutte le attività
+typedef struct {
+  char magic[4];                                    // INDEX_MAGIC
+  uint32_t version;                                 // INDEX_VERSION
+  uint32_t slotSize;                                // sizeof(indexSlot)
+  uint32_t numSlots;
+  uint32_t numActivities;
+  int32_t bestSlot[INDEX_BEST_EFFORTS];             // attività con il miglior tempo di ciascuna distanza, -1 se nessuna
+  double distance;
+  double time;
+  double ascent;
+  double descent;
+  int64_t hrZoneTime[HR_ZONES];
+  double elevationDistance[INDEX_ELEVATION_BANDS];
+  double bestTime[INDEX_BEST_EFFORTS];
+} indexHeader;
+
+// indice delle attività di un atleta, aperto: il file (bloccato per l'uso esclusivo) e una copia dei suoi elementi in
+// memoria, con una tabella hash per cercare attività e settimane. Il mutex serializza gli aggiornamenti dei thread del batch
+typedef struct activityIndex {
+  int fd;
+  indexHeader header;
+  int capacity;
+  indexSlot *slots;
+  int *lookup;                // posizioni degli elementi per chiave (indirizzamento aperto), -1 = libera
+  int lookupSize;             // potenza di 2, almeno il doppio degli elementi
+  pthread_mutex_t mutex;
+} activityIndex;
+
+// global variable con il file dell'indice delle attività (NULL = nessun indice)
+extern const char *_INDEX_;
+
+int indexFile(const jobConfig *job, const char *filename);
+int getTrackActivities(const jobConfig *job, const char *filename, const trackCache *cache, uint64_t hash, activityRecord **activities);
+int getIsoWeek(int64_t time);
+int openActivityIndex(activityIndex *index, const char *path);
+int isValidActivityIndex(const activityIndex *index);
+void closeActivityIndex(activityIndex *index);
+int addActivity(activityIndex *index, const activityRecord *a);
+int addActivityTotals(activityIndex *index, const activityRecord *a, double sign);
+void updateBestEfforts(activityIndex *index, int slot);
+int findIndexSlot(const activityIndex *index, int type, uint64_t key);
+int appendIndexSlot(activityIndex *index, int type, uint64_t key);
+int reserveIndexSlots(activityIndex *index, int count);
+uint64_t getIndexSlotKey(const indexSlot *slot);
+int getIndexLookupStart(int type, uint64_t key, int size);
+int resizeIndexLookup(activityIndex *index, int size);
+int writeIndexSlot(const activityIndex *index, int slot);
+int writeIndexHeader(const activityIndex *index);
+int compareIndexWeeks(const void *a, const void *b);
+void printIndexReport(const jobConfig *job, const activityIndex *index, const char *path);
+void appendJsonIndex(textBuffer *b, const activityIndex *index, const weekBucket **weeks, int numWeeks);
+
+#endif
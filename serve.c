@@ -0,0 +1,678 @@
+// GPSReader: server delle richieste di elaborazione su un socket Unix (--serve), con un pool di thread, e client
+// che gli invia un file (--client)
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+// memmem()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serve.h"
+
+// global variable con il socket Unix su cui --serve accetta le richieste (NULL = modalità non attiva)
+const char *_SERVE_ = NULL;
+
+// global variable con il numero massimo di richieste in attesa di un thread in --serve
+int _SERVE_QUEUE_ = SERVE_QUEUE;
+
+// global variable impostata da SIGINT/SIGTERM per terminare --serve
+volatile sig_atomic_t _SERVE_STOP_ = 0;
+
+// global variable con il socket del server a cui --client invia la richiesta (NULL = modalità non attiva)
+const char *_CLIENT_ = NULL;
+
+// global variable: 1 = --client invia il percorso del file invece del suo contenuto
+int _CLIENT_PATH_ = 0;
+
+// modalità --serve: il processo resta attivo e accetta le richieste su un socket Unix, elaborandole su un pool di thread
+// (tanti quanti i core, se numThreads è 0) con le impostazioni della riga di comando. Parser e buffer dei thread (e
+// l'arena, con --arena) restano inizializzati da una richiesta all'altra, quindi una richiesta costa solo l'elaborazione del file. Termina
+// con Ctrl+C (o SIGTERM), dopo aver risposto alle richieste già accettate, e stampa i contatori e le latenze
+int serveRequests(const jobConfig *config, const char *path, int numThreads) {
+
+  serverState s;
+
+  if (!openServer(&s, config, path, numThreads, _SERVE_QUEUE_)) {
+    fprintf(getMessageStream(config), "Impossibile aprire il socket \"%s\"\n", path);
+    return 1;
+  }
+
+  // SIGINT e SIGTERM interrompono l'attesa delle connessioni; una risposta a un client che ha chiuso non deve
+  // terminare il processo
+  struct sigaction action, prevInt, prevTerm;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stopServer;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, &prevInt);
+  sigaction(SIGTERM, &action, &prevTerm);
+  signal(SIGPIPE, SIG_IGN);
+  _SERVE_STOP_ = 0;
+
+  fprintf(getMessageStream(config), "[ Server in ascolto su <%s>: %d thread, al più %d richieste in attesa; Ctrl+C per terminare ]\n", path, s.numThreads, s.queueSize);
+  fflush(getMessageStream(config));
+
+  runServer(&s);
+
+  sigaction(SIGINT, &prevInt, NULL);
+  sigaction(SIGTERM, &prevTerm, NULL);
+
+  closeServer(&s);
+  printServerStats(&s, getMessageStream(config));
+
+  pthread_mutex_destroy(&s.mutex);
+  pthread_cond_destroy(&s.available);
+  free(s.queue);
+  free(s.threads);
+
+  return 0;
+}
+
+// crea il socket Unix in ascolto su "path" (sostituendo un socket rimasto da un'esecuzione precedente) e avvia i thread;
+// restituisce 0 in caso di errore
+int openServer(serverState *s, const jobConfig *config, const char *path, int numThreads, int queueSize) {
+
+  memset(s, 0, sizeof(serverState));
+  s->config = config;
+  s->path = path;
+  s->numThreads = (numThreads > 0) ? numThreads : getNumCores();
+  s->queueSize = queueSize;
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) return 0;
+  strcpy(address.sun_path, path);
+
+  // un file che non è un socket non viene toccato
+  struct stat info;
+  if (lstat(path, &info) == 0) {
+    if (!S_ISSOCK(info.st_mode)) return 0;
+    unlink(path);
+  }
+
+  s->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s->fd < 0) return 0;
+
+  if (bind(s->fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(s->fd, queueSize) != 0) {
+    close(s->fd);
+    return 0;
+  }
+
+  s->queue = malloc(sizeof(serverConnection) * queueSize);
+  s->threads = malloc(sizeof(pthread_t) * s->numThreads);
+  pthread_mutex_init(&s->mutex, NULL);
+  pthread_cond_init(&s->available, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &s->start);
+
+  for (int t = 0; t < s->numThreads; t++) {
+    pthread_create(&s->threads[t], NULL, serverWorker, s);
+  }
+
+  return 1;
+}
+
+// accetta le connessioni fino a SIGINT/SIGTERM (_SERVE_STOP_) e le mette in coda per i thread; se la coda è piena la
+// connessione riceve subito la risposta BUSY, così il client non aspetta un thread che non si libererà in tempo
+void runServer(serverState *s) {
+
+  struct pollfd listening = { s->fd, POLLIN, 0 };
+
+  while (!_SERVE_STOP_) {
+
+    // attesa limitata, per controllare periodicamente _SERVE_STOP_
+    if (poll(&listening, 1, 200) <= 0) continue;
+
+    int fd = accept(s->fd, NULL, NULL);
+    if (fd < 0) continue;
+
+    struct timeval timeout = { SERVE_TIMEOUT, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    pthread_mutex_lock(&s->mutex);
+
+    if (s->waiting == s->queueSize) {
+      s->rejected++;
+      pthread_mutex_unlock(&s->mutex);
+
+      char message[64];
+      int length = snprintf(message, sizeof(message), "Server occupato: %d richieste in attesa\n", s->queueSize);
+      sendResponse(fd, "BUSY", message, length);
+      close(fd);
+      continue;
+    }
+
+    serverConnection *c = &s->queue[(s->head + s->waiting) % s->queueSize];
+    c->fd = fd;
+    clock_gettime(CLOCK_MONOTONIC, &c->accepted);
+    s->waiting++;
+
+    pthread_cond_signal(&s->available);
+    pthread_mutex_unlock(&s->mutex);
+  }
+}
+
+// ferma i thread dopo che hanno risposto alle connessioni in coda, poi chiude e rimuove il socket
+void closeServer(serverState *s) {
+
+  pthread_mutex_lock(&s->mutex);
+  s->stopping = 1;
+  pthread_cond_broadcast(&s->available);
+  pthread_mutex_unlock(&s->mutex);
+
+  for (int t = 0; t < s->numThreads; t++) {
+    pthread_join(s->threads[t], NULL);
+  }
+
+  close(s->fd);
+  unlink(s->path);
+}
+
+// thread del server: prende la prima connessione in coda, elabora la richiesta e registra le latenze. Il buffer delle
+// richieste (come l'arena e il buffer dei record) appartiene al thread ed è riusato per tutte le richieste
+void *serverWorker(void *arg) {
+
+  serverState *s = arg;
+
+  size_t capacity = SERVE_MAX_HEADER;
+  char *buffer = malloc(capacity);
+
+  for (;;) {
+    pthread_mutex_lock(&s->mutex);
+    while (s->waiting == 0 && !s->stopping) {
+      pthread_cond_wait(&s->available, &s->mutex);
+    }
+
+    if (s->waiting == 0) {
+      pthread_mutex_unlock(&s->mutex);
+      break;
+    }
+
+    serverConnection c = s->queue[s->head];
+    s->head = (s->head + 1) % s->queueSize;
+    s->waiting--;
+    s->running++;
+    pthread_mutex_unlock(&s->mutex);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int ret = handleServerRequest(s, c.fd, &buffer, &capacity);
+    close(c.fd);
+
+    double service = getElapsedSeconds(&start);
+    double total = getElapsedSeconds(&c.accepted);
+
+    pthread_mutex_lock(&s->mutex);
+    s->running--;
+    if (ret == 0) s->completed++;
+    else s->failed++;
+    addLatency(&s->queueTime, total - service);
+    addLatency(&s->serviceTime, service);
+    addLatency(&s->totalTime, total);
+    pthread_mutex_unlock(&s->mutex);
+  }
+
+  free(buffer);
+  mergeThreadStats();
+  releaseArena();
+  releaseRecordBuffer();
+  return NULL;
+}
+
+// legge una richiesta dalla connessione e invia la risposta; restituisce 0 se la richiesta è stata elaborata.
+//
+// Richiesta: una riga con il comando, le opzioni della richiesta (una per riga, nella forma della riga di comando),
+// una riga vuota e, per GPX, il contenuto del file:
+//   GPX <byte> [nome]    elabora i <byte> che seguono la riga vuota; [nome] è il nome del file nell'output
+//   FILE <percorso>      elabora un file del server
+//   STATS                contatori e latenze del server
+// Risposta: una riga "<OK|ERROR|BUSY> <byte>" e i <byte> dell'output (o dei messaggi di errore)
+int handleServerRequest(serverState *s, int fd, char **buffer, size_t *capacity) {
+
+  // intestazione: fino alla prima riga vuota; i byte letti oltre sono l'inizio del contenuto GPX
+  size_t received = 0;
+  char *headerEnd = NULL;
+
+  while (headerEnd == NULL) {
+    if (received == SERVE_MAX_HEADER) {
+      const char *message = "Intestazione della richiesta troppo lunga\n";
+      sendResponse(fd, "ERROR", message, strlen(message));
+      return 1;
+    }
+
+    ssize_t n = recv(fd, *buffer + received, SERVE_MAX_HEADER - received, 0);
+    if (n <= 0) return 1;
+
+    received += n;
+    headerEnd = memmem(*buffer, received, "\n\n", 2);
+  }
+
+  // l'intestazione è copiata, perché il buffer può essere riallocato per il contenuto
+  size_t headerSize = headerEnd - *buffer + 2;
+  char header[SERVE_MAX_HEADER + 1];
+  memcpy(header, *buffer, headerSize);
+  header[headerSize - 1] = '\0';
+
+  char *line = header;
+  char *next = strchr(line, '\n');
+  *next = '\0';
+  next++;
+
+  jobConfig job = *(s->config);
+  const char *name = NULL;
+  const char *path = NULL;
+  size_t payloadSize = 0;
+
+  if (strcmp(line, "STATS") == 0) {
+    char *body = NULL;
+    size_t bodySize = 0;
+    FILE *out = open_memstream(&body, &bodySize);
+    printServerStats(s, out);
+    fclose(out);
+
+    int ret = sendResponse(fd, "OK", body, bodySize);
+    free(body);
+    return ret;
+  }
+
+  if (strncmp(line, "GPX ", 4) == 0) {
+    char *end;
+    unsigned long long size = strtoull(line + 4, &end, 10);
+    if (end == line + 4 || (*end != ' ' && *end != '\0') || size == 0 || size > SERVE_MAX_PAYLOAD) {
+      const char *message = "Dimensione del contenuto GPX non valida\n";
+      sendResponse(fd, "ERROR", message, strlen(message));
+      return 1;
+    }
+    payloadSize = size;
+    name = (*end == ' ' && end[1] != '\0') ? end + 1 : "-";
+  } else if (strncmp(line, "FILE ", 5) == 0 && line[5] != '\0') {
+    path = line + 5;
+  } else {
+    const char *message = "Richiesta non valida: i comandi sono GPX, FILE e STATS\n";
+    sendResponse(fd, "ERROR", message, strlen(message));
+    return 1;
+  }
+
+  // opzioni della richiesta, sulle impostazioni del server
+  for (line = next; *line != '\0'; line = next) {
+    next = strchr(line, '\n');
+    if (next != NULL) *next++ = '\0';
+    else next = line + strlen(line);
+
+    if (!parseRequestOption(line, &job)) {
+      char message[SERVE_MAX_HEADER + 64];
+      int length = snprintf(message, sizeof(message), "Opzione non valida per una richiesta: %s\n", line);
+      sendResponse(fd, "ERROR", message, length);
+      return 1;
+    }
+  }
+
+  // contenuto GPX: i byte già ricevuti con l'intestazione sono spostati all'inizio del buffer
+  if (path == NULL) {
+    if (payloadSize > *capacity) {
+      char *grown = realloc(*buffer, payloadSize);
+      if (grown == NULL) {
+        const char *message = "Memoria insufficiente per il contenuto GPX\n";
+        sendResponse(fd, "ERROR", message, strlen(message));
+        return 1;
+      }
+      *buffer = grown;
+      *capacity = payloadSize;
+    }
+
+    size_t available = received - headerSize;
+    if (available > payloadSize) available = payloadSize;
+    memmove(*buffer, *buffer + headerSize, available);
+
+    if (!readFully(fd, *buffer + available, payloadSize - available)) return 1;
+  }
+
+  // output e messaggi della richiesta in memoria: nei formati diversi dal testo i messaggi sono separati dall'output
+  char *output = NULL, *messages = NULL;
+  size_t outputSize = 0, messagesSize = 0;
+
+  job.out = open_memstream(&output, &outputSize);
+  job.messages = (job.format != FORMAT_TEXT) ? open_memstream(&messages, &messagesSize) : NULL;
+
+  printOutputBegin(&job, job.out);
+
+  // gli errori di libxml2 (ad es. di un file malformato) vanno nella risposta, come gli altri messaggi, e non sullo
+  // standard error del server: la funzione degli errori è del thread
+  xmlSetGenericErrorFunc(getMessageStream(&job), NULL);
+
+  int ret;
+  if (path != NULL) {
+    if (fileExists(path)) {
+      ret = processFile(&job, path);
+    } else {
+      fprintf(getMessageStream(&job), "File non trovato: \"%s\"\n", path);
+      ret = 1;
+    }
+  } else {
+    ret = processRequestData(&job, name, *buffer, payloadSize);
+  }
+
+  xmlSetGenericErrorFunc(NULL, NULL);
+
+  printOutputEnd(&job, job.out);
+
+  fclose(job.out);
+  if (job.messages != NULL) fclose(job.messages);
+
+  int sent = (ret != 0 && messagesSize > 0) ? sendResponse(fd, "ERROR", messages, messagesSize) :
+                                              sendResponse(fd, (ret == 0) ? "OK" : "ERROR", output, outputSize);
+  free(output);
+  free(messages);
+
+  return (ret != 0 || sent != 0) ? 1 : 0;
+}
+
+// 1 se l'opzione si può indicare in una richiesta: quelle che cambiano solo l'output e le metriche del file, oltre
+// alle dimensioni del grafico (--width=N, --height=N). Modalità di lettura, cache e modello delle distanze sono del server
+int isRequestOption(const char *option) {
+
+  static const char *options[] = {
+    "--format=", "--chart=", "--chart-x=", "--series", "--efforts", "--hr-max=", "--downsample=",
+    "--smooth=", "--hysteresis=", "--resample=", "--width=", "--height="
+  };
+
+  for (int i = 0; i < (int) (sizeof(options) / sizeof(options[0])); i++) {
+    if (strncmp(option, options[i], strlen(options[i])) == 0) return 1;
+  }
+
+  return 0;
+}
+
+// applica un'opzione della richiesta alle impostazioni di un'elaborazione; restituisce 0 se l'opzione non è ammessa.
+// Le dimensioni del grafico sono limitate a SERVE_MAX_CHART: un client non deve poter esaurire la memoria di un thread
+int parseRequestOption(const char *option, jobConfig *job) {
+
+  if (!isRequestOption(option)) return 0;
+
+  if (strncmp(option, "--width=", 8) == 0) {
+    job->altigraphSize.cols = atoi(option + 8);
+    return (job->altigraphSize.cols > 0 && job->altigraphSize.cols <= SERVE_MAX_CHART);
+  }
+
+  if (strncmp(option, "--height=", 9) == 0) {
+    job->altigraphSize.rows = atoi(option + 9);
+    return (job->altigraphSize.rows > 0 && job->altigraphSize.rows <= SERVE_MAX_CHART);
+  }
+
+  return parseOption(option, job);
+}
+
+// elabora il contenuto GPX di una richiesta di --serve con il tokenizer della modalità mmap (il documento è già in
+// memoria); come processFile(), con --arena tutta la memoria dell'elaborazione viene recuperata alla fine
+int processRequestData(const jobConfig *job, const char *name, const char *data, size_t size) {
+
+  _FILE_RECORDS_ = 0;
+
+  if (job->arena && !_ARENA_.active) {
+    _ARENA_.active = 1;
+    int ret = processRequestData(job, name, data, size);
+    resetArena();
+    return ret;
+  }
+
+  return processGpxBuffer(job, name, data, size);
+}
+
+// invia una risposta di --serve: la riga di stato e il corpo. Restituisce 0, o 1 se il client ha chiuso la connessione
+int sendResponse(int fd, const char *status, const char *body, size_t size) {
+
+  char line[64];
+  int length = snprintf(line, sizeof(line), "%s %zu\n", status, size);
+
+  return (writeFully(fd, line, length) && writeFully(fd, body, size)) ? 0 : 1;
+}
+
+// legge esattamente "size" byte da un socket; restituisce 0 se la connessione si chiude prima (o scade)
+int readFully(int fd, char *buffer, size_t size) {
+
+  while (size > 0) {
+    ssize_t n = recv(fd, buffer, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    buffer += n;
+    size -= n;
+  }
+
+  return 1;
+}
+
+// scrive esattamente "size" byte su un socket (senza SIGPIPE se il destinatario ha chiuso); restituisce 0 in caso di errore
+int writeFully(int fd, const char *buffer, size_t size) {
+
+  while (size > 0) {
+    ssize_t n = send(fd, buffer, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    buffer += n;
+    size -= n;
+  }
+
+  return 1;
+}
+
+// aggiunge una latenza (s) all'istogramma
+void addLatency(latencyHistogram *h, double seconds) {
+
+  int bucket = 0;
+  double limit = SERVE_LATENCY_MIN;
+
+  while (bucket < SERVE_LATENCY_BUCKETS - 1 && seconds > limit) {
+    bucket++;
+    limit *= 2;
+  }
+
+  h->count[bucket]++;
+  h->total++;
+  h->sum += seconds;
+  if (seconds > h->max) h->max = seconds;
+}
+
+// percentile (p tra 0 e 1) di un istogramma: il limite superiore della fascia che lo contiene (s), al più la latenza massima
+double getLatencyPercentile(const latencyHistogram *h, double p) {
+
+  if (h->total == 0) return 0.0;
+
+  long rank = (long) ceil(p * h->total);
+  long seen = 0;
+  double limit = SERVE_LATENCY_MIN;
+
+  for (int b = 0; b < SERVE_LATENCY_BUCKETS; b++, limit *= 2) {
+    seen += h->count[b];
+    if (seen >= rank) return fmin(limit, h->max);
+  }
+
+  return h->max;
+}
+
+// contatori del server e istogrammi delle latenze (attesa in coda, elaborazione, totale), con media e percentili
+void printServerStats(serverState *s, FILE *out) {
+
+  pthread_mutex_lock(&s->mutex);
+  long completed = s->completed, failed = s->failed, rejected = s->rejected;
+  int waiting = s->waiting, running = s->running;
+  latencyHistogram h[3] = { s->queueTime, s->serviceTime, s->totalTime };
+  pthread_mutex_unlock(&s->mutex);
+
+  double elapsed = getElapsedSeconds(&s->start);
+
+  fprintf(out, "\n[ Server <%s>: %.1lf s, %d thread, %ld richieste (%.1lf/s) ]\n\n", s->path, elapsed, s->numThreads,
+          completed + failed, (elapsed > 0) ? (completed + failed) / elapsed : 0.0);
+  fprintf(out, "completate %ld, con errori %ld, rifiutate %ld, in attesa %d, in elaborazione %d\n", completed, failed, rejected, waiting, running);
+
+  if (h[2].total == 0) return;
+
+  // solo le fasce dalla prima all'ultima con almeno una richiesta
+  int first = SERVE_LATENCY_BUCKETS, last = 0;
+  for (int b = 0; b < SERVE_LATENCY_BUCKETS; b++) {
+    for (int k = 0; k < 3; k++) {
+      if (h[k].count[b] == 0) continue;
+      if (b < first) first = b;
+      if (b > last) last = b;
+    }
+  }
+
+  fprintf(out, "\n%-16s %12s %12s %12s\n", "latenza (ms)", "attesa", "elaborazione", "totale");
+
+  for (int b = first; b <= last; b++) {
+    char label[32];
+    if (b == SERVE_LATENCY_BUCKETS - 1) snprintf(label, sizeof(label), "oltre %.3lf", SERVE_LATENCY_MIN * pow(2, b - 1) * 1000.0);
+    else snprintf(label, sizeof(label), "fino a %.3lf", SERVE_LATENCY_MIN * pow(2, b) * 1000.0);
+
+    fprintf(out, "%-16s %12ld %12ld %12ld\n", label, h[0].count[b], h[1].count[b], h[2].count[b]);
+  }
+
+  fprintf(out, "%-16s %12.3lf %12.3lf %12.3lf\n", "media", h[0].sum * 1000.0 / h[0].total, h[1].sum * 1000.0 / h[1].total, h[2].sum * 1000.0 / h[2].total);
+
+  const char *names[] = { "p50", "p90", "p99" };
+  double percentiles[] = { 0.5, 0.9, 0.99 };
+
+  for (int p = 0; p < 3; p++) {
+    fprintf(out, "%-16s %12.3lf %12.3lf %12.3lf\n", names[p], getLatencyPercentile(&h[0], percentiles[p]) * 1000.0,
+            getLatencyPercentile(&h[1], percentiles[p]) * 1000.0, getLatencyPercentile(&h[2], percentiles[p]) * 1000.0);
+  }
+
+  fprintf(out, "%-16s %12.3lf %12.3lf %12.3lf\n", "massima", h[0].max * 1000.0, h[1].max * 1000.0, h[2].max * 1000.0);
+}
+
+// gestore di SIGINT e SIGTERM durante --serve
+void stopServer(int signum) {
+  (void) signum;
+  _SERVE_STOP_ = 1;
+}
+
+// modalità --client, per provare il server in locale: invia il contenuto del file (o con --client-path il suo percorso
+// assoluto, che il server legge direttamente) con le opzioni della riga di comando che valgono per una richiesta e le
+// dimensioni del grafico, se indicate; senza file chiede i contatori e le latenze del server. Stampa la risposta
+int runClient(const jobConfig *config, const char *path, const char *filename, int argc, char *argv[], int width, int height) {
+
+  char *header = NULL;
+  size_t headerSize = 0;
+  char *payload = NULL;
+  size_t payloadSize = 0;
+
+  FILE *h = open_memstream(&header, &headerSize);
+
+  if (filename == NULL) {
+    fputs("STATS\n", h);
+  } else if (_CLIENT_PATH_) {
+    char *absolute = realpath(filename, NULL);
+    fprintf(h, "FILE %s\n", (absolute != NULL) ? absolute : filename);
+    free(absolute);
+  } else {
+    payload = readFileContents(filename, &payloadSize);
+    if (payload == NULL) {
+      fclose(h);
+      free(header);
+      fprintf(getMessageStream(config), "Errore nella lettura del file \"%s\"\n", filename);
+      return 1;
+    }
+    fprintf(h, "GPX %zu %s\n", payloadSize, filename);
+  }
+
+  for (int i = 1; i < argc; i++) {
+    if (isRequestOption(argv[i])) fprintf(h, "%s\n", argv[i]);
+  }
+
+  if (width > 0) fprintf(h, "--width=%d\n", width);
+  if (height > 0) fprintf(h, "--height=%d\n", height);
+
+  fputc('\n', h);
+  fclose(h);
+
+  char status[16];
+  char *body = NULL;
+  size_t bodySize = 0;
+
+  int ret = sendServerRequest(path, header, headerSize, payload, payloadSize, status, sizeof(status), &body, &bodySize);
+
+  free(header);
+  free(payload);
+
+  if (ret != 0) {
+    fprintf(getMessageStream(config), "Impossibile comunicare con il server su \"%s\"\n", path);
+    return 1;
+  }
+
+  // l'output va su stdout come se il file fosse stato elaborato in locale; errori e rifiuti sui messaggi
+  int ok = (strcmp(status, "OK") == 0);
+  fwrite(body, 1, bodySize, ok ? config->out : getMessageStream(config));
+  free(body);
+
+  return ok ? 0 : 1;
+}
+
+// invia una richiesta al server sul socket "path" e ne legge la risposta: lo stato in "status" e il corpo in "body"
+// (da liberare con free()). Restituisce 0, o 1 se la connessione non riesce o la risposta non è valida
+int sendServerRequest(const char *path, const char *header, size_t headerSize, const char *payload, size_t payloadSize, char *status, int statusSize, char **body, size_t *bodySize) {
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) return 1;
+  strcpy(address.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return 1;
+
+  if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+    close(fd);
+    return 1;
+  }
+
+  // se la scrittura non riesce la risposta può essere già arrivata: un server occupato risponde BUSY senza leggere la
+  // richiesta e chiude la connessione
+  if (writeFully(fd, header, headerSize)) writeFully(fd, payload, payloadSize);
+
+  // riga di stato, un byte alla volta (è corta): il corpo segue con la lunghezza indicata
+  char line[64];
+  int length = 0;
+
+  while (length < (int) sizeof(line) - 1) {
+    if (!readFully(fd, line + length, 1)) break;
+    if (line[length] == '\n') break;
+    length++;
+  }
+  line[length] = '\0';
+
+  char *size = strchr(line, ' ');
+  if (size == NULL || size - line >= statusSize) {
+    close(fd);
+    return 1;
+  }
+
+  memcpy(status, line, size - line);
+  status[size - line] = '\0';
+  *bodySize = strtoull(size + 1, NULL, 10);
+  *body = malloc(*bodySize + 1);
+
+  int ok = (*body != NULL && readFully(fd, *body, *bodySize));
+  close(fd);
+
+  if (!ok) {
+    free(*body);
+    *body = NULL;
+    return 1;
+  }
+
+  (*body)[*bodySize] = '\0';
+  return 0;
+}
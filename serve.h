@@ -0,0 +1,94 @@
+// GPSReader: server delle richieste di elaborazione su un socket Unix (--serve), con un pool di thread, e client
+// che gli invia un file (--client)
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "gpsreader.h"
+
+// modalità --serve: richieste in attesa al massimo (oltre, la risposta è BUSY), byte massimi dell'intestazione e del
+// contenuto GPX di una richiesta, secondi di attesa dei dati di una connessione, fasce dell'istogramma delle latenze
+// (la prima fino a SERVE_LATENCY_MIN secondi, ognuna ampia il doppio della precedente), colonne e righe massime
+// del grafico di una richiesta
+#define SERVE_QUEUE 64
+#define SERVE_MAX_HEADER 8192
+#define SERVE_MAX_PAYLOAD (256 * 1024 * 1024)
+#define SERVE_TIMEOUT 10
+#define SERVE_LATENCY_BUCKETS 20
+#define SERVE_LATENCY_MIN 32e-6
+#define SERVE_MAX_CHART 4096
+
+// istogramma delle latenze di --serve: fasce di ampiezza doppia a partire da SERVE_LATENCY_MIN secondi
+typedef struct {
+  long count[SERVE_LATENCY_BUCKETS];
+  long total;
+  double sum;                 // s
+  double max;                 // s
+} latencyHistogram;
+
+// connessione accettata da --serve, in attesa di un thread
+typedef struct {
+  int fd;
+  struct timespec accepted;
+} serverConnection;
+
+// stato di --serve: socket in ascolto, coda circolare delle connessioni accettate e contatori, condivisi tra i thread
+typedef struct {
+  const jobConfig *config;    // impostazioni comuni: ogni richiesta ne fa una copia, con le proprie opzioni
+  const char *path;
+  int fd;
+  int numThreads;
+  pthread_t *threads;
+  serverConnection *queue;
+  int queueSize;
+  int head;                   // prima connessione in attesa
+  int waiting;                // connessioni in attesa
+  int running;                // richieste in elaborazione
+  int stopping;               // 1 = i thread terminano appena la coda è vuota
+  long completed;
+  long failed;
+  long rejected;              // connessioni rifiutate perché la coda era piena
+  latencyHistogram queueTime;   // dall'accettazione all'inizio dell'elaborazione
+  latencyHistogram serviceTime; // elaborazione e invio della risposta
+  latencyHistogram totalTime;
+  struct timespec start;
+  pthread_mutex_t mutex;
+  pthread_cond_t available;   // segnalata quando arriva una connessione o il server si ferma
+} serverState;
+
+// global variable con il socket Unix su cui --serve accetta le richieste (NULL = modalità non attiva)
+extern const char *_SERVE_;
+
+// global variable con il numero massimo di richieste in attesa di un thread in --serve
+extern int _SERVE_QUEUE_;
+
+// global variable impostata da SIGINT/SIGTERM per terminare --serve
+extern volatile sig_atomic_t _SERVE_STOP_;
+
+// global variable con il socket del server a cui --client invia la richiesta (NULL = modalità non attiva)
+extern const char *_CLIENT_;
+
+// global variable: 1 = --client invia il percorso del file invece del suo contenuto
+extern int _CLIENT_PATH_;
+
+int serveRequests(const jobConfig *config, const char *path, int numThreads);
+int openServer(serverState *s, const jobConfig *config, const char *path, int numThreads, int queueSize);
+void runServer(serverState *s);
+void closeServer(serverState *s);
+void *serverWorker(void *arg);
+int handleServerRequest(serverState *s, int fd, char **buffer, size_t *capacity);
+int isRequestOption(const char *option);
+int parseRequestOption(const char *option, jobConfig *job);
+int processRequestData(const jobConfig *job, const char *name, const char *data, size_t size);
+int sendResponse(int fd, const char *status, const char *body, size_t size);
+int readFully(int fd, char *buffer, size_t size);
+int writeFully(int fd, const char *buffer, size_t size);
+void addLatency(latencyHistogram *h, double seconds);
+double getLatencyPercentile(const latencyHistogram *h, double p);
+void printServerStats(serverState *s, FILE *out);
+void stopServer(int signum);
+int runClient(const jobConfig *config, const char *path, const char *filename, int argc, char *argv[], int width, int height);
+int sendServerRequest(const char *path, const char *header, size_t headerSize, const char *payload, size_t payloadSize, char *status, int statusSize, char **body, size_t *bodySize);
+
+#endif
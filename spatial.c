@@ -0,0 +1,333 @@
+// GPSReader: indice spaziale dei punti di una traccia, per le ricerche del punto più vicino e dei punti in un rettangolo
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+//
+// I punti sono proiettati sul piano tangente al centro della traccia (proiezione equirettangolare: x = longitudine per il
+// coseno della latitudine del centro, y = latitudine, in m) e distribuiti in una griglia uniforme. Le celle sono dimensionate
+// sulla distanza media tra i punti, così una cella ne contiene pochi anche se la traccia attraversa un rettangolo molto
+// più grande; i punti sono ordinati per cella in array contigui (come una matrice sparsa CSR), senza liste né puntatori.
+// Su qualche decina di Km l'errore della proiezione è trascurabile; le longitudini non devono attraversare i ±180°
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spatial.h"
+
+// gradi -> radianti
+#define SPATIAL_DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+static void visitCell(const spatialIndex *s, int cell, double qx, double qy, int *best, double *bestDistance);
+static int getCellCol(const spatialIndex *s, double x);
+static int getCellRow(const spatialIndex *s, double y);
+
+// costruisce l'indice di una traccia (latitudini e longitudini in gradi; distanze progressive facoltative, per
+// getDistanceAlongTrack()). Gli array di lat e lon servono solo qui, quello delle distanze deve restare valido.
+// Restituisce 0 se non è stato possibile allocare la memoria
+int initSpatialIndex(spatialIndex *s, const double *lat, const double *lon, const double *distance, int numPoints) {
+
+  memset(s, 0, sizeof(spatialIndex));
+  s->distance = distance;
+
+  if (numPoints <= 0) return 1;
+
+  // centro della proiezione: il centro del rettangolo che contiene la traccia
+  double minLat = lat[0], maxLat = lat[0], minLon = lon[0], maxLon = lon[0];
+
+  for (int i = 1; i < numPoints; i++) {
+    if (lat[i] < minLat) minLat = lat[i];
+    if (lat[i] > maxLat) maxLat = lat[i];
+    if (lon[i] < minLon) minLon = lon[i];
+    if (lon[i] > maxLon) maxLon = lon[i];
+  }
+
+  s->lat0 = (minLat + maxLat) / 2.0;
+  s->lon0 = (minLon + maxLon) / 2.0;
+  s->cosLat0 = cos(s->lat0 * SPATIAL_DEG_TO_RAD);
+
+  s->x = malloc(sizeof(double) * numPoints);
+  s->y = malloc(sizeof(double) * numPoints);
+  s->cellX = malloc(sizeof(double) * numPoints);
+  s->cellY = malloc(sizeof(double) * numPoints);
+  s->cellIndex = malloc(sizeof(int) * numPoints);
+
+  if (s->x == NULL || s->y == NULL || s->cellX == NULL || s->cellY == NULL || s->cellIndex == NULL) {
+    freeSpatialIndex(s);
+    return 0;
+  }
+
+  s->numPoints = numPoints;
+
+  // proiezione e lunghezza della traccia sul piano
+  double length = 0.0;
+
+  for (int i = 0; i < numPoints; i++) {
+    projectSpatialPoint(s, lat[i], lon[i], &(s->x[i]), &(s->y[i]));
+    if (i > 0) length += hypot(s->x[i] - s->x[i - 1], s->y[i] - s->y[i - 1]);
+  }
+
+  projectSpatialPoint(s, minLat, minLon, &(s->minX), &(s->minY));
+
+  double maxX, maxY;
+  projectSpatialPoint(s, maxLat, maxLon, &maxX, &maxY);
+
+  double width = maxX - s->minX;
+  double height = maxY - s->minY;
+
+  // lato delle celle: SPATIAL_POINTS_PER_CELL volte la distanza media tra i punti, ma non così piccolo da avere più di
+  // SPATIAL_MAX_CELLS_PER_POINT celle per punto
+  s->cellSize = SPATIAL_POINTS_PER_CELL * length / numPoints;
+
+  double minCellSize = sqrt(width * height / ((double) SPATIAL_MAX_CELLS_PER_POINT * numPoints));
+  if (s->cellSize < minCellSize) s->cellSize = minCellSize;
+
+  double maxSide = (width > height) ? width : height;
+  if (s->cellSize < maxSide / ((double) SPATIAL_MAX_CELLS_PER_POINT * numPoints)) s->cellSize = maxSide / ((double) SPATIAL_MAX_CELLS_PER_POINT * numPoints);
+  if (!(s->cellSize > 0)) s->cellSize = 1.0;
+
+  s->cols = (int)(width / s->cellSize) + 1;
+  s->rows = (int)(height / s->cellSize) + 1;
+
+  int numCells = s->cols * s->rows;
+  s->cellStart = calloc(numCells + 1, sizeof(int));
+
+  if (s->cellStart == NULL) {
+    freeSpatialIndex(s);
+    return 0;
+  }
+
+  // ordinamento per cella (counting sort): conteggio, somme progressive, poi ogni punto al suo posto
+  int *cell = malloc(sizeof(int) * numPoints);
+
+  if (cell == NULL) {
+    freeSpatialIndex(s);
+    return 0;
+  }
+
+  for (int i = 0; i < numPoints; i++) {
+    cell[i] = getCellRow(s, s->y[i]) * s->cols + getCellCol(s, s->x[i]);
+    s->cellStart[cell[i] + 1]++;
+  }
+
+  for (int c = 0; c < numCells; c++) {
+    s->cellStart[c + 1] += s->cellStart[c];
+  }
+
+  // posizione libera di ogni cella: parte dal primo punto e avanza
+  int *next = malloc(sizeof(int) * numCells);
+
+  if (next == NULL) {
+    free(cell);
+    freeSpatialIndex(s);
+    return 0;
+  }
+
+  memcpy(next, s->cellStart, sizeof(int) * numCells);
+
+  for (int i = 0; i < numPoints; i++) {
+    int position = next[cell[i]]++;
+    s->cellX[position] = s->x[i];
+    s->cellY[position] = s->y[i];
+    s->cellIndex[position] = i;
+  }
+
+  free(next);
+  free(cell);
+  return 1;
+}
+
+// libera la memoria dell'indice (non le distanze progressive, che appartengono a chi l'ha costruito)
+void freeSpatialIndex(spatialIndex *s) {
+  free(s->x);
+  free(s->y);
+  free(s->cellX);
+  free(s->cellY);
+  free(s->cellIndex);
+  free(s->cellStart);
+  memset(s, 0, sizeof(spatialIndex));
+}
+
+// coordinate (m) di un punto sul piano della proiezione
+void projectSpatialPoint(const spatialIndex *s, double lat, double lon, double *x, double *y) {
+  *x = (lon - s->lon0) * SPATIAL_DEG_TO_RAD * s->cosLat0 * SPATIAL_EARTH_RADIUS;
+  *y = (lat - s->lat0) * SPATIAL_DEG_TO_RAD * SPATIAL_EARTH_RADIUS;
+}
+
+// indice nella traccia del punto più vicino a (lat, lon), -1 se la traccia non ha punti; in "distance" (se non è NULL)
+// la distanza sul piano della proiezione (m). A parità di distanza vince il primo punto della traccia.
+// Le celle sono visitate ad anelli concentrici attorno a quella del punto cercato; ci si ferma quando le celle non ancora
+// visitate sono tutte più lontane del punto migliore trovato, o quando si è visitata tutta la griglia
+int findNearestPoint(const spatialIndex *s, double lat, double lon, double *distance) {
+
+  if (s->numPoints == 0) {
+    if (distance != NULL) *distance = NAN;
+    return -1;
+  }
+
+  double qx, qy;
+  projectSpatialPoint(s, lat, lon, &qx, &qy);
+
+  int cx = getCellCol(s, qx);
+  int cy = getCellRow(s, qy);
+
+  int best = -1;
+  double bestDistance = INFINITY;   // al quadrato
+
+  for (int r = 0; ; r++) {
+
+    int left = cx - r, right = cx + r, bottom = cy - r, top = cy + r;
+
+    // righe in basso e in alto dell'anello (intere), poi le colonne ai lati per le righe intermedie
+    int firstRow = (bottom < 0) ? 0 : bottom;
+    int lastRow = (top >= s->rows) ? s->rows - 1 : top;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+      if (row == bottom || row == top) {
+        int from = (left < 0) ? 0 : left;
+        int to = (right >= s->cols) ? s->cols - 1 : right;
+        for (int col = from; col <= to; col++) visitCell(s, row * s->cols + col, qx, qy, &best, &bestDistance);
+      } else {
+        if (left >= 0) visitCell(s, row * s->cols + left, qx, qy, &best, &bestDistance);
+        if (right < s->cols) visitCell(s, row * s->cols + right, qx, qy, &best, &bestDistance);
+      }
+    }
+
+    // le celle non visitate stanno oltre i lati del quadrato visitato che non coincidono con il bordo della griglia:
+    // la distanza minima da ciascuno di questi lati è un limite inferiore per i punti non ancora visitati
+    double bound = INFINITY;
+
+    if (left > 0) bound = fmin(bound, fmax(0.0, qx - (s->minX + left * s->cellSize)));
+    if (right < s->cols - 1) bound = fmin(bound, fmax(0.0, (s->minX + (right + 1) * s->cellSize) - qx));
+    if (bottom > 0) bound = fmin(bound, fmax(0.0, qy - (s->minY + bottom * s->cellSize)));
+    if (top < s->rows - 1) bound = fmin(bound, fmax(0.0, (s->minY + (top + 1) * s->cellSize) - qy));
+
+    if (isinf(bound) || (best >= 0 && bestDistance <= bound * bound)) break;
+  }
+
+  if (distance != NULL) *distance = sqrt(bestDistance);
+  return best;
+}
+
+// punti della traccia nel rettangolo [minLat, maxLat] x [minLon, maxLon] (estremi compresi): i loro indici, nell'ordine
+// delle celle, vanno in "points" (al più maxPoints). Restituisce quanti sono i punti nel rettangolo, anche oltre maxPoints
+int findPointsInBox(const spatialIndex *s, double minLat, double minLon, double maxLat, double maxLon, int *points, int maxPoints) {
+
+  if (s->numPoints == 0) return 0;
+
+  // la proiezione conserva l'ordine di latitudini e longitudini: il rettangolo resta un rettangolo
+  double x0, y0, x1, y1;
+  projectSpatialPoint(s, minLat, minLon, &x0, &y0);
+  projectSpatialPoint(s, maxLat, maxLon, &x1, &y1);
+
+  int count = 0;
+
+  for (int row = getCellRow(s, y0); row <= getCellRow(s, y1); row++) {
+    for (int col = getCellCol(s, x0); col <= getCellCol(s, x1); col++) {
+      int cell = row * s->cols + col;
+
+      for (int p = s->cellStart[cell]; p < s->cellStart[cell + 1]; p++) {
+        if (s->cellX[p] < x0 || s->cellX[p] > x1 || s->cellY[p] < y0 || s->cellY[p] > y1) continue;
+        if (count < maxPoints) points[count] = s->cellIndex[p];
+        count++;
+      }
+    }
+  }
+
+  return count;
+}
+
+// distanza progressiva (m) della proiezione di (lat, lon) sulla traccia, e in "offset" (se non è NULL) la distanza (m)
+// dalla traccia. Si proietta il punto sui due tratti che toccano il punto più vicino e si interpola la distanza
+// progressiva lungo il tratto migliore: il risultato è esatto quando i punti sono fitti rispetto alla distanza dalla
+// traccia, come nelle tracce GPS. NAN se la traccia non ha punti o l'indice non ha le distanze progressive
+double getDistanceAlongTrack(const spatialIndex *s, double lat, double lon, double *offset) {
+
+  if (offset != NULL) *offset = NAN;
+
+  int nearest = findNearestPoint(s, lat, lon, NULL);
+  if (nearest < 0 || s->distance == NULL) return NAN;
+
+  double qx, qy;
+  projectSpatialPoint(s, lat, lon, &qx, &qy);
+
+  double along = s->distance[nearest];
+  double bestOffset = hypot(qx - s->x[nearest], qy - s->y[nearest]);
+
+  for (int a = nearest - 1; a <= nearest; a++) {
+    int b = a + 1;
+    if (a < 0 || b >= s->numPoints) continue;
+
+    double dx = s->x[b] - s->x[a];
+    double dy = s->y[b] - s->y[a];
+    double length2 = dx * dx + dy * dy;
+    if (length2 == 0) continue;
+
+    double t = ((qx - s->x[a]) * dx + (qy - s->y[a]) * dy) / length2;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+
+    double d = hypot(qx - (s->x[a] + t * dx), qy - (s->y[a] + t * dy));
+
+    if (d < bestOffset) {
+      bestOffset = d;
+      along = s->distance[a] + t * (s->distance[b] - s->distance[a]);
+    }
+  }
+
+  if (offset != NULL) *offset = bestOffset;
+  return along;
+}
+
+// come findNearestPoint(), scorrendo tutti i punti (riferimento per i benchmark)
+int findNearestPointLinear(const spatialIndex *s, double lat, double lon, double *distance) {
+
+  double qx, qy;
+  projectSpatialPoint(s, lat, lon, &qx, &qy);
+
+  int best = -1;
+  double bestDistance = INFINITY;
+
+  for (int i = 0; i < s->numPoints; i++) {
+    double dx = s->x[i] - qx;
+    double dy = s->y[i] - qy;
+    double d = dx * dx + dy * dy;
+
+    if (d < bestDistance) {
+      bestDistance = d;
+      best = i;
+    }
+  }
+
+  if (distance != NULL) *distance = (best >= 0) ? sqrt(bestDistance) : NAN;
+  return best;
+}
+
+// confronta i punti di una cella con il migliore trovato fino ad ora (distanza al quadrato)
+static void visitCell(const spatialIndex *s, int cell, double qx, double qy, int *best, double *bestDistance) {
+
+  for (int p = s->cellStart[cell]; p < s->cellStart[cell + 1]; p++) {
+    double dx = s->cellX[p] - qx;
+    double dy = s->cellY[p] - qy;
+    double d = dx * dx + dy * dy;
+
+    if (d < *bestDistance || (d == *bestDistance && s->cellIndex[p] < *best)) {
+      *bestDistance = d;
+      *best = s->cellIndex[p];
+    }
+  }
+}
+
+// colonna (da 0 a cols - 1) di una coordinata x: quelle fuori dalla griglia finiscono nella prima o nell'ultima
+static int getCellCol(const spatialIndex *s, double x) {
+  double col = floor((x - s->minX) / s->cellSize);
+  if (col < 0) return 0;
+  if (col >= s->cols) return s->cols - 1;
+  return (int) col;
+}
+
+// riga (da 0 a rows - 1) di una coordinata y
+static int getCellRow(const spatialIndex *s, double y) {
+  double row = floor((y - s->minY) / s->cellSize);
+  if (row < 0) return 0;
+  if (row >= s->rows) return s->rows - 1;
+  return (int) row;
+}
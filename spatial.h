@@ -0,0 +1,45 @@
+// GPSReader: indice spaziale dei punti di una traccia, per le ricerche del punto più vicino e dei punti in un rettangolo
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+// raggio terrestre (m) della proiezione locale, lo stesso delle distanze calcolate da gpsreader.c
+#define SPATIAL_EARTH_RADIUS 6378130.0
+
+// punti per cella a cui punta la dimensione delle celle
+#define SPATIAL_POINTS_PER_CELL 8
+
+// le celle non sono mai più di SPATIAL_MAX_CELLS_PER_POINT per punto (tracce diritte su un rettangolo molto grande)
+#define SPATIAL_MAX_CELLS_PER_POINT 4
+
+// indice a griglia uniforme: i punti, proiettati sul piano tangente al centro della traccia (in m), sono ordinati per
+// cella; cellStart[c] è la posizione del primo punto della cella c e cellStart[c + 1] quella del primo della successiva
+typedef struct {
+  int numPoints;
+  double lat0;                // centro della proiezione (gradi)
+  double lon0;
+  double cosLat0;
+  double *x;                  // coordinate proiettate dei punti, nell'ordine della traccia
+  double *y;
+  const double *distance;     // distanze progressive dei punti (m), NULL se non note
+  double *cellX;              // coordinate proiettate dei punti, nell'ordine delle celle
+  double *cellY;
+  int *cellIndex;             // indice nella traccia dei punti, nell'ordine delle celle
+  int *cellStart;
+  double minX;                // angolo in basso a sinistra della griglia
+  double minY;
+  double cellSize;            // lato di una cella (m)
+  int cols;
+  int rows;
+} spatialIndex;
+
+int initSpatialIndex(spatialIndex *s, const double *lat, const double *lon, const double *distance, int numPoints);
+void freeSpatialIndex(spatialIndex *s);
+int findNearestPoint(const spatialIndex *s, double lat, double lon, double *distance);
+int findPointsInBox(const spatialIndex *s, double minLat, double minLon, double maxLat, double maxLon, int *points, int maxPoints);
+double getDistanceAlongTrack(const spatialIndex *s, double lat, double lon, double *offset);
+int findNearestPointLinear(const spatialIndex *s, double lat, double lon, double *distance);
+void projectSpatialPoint(const spatialIndex *s, double lat, double lon, double *x, double *y);
+
+#endif
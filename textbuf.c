@@ -0,0 +1,445 @@
+// GPSReader: buffer di testo riutilizzabile e formattazione dei numeri per l'output JSON/CSV
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+//
+// I record sono composti in un buffer che cresce una volta sola e viene riutilizzato, poi scritti con una sola fwrite():
+// nessuna printf() per campo. I double sono scritti con l'algoritmo Grisu2 (F. Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers", 2010): la stringa, riletta con strtod(), restituisce esattamente lo stesso double,
+// ed è la più corta possibile nella quasi totalità dei casi (altrimenti ha una cifra in più). Bastano interi a 64 bit e una
+// tabella di 87 potenze di 10 precalcolate
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "textbuf.h"
+
+// numero "do-it-yourself floating point": f * 2^e, con f a 64 bit
+typedef struct {
+  uint64_t f;
+  int e;
+} diyFp;
+
+#define DOUBLE_SIGNIFICAND_SIZE 52
+#define DOUBLE_EXPONENT_BIAS (0x3FF + DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_HIDDEN_BIT 0x0010000000000000ULL
+#define DOUBLE_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DOUBLE_EXPONENT_MASK 0x7FF0000000000000ULL
+
+// potenze 10^k, k = -348, -340, ..., 340, normalizzate (bit più alto di f a 1) e arrotondate: 10^k ~ f * 2^e
+static const uint64_t CACHED_POWERS_F[] = {
+  0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+  0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+  0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+  0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+  0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+  0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+  0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+  0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+  0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+  0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+  0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+  0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+  0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+  0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+  0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+  0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+  0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+  0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+  0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+  0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+  0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+  0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t CACHED_POWERS_E[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901, -874, -847, -821,
+  -794, -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502, -475, -449, -422, -396,
+  -369, -343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+  481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint32_t POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+static diyFp getDiyFp(double value);
+static diyFp multiplyDiyFp(diyFp x, diyFp y);
+static diyFp normalizeDiyFp(diyFp x);
+static void getBoundaries(double value, diyFp *minus, diyFp *plus);
+static diyFp getCachedPower(int e, int *k);
+static int countDigits(uint32_t n);
+static void roundDigits(char *digits, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance);
+static int generateDigits(diyFp w, diyFp plus, uint64_t delta, char *digits, int *k);
+static int grisu2(double value, char *digits, int *k);
+
+// prepara un buffer vuoto con la capacità iniziale indicata
+void initTextBuffer(textBuffer *b, size_t capacity) {
+  b->capacity = (capacity > 0) ? capacity : 64;
+  b->data = malloc(b->capacity);
+  b->size = 0;
+}
+
+// svuota il buffer, conservando la memoria per i record successivi
+void clearTextBuffer(textBuffer *b) {
+  b->size = 0;
+}
+
+void freeTextBuffer(textBuffer *b) {
+  free(b->data);
+  b->data = NULL;
+  b->size = b->capacity = 0;
+}
+
+// scrive il contenuto del buffer e lo svuota; restituisce 1 in caso di errore di scrittura
+int flushTextBuffer(textBuffer *b, FILE *out) {
+  int ret = (b->size > 0 && fwrite(b->data, 1, b->size, out) != b->size);
+  b->size = 0;
+  return ret;
+}
+
+// riserva length caratteri in fondo al buffer (raddoppiandone la capacità se serve) e ne restituisce l'inizio
+char *reserveText(textBuffer *b, size_t length) {
+
+  if (b->size + length > b->capacity) {
+    size_t capacity = b->capacity * 2;
+    while (capacity < b->size + length) capacity *= 2;
+
+    char *data = realloc(b->data, capacity);
+    if (data == NULL) {
+      fprintf(stderr, "Memoria insufficiente per il buffer di output\n");
+      exit(1);
+    }
+    b->data = data;
+    b->capacity = capacity;
+  }
+
+  char *dest = b->data + b->size;
+  b->size += length;
+  return dest;
+}
+
+void appendText(textBuffer *b, const char *text, size_t length) {
+  memcpy(reserveText(b, length), text, length);
+}
+
+void appendString(textBuffer *b, const char *text) {
+  appendText(b, text, strlen(text));
+}
+
+void appendChar(textBuffer *b, char c) {
+  *reserveText(b, 1) = c;
+}
+
+void appendInt(textBuffer *b, int64_t value) {
+  char *dest = reserveText(b, DOUBLE_TEXT_SIZE);
+  b->size -= DOUBLE_TEXT_SIZE - formatInt(dest, value);
+}
+
+void appendDouble(textBuffer *b, double value) {
+  char *dest = reserveText(b, DOUBLE_TEXT_SIZE);
+  b->size -= DOUBLE_TEXT_SIZE - formatDouble(dest, value);
+}
+
+// stringa JSON tra virgolette: sono sostituiti con una sequenza di escape virgolette, backslash e caratteri di controllo
+void appendJsonString(textBuffer *b, const char *text) {
+
+  appendChar(b, '"');
+
+  for (const char *p = text; *p != '\0'; p++) {
+    unsigned char c = *p;
+
+    if (c == '"' || c == '\\') {
+      char *dest = reserveText(b, 2);
+      dest[0] = '\\';
+      dest[1] = c;
+    }
+    else if (c < 0x20) {
+      char *dest = reserveText(b, 6);
+      memcpy(dest, "\\u00", 4);
+      dest[4] = "0123456789abcdef"[c >> 4];
+      dest[5] = "0123456789abcdef"[c & 0xF];
+    }
+    else {
+      appendChar(b, c);
+    }
+  }
+
+  appendChar(b, '"');
+}
+
+// campo CSV (RFC 4180): tra virgolette, con le virgolette raddoppiate, solo se contiene virgole, virgolette o a capo
+void appendCsvString(textBuffer *b, const char *text) {
+
+  if (strpbrk(text, ",\"\r\n") == NULL) {
+    appendString(b, text);
+    return;
+  }
+
+  appendChar(b, '"');
+
+  for (const char *p = text; *p != '\0'; p++) {
+    if (*p == '"') appendChar(b, '"');
+    appendChar(b, *p);
+  }
+
+  appendChar(b, '"');
+}
+
+// scrive un intero in dest (senza terminatore); restituisce il numero di caratteri
+int formatInt(char *dest, int64_t value) {
+
+  char digits[20];
+  int n = 0;
+  int length = 0;
+  uint64_t u = (value < 0) ? -(uint64_t) value : (uint64_t) value;
+
+  do {
+    digits[n++] = '0' + (u % 10);
+    u /= 10;
+  } while (u > 0);
+
+  if (value < 0) dest[length++] = '-';
+  while (n > 0) dest[length++] = digits[--n];
+
+  return length;
+}
+
+// scrive un double in dest (senza terminatore, al più DOUBLE_TEXT_SIZE - 1 caratteri) con il minor numero di cifre che
+// ne permette la rilettura esatta: notazione decimale per esponenti tra -6 e 21 (come JavaScript), esponenziale altrimenti.
+// NaN e infiniti sono scritti come "nan", "inf" e "-inf": chi li scrive in JSON o CSV deve sostituirli prima.
+// Restituisce il numero di caratteri
+int formatDouble(char *dest, double value) {
+
+  if (isnan(value)) {
+    memcpy(dest, "nan", 3);
+    return 3;
+  }
+
+  int length = 0;
+
+  if (signbit(value)) {
+    dest[length++] = '-';
+    value = -value;
+  }
+
+  if (isinf(value)) {
+    memcpy(dest + length, "inf", 3);
+    return length + 3;
+  }
+
+  if (value == 0) {
+    dest[length++] = '0';
+    return length;
+  }
+
+  // cifre e esponente: value = digits * 10^k
+  char digits[18];
+  int k;
+  int n = grisu2(value, digits, &k);
+
+  // posizione della virgola rispetto alla prima cifra
+  int point = n + k;
+
+  if (k >= 0 && point <= 21) {
+    // intero: cifre seguite da k zeri
+    memcpy(dest + length, digits, n);
+    memset(dest + length + n, '0', k);
+    return length + point;
+  }
+
+  if (point > 0 && point <= 21) {
+    // virgola tra le cifre
+    memcpy(dest + length, digits, point);
+    dest[length + point] = '.';
+    memcpy(dest + length + point + 1, digits + point, n - point);
+    return length + n + 1;
+  }
+
+  if (point > -6 && point <= 0) {
+    // 0.000ddd
+    dest[length++] = '0';
+    dest[length++] = '.';
+    memset(dest + length, '0', -point);
+    memcpy(dest + length - point, digits, n);
+    return length - point + n;
+  }
+
+  // d.ddde[-]x
+  dest[length++] = digits[0];
+  if (n > 1) {
+    dest[length++] = '.';
+    memcpy(dest + length, digits + 1, n - 1);
+    length += n - 1;
+  }
+  dest[length++] = 'e';
+
+  return length + formatInt(dest + length, point - 1);
+}
+
+// f e e di un double finito e positivo: f * 2^e è esattamente il suo valore
+static diyFp getDiyFp(double value) {
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  int biasedExponent = (int)((bits & DOUBLE_EXPONENT_MASK) >> DOUBLE_SIGNIFICAND_SIZE);
+  uint64_t significand = bits & DOUBLE_SIGNIFICAND_MASK;
+
+  diyFp x;
+  if (biasedExponent != 0) {
+    x.f = significand + DOUBLE_HIDDEN_BIT;
+    x.e = biasedExponent - DOUBLE_EXPONENT_BIAS;
+  } else {
+    // numero subnormale
+    x.f = significand;
+    x.e = 1 - DOUBLE_EXPONENT_BIAS;
+  }
+  return x;
+}
+
+// prodotto arrotondato ai 64 bit più significativi
+static diyFp multiplyDiyFp(diyFp x, diyFp y) {
+
+  unsigned __int128 p = (unsigned __int128) x.f * y.f;
+  uint64_t high = (uint64_t)(p >> 64);
+  uint64_t low = (uint64_t) p;
+
+  if (low & (1ULL << 63)) high++;
+
+  diyFp r = { high, x.e + y.e + 64 };
+  return r;
+}
+
+// sposta f in modo che il bit più alto sia a 1
+static diyFp normalizeDiyFp(diyFp x) {
+  int shift = __builtin_clzll(x.f);
+  diyFp r = { x.f << shift, x.e - shift };
+  return r;
+}
+
+// estremi dell'intervallo dei numeri reali che, arrotondati, danno proprio value: i punti medi verso i double vicini.
+// Sono normalizzati con lo stesso esponente
+static void getBoundaries(double value, diyFp *minus, diyFp *plus) {
+
+  diyFp v = getDiyFp(value);
+
+  diyFp p = { (v.f << 1) + 1, v.e - 1 };
+  while (!(p.f & (DOUBLE_HIDDEN_BIT << 1))) {
+    p.f <<= 1;
+    p.e--;
+  }
+  p.f <<= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+  p.e -= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+
+  // con la significand minima il double precedente è più vicino (l'esponente cambia)
+  diyFp m;
+  if (v.f == DOUBLE_HIDDEN_BIT) {
+    m.f = (v.f << 2) - 1;
+    m.e = v.e - 2;
+  } else {
+    m.f = (v.f << 1) - 1;
+    m.e = v.e - 1;
+  }
+  m.f <<= m.e - p.e;
+  m.e = p.e;
+
+  *minus = m;
+  *plus = p;
+}
+
+// potenza di 10 (10^-k) che porta l'esponente binario e nell'intervallo [-60, -32]
+static diyFp getCachedPower(int e, int *k) {
+
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = (int) dk;
+  if (dk - ik > 0.0) ik++;
+
+  int index = (ik >> 3) + 1;
+  *k = -(-348 + index * 8);
+
+  diyFp r = { CACHED_POWERS_F[index], CACHED_POWERS_E[index] };
+  return r;
+}
+
+static int countDigits(uint32_t n) {
+  int digits = 1;
+  while (digits < 10 && n >= POW10[digits]) digits++;
+  return digits;
+}
+
+// corregge l'ultima cifra verso il valore esatto finché si resta nell'intervallo che si rilegge come lo stesso double
+static void roundDigits(char *digits, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance) {
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+    digits[length - 1]--;
+    rest += tenKappa;
+  }
+}
+
+// genera le cifre dell'estremo superiore "plus" finché il resto resta entro delta (l'ampiezza dell'intervallo): così le
+// cifre sono il meno possibile. Restituisce il numero di cifre e aggiorna l'esponente decimale k
+static int generateDigits(diyFp w, diyFp plus, uint64_t delta, char *digits, int *k) {
+
+  int shift = -plus.e;
+  uint64_t one = 1ULL << shift;
+  uint64_t distance = plus.f - w.f;
+
+  // parte intera e frazionaria di plus
+  uint32_t p1 = (uint32_t)(plus.f >> shift);
+  uint64_t p2 = plus.f & (one - 1);
+
+  int kappa = countDigits(p1);
+  int length = 0;
+
+  while (kappa > 0) {
+    uint32_t d = p1 / POW10[kappa - 1];
+    p1 %= POW10[kappa - 1];
+
+    if (d || length) digits[length++] = '0' + d;
+    kappa--;
+
+    uint64_t rest = ((uint64_t) p1 << shift) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      roundDigits(digits, length, delta, rest, (uint64_t) POW10[kappa] << shift, distance);
+      return length;
+    }
+  }
+
+  // le cifre della parte intera non bastano: si prosegue con quelle della parte frazionaria
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+
+    char d = (char)(p2 >> shift);
+    if (d || length) digits[length++] = '0' + d;
+
+    p2 &= one - 1;
+    kappa--;
+
+    if (p2 < delta) {
+      *k += kappa;
+      roundDigits(digits, length, delta, p2, one, distance * ((-kappa < 10) ? POW10[-kappa] : 0));
+      return length;
+    }
+  }
+}
+
+// cifre decimali (al più 17) di un double finito e positivo: value = digits * 10^k
+static int grisu2(double value, char *digits, int *k) {
+
+  diyFp minus, plus;
+  getBoundaries(value, &minus, &plus);
+
+  diyFp power = getCachedPower(plus.e, k);
+
+  diyFp w = multiplyDiyFp(normalizeDiyFp(getDiyFp(value)), power);
+  diyFp wPlus = multiplyDiyFp(plus, power);
+  diyFp wMinus = multiplyDiyFp(minus, power);
+
+  // gli estremi sono ristretti di un'unità per compensare l'arrotondamento dei prodotti
+  wMinus.f++;
+  wPlus.f--;
+
+  return generateDigits(w, wPlus, wPlus.f - wMinus.f, digits, k);
+}
@@ -0,0 +1,36 @@
+// GPSReader: buffer di testo riutilizzabile e formattazione dei numeri per l'output JSON/CSV
+// MIT License - gabriele.bernuzzi@studenti.unimi.it
+
+#ifndef TEXTBUF_H
+#define TEXTBUF_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// caratteri sufficienti per qualunque double formattato da formatDouble() (terminatore compreso)
+#define DOUBLE_TEXT_SIZE 32
+
+// buffer di testo che cresce quando serve e viene svuotato (non liberato) dopo ogni scrittura
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+} textBuffer;
+
+void initTextBuffer(textBuffer *b, size_t capacity);
+void clearTextBuffer(textBuffer *b);
+void freeTextBuffer(textBuffer *b);
+int flushTextBuffer(textBuffer *b, FILE *out);
+char *reserveText(textBuffer *b, size_t length);
+void appendText(textBuffer *b, const char *text, size_t length);
+void appendString(textBuffer *b, const char *text);
+void appendChar(textBuffer *b, char c);
+void appendInt(textBuffer *b, int64_t value);
+void appendDouble(textBuffer *b, double value);
+void appendJsonString(textBuffer *b, const char *text);
+void appendCsvString(textBuffer *b, const char *text);
+int formatInt(char *dest, int64_t value);
+int formatDouble(char *dest, double value);
+
+#endif